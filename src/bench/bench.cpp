@@ -0,0 +1,363 @@
+/*
+ * Copyright (c) 2021, Jan de Visser <jan@finiandarcy.com>
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <cpu/alu.h>
+#include <cpu/backplane.h>
+#include <cpu/iochannel.h>
+#include <cpu/opcodes.h>
+
+using namespace Obelix::JV80::CPU;
+
+namespace {
+
+constexpr word PROGRAM_START = 0x1000;
+
+//
+// Guest programs. All of them start at 0x1000 and end in HLT.
+//
+
+// 4096 iterations of a small arithmetic loop.
+const byte tight_loop[] = {
+    /* 1000 */ MOV_SI_CONST, 0x00, 0x10,
+    /* 1003 */ MOV_A_CONST, 0x01,
+    /* 1005 */ MOV_B_CONST, 0x02,
+    /* 1007 */ ADD_A_B,
+    /* 1008 */ SWP_A_B,
+    /* 1009 */ DEC_SI,
+    /* 100A */ JNZ, 0x07, 0x10,
+    /* 100D */ HLT,
+};
+
+// Copies 2K from 0x4000 to 0x6000 one byte at a time.
+const byte mem_copy[] = {
+    /* 1000 */ MOV_SI_CONST, 0x00, 0x40,
+    /* 1003 */ MOV_DI_CONST, 0x00, 0x60,
+    /* 1006 */ MOV_C_CONST, 0x00,
+    /* 1008 */ MOV_D_CONST, 0x08,
+    /* 100A */ MOV_A__SI,
+    /* 100B */ MOV__DI_A,
+    /* 100C */ DEC_C,
+    /* 100D */ JNZ, 0x0A, 0x10,
+    /* 1010 */ DEC_D,
+    /* 1011 */ JNZ, 0x0A, 0x10,
+    /* 1014 */ HLT,
+};
+
+// 1024 iterations of two nested subroutine calls.
+const byte call_ret[] = {
+    /* 1000 */ MOV_SP_CONST, 0x00, 0x80,
+    /* 1003 */ MOV_SI_CONST, 0x00, 0x04,
+    /* 1006 */ CALL, 0x10, 0x10,
+    /* 1009 */ DEC_SI,
+    /* 100A */ JNZ, 0x06, 0x10,
+    /* 100D */ HLT,
+    /* 100E */ NOP, NOP,
+    /* 1010 */ CALL, 0x18, 0x10,
+    /* 1013 */ INC_A,
+    /* 1014 */ RET,
+    /* 1015 */ NOP, NOP, NOP,
+    /* 1018 */ INC_B,
+    /* 1019 */ RET,
+};
+
+// 1024 reads from an input channel which raises an NMI on every fourth read.
+const byte nmi_input[] = {
+    /* 1000 */ MOV_SP_CONST, 0x00, 0x80,
+    /* 1003 */ NMIVEC, 0x20, 0x10,
+    /* 1006 */ MOV_SI_CONST, 0x00, 0x04,
+    /* 1009 */ IN_A, 0x01,
+    /* 100B */ DEC_SI,
+    /* 100C */ JNZ, 0x09, 0x10,
+    /* 100F */ HLT,
+    /* 1010 */ NOP, NOP, NOP, NOP, NOP, NOP, NOP, NOP,
+    /* 1018 */ NOP, NOP, NOP, NOP, NOP, NOP, NOP, NOP,
+    /* 1020 */ PUSH_A,
+    /* 1021 */ IN_B, 0x01,
+    /* 1023 */ POP_A,
+    /* 1024 */ RTI,
+};
+
+struct Program {
+    const char* name;
+    const byte* code;
+    size_t size;
+};
+
+const Program programs[] = {
+    { "default_image", nullptr, 0 },
+    { "tight_loop", tight_loop, sizeof(tight_loop) },
+    { "mem_copy", mem_copy, sizeof(mem_copy) },
+    { "call_ret", call_ret, sizeof(call_ret) },
+    { "nmi_input", nmi_input, sizeof(nmi_input) },
+};
+
+struct Result {
+    std::string name;
+    std::string kind;
+    std::string engine;
+    unsigned long cycles = 0;
+    unsigned long instructions = 0;
+    unsigned long operations = 0;
+    double seconds = 0.0;
+    SystemError error = NoError;
+};
+
+double minTime = 1.0;
+
+class Machine {
+public:
+    BackPlane system;
+    int reads = 0;
+
+    Machine(BackPlane::Engine engine, const Program& program)
+    {
+        system.defaultSetup();
+        system.setFreeRunning(true);
+        system.setEngine(engine);
+        system.insertIO(new IOChannel(0x1, "IN", [this]() -> byte {
+            if ((++reads % 4) == 0) {
+                system.bus().setNmi();
+            }
+            return (byte)reads;
+        }));
+        auto mem = system.memory();
+        for (size_t ix = 0; ix < program.size; ix++) {
+            (*mem)[PROGRAM_START + ix] = program.code[ix];
+        }
+    }
+};
+
+Result runProgram(const Program& program, BackPlane::Engine engine)
+{
+    Result ret;
+    ret.name = program.name;
+    ret.kind = "program";
+    ret.engine = (engine == BackPlane::Functional) ? "functional" : "cycle";
+    do {
+        Machine machine(engine, program);
+        auto start = std::chrono::steady_clock::now();
+        machine.system.run((program.code) ? PROGRAM_START : 0x0000);
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        ret.seconds += elapsed.count();
+        ret.cycles += machine.system.cycles();
+        ret.instructions += machine.system.instructions();
+        ret.error = machine.system.error();
+    } while ((ret.error == NoError) && (ret.seconds < minTime));
+    return ret;
+}
+
+/**
+ * Runs <op> in batches of <batch> until minTime has elapsed. <op> is passed
+ * the iteration number.
+ */
+template<typename Op>
+Result runMicro(const char* name, Op op, unsigned long batch = 0x10000)
+{
+    Result ret;
+    ret.name = name;
+    ret.kind = "micro";
+    ret.engine = "-";
+    auto start = std::chrono::steady_clock::now();
+    do {
+        for (unsigned long ix = 0; ix < batch; ix++) {
+            op(ret.operations + ix);
+        }
+        ret.operations += batch;
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        ret.seconds = elapsed.count();
+    } while (ret.seconds < minTime);
+    return ret;
+}
+
+volatile byte sink;
+
+std::vector<std::pair<const char*, std::function<Result()>>> microBenchmarks()
+{
+    std::vector<std::pair<const char*, std::function<Result()>>> ret;
+
+    ret.emplace_back("memory_read", []() {
+        BackPlane system;
+        system.defaultSetup();
+        auto mem = system.memory();
+        byte sum = 0;
+        auto ret = runMicro("memory_read", [mem, &sum](unsigned long ix) {
+            sum += (*mem)[ix & 0xBFFF];
+        });
+        sink = sum;
+        return ret;
+    });
+
+    ret.emplace_back("memory_write", []() {
+        BackPlane system;
+        system.defaultSetup();
+        auto mem = system.memory();
+        return runMicro("memory_write", [mem](unsigned long ix) {
+            (*mem)[0x4000 + (ix & 0x3FFF)] = (byte)ix;
+        });
+    });
+
+    ret.emplace_back("memory_map", []() {
+        BackPlane system;
+        system.defaultSetup();
+        auto mem = system.memory();
+        byte count = 0;
+        auto ret = runMicro("memory_map", [mem, &count](unsigned long ix) {
+            count += mem->isMapped((word)ix) + mem->inRAM((word)ix);
+        });
+        sink = count;
+        return ret;
+    });
+
+    ret.emplace_back("alu_high_clock", []() {
+        BackPlane system;
+        system.defaultSetup();
+        auto alu = dynamic_cast<ALU*>(system.component(RHS));
+        auto& bus = system.bus();
+        const byte ops[] = { ALU::ADD, ALU::SUB, ALU::AND, ALU::XOR, ALU::INC, ALU::SHL };
+        return runMicro("alu_high_clock", [alu, &bus, &ops](unsigned long ix) {
+            bus.xdata(GP_A, RHS, ops[ix % sizeof(ops)]);
+            bus.putOnDataBus((byte)ix);
+            alu->onHighClock();
+        });
+    });
+
+    ret.emplace_back("bus_xdata", []() {
+        BackPlane system;
+        system.defaultSetup();
+        auto& bus = system.bus();
+        return runMicro("bus_xdata", [&bus](unsigned long ix) {
+            bus.xdata(GP_A, (int)(ix & 0x03), SystemBus::None);
+        });
+    });
+
+    ret.emplace_back("bus_xaddr", []() {
+        BackPlane system;
+        system.defaultSetup();
+        auto& bus = system.bus();
+        return runMicro("bus_xaddr", [&bus](unsigned long ix) {
+            bus.xaddr(PC, MEMADDR, (ix & 0x01) ? SystemBus::Inc : SystemBus::None);
+        });
+    });
+
+    ret.emplace_back("controller_dispatch", []() {
+        BackPlane system;
+        system.defaultSetup();
+        auto controller = system.controller();
+        const byte opcodes[] = { NOP, MOV_A_CONST, ADD_A_B, JNZ, CALL, PUSH_A, MOV_A__SI, RET };
+        return runMicro("controller_dispatch", [controller, &opcodes](unsigned long ix) {
+            controller->setState(2, 0, 0xFFFF, false);
+            controller->setValue(opcodes[ix % sizeof(opcodes)]);
+            controller->onLowClock();
+        });
+    });
+
+    return ret;
+}
+
+void printText(const std::vector<Result>& results)
+{
+    printf("%-20s %-8s %-10s %14s %14s %10s %16s %16s\n",
+        "benchmark", "kind", "engine", "cycles", "instructions", "seconds", "cycles/s", "ops/s");
+    for (auto& r : results) {
+        if (r.kind == "program") {
+            printf("%-20s %-8s %-10s %14lu %14lu %10.3f %16.0f %16.0f%s\n",
+                r.name.c_str(), r.kind.c_str(), r.engine.c_str(), r.cycles, r.instructions, r.seconds,
+                r.cycles / r.seconds, r.instructions / r.seconds,
+                (r.error != NoError) ? "  ERROR" : "");
+        } else {
+            printf("%-20s %-8s %-10s %14s %14lu %10.3f %16s %16.0f\n",
+                r.name.c_str(), r.kind.c_str(), r.engine.c_str(), "-", r.operations, r.seconds,
+                "-", r.operations / r.seconds);
+        }
+    }
+}
+
+void printJSON(const std::vector<Result>& results)
+{
+    printf("{\n  \"min_time\": %g,\n  \"results\": [", minTime);
+    bool first = true;
+    for (auto& r : results) {
+        printf("%s\n    { \"name\": \"%s\", \"kind\": \"%s\", \"seconds\": %.6f",
+            (first) ? "" : ",", r.name.c_str(), r.kind.c_str(), r.seconds);
+        if (r.kind == "program") {
+            printf(", \"engine\": \"%s\", \"cycles\": %lu, \"instructions\": %lu, "
+                   "\"cycles_per_sec\": %.1f, \"instructions_per_sec\": %.1f, \"error\": %d }",
+                r.engine.c_str(), r.cycles, r.instructions,
+                r.cycles / r.seconds, r.instructions / r.seconds, (int)r.error);
+        } else {
+            printf(", \"operations\": %lu, \"ops_per_sec\": %.1f }", r.operations, r.operations / r.seconds);
+        }
+        first = false;
+    }
+    printf("\n  ]\n}\n");
+}
+
+void usage(const char* prog)
+{
+    std::cerr << "Usage: " << prog << " [--json] [--time <seconds>] [--filter <text>]" << std::endl
+              << "  --json             Write the results as JSON" << std::endl
+              << "  --time <seconds>   Minimum run time per benchmark (default 1)" << std::endl
+              << "  --filter <text>    Only run benchmarks with <text> in their name" << std::endl;
+}
+
+}
+
+int main(int argc, char** argv)
+{
+    bool json = false;
+    std::string filter;
+
+    for (int ix = 1; ix < argc; ix++) {
+        if (!strcmp(argv[ix], "--json")) {
+            json = true;
+        } else if (!strcmp(argv[ix], "--time") && (ix < argc - 1)) {
+            minTime = strtod(argv[++ix], nullptr);
+        } else if (!strcmp(argv[ix], "--filter") && (ix < argc - 1)) {
+            filter = argv[++ix];
+        } else {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+
+    std::vector<Result> results;
+    for (auto& program : programs) {
+        if (!filter.empty() && !strstr(program.name, filter.c_str())) {
+            continue;
+        }
+        for (auto engine : { BackPlane::CycleAccurate, BackPlane::Functional }) {
+            results.push_back(runProgram(program, engine));
+        }
+    }
+    for (auto& [name, bench] : microBenchmarks()) {
+        if (!filter.empty() && !strstr(name, filter.c_str())) {
+            continue;
+        }
+        results.push_back(bench());
+    }
+
+    if (json) {
+        printJSON(results);
+    } else {
+        printText(results);
+    }
+    for (auto& r : results) {
+        if (r.error != NoError) {
+            return 1;
+        }
+    }
+    return 0;
+}
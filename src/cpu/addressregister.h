@@ -25,6 +25,7 @@ public:
     SystemError reset() override;
     SystemError onRisingClockEdge() override;
     SystemError onHighClock() override;
+    int clockPhases() const override { return OnRisingClockEdge | OnHighClock; }
 };
 
 }
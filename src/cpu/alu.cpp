@@ -50,41 +50,51 @@ SystemError ALU::onRisingClockEdge()
     return NoError;
 }
 
-SystemError ALU::onHighClock()
+/**
+ * Performs ALU operation <op> on <lhs> and <rhs>.
+ *
+ * @param flags On entry the current processor flags, which provide the carry
+ * for ADC, SBB, SHL, and SHR. On return the processor flags resulting from
+ * the operation.
+ * @param result On return the result of the operation.
+ * @return false if <op> is not a valid ALU operation. In that case <flags>
+ * and <result> are not modified.
+ */
+bool ALU::operate(byte op, byte lhs, byte rhs, byte& flags, byte& result)
 {
     static Operator operators[16] = {
-        /* 0x0 ADD */ [](ALU* alu) {
-            return alu->getValue() + alu->lhs()->getValue();
+        /* 0x0 ADD */ [](int lhs, int rhs, bool) -> word {
+            return rhs + lhs;
         },
 
-        /* 0x1 ADC */ [](ALU* alu) { return alu->getValue()
-                                         + alu->lhs()->getValue()
-                                         + (byte)(alu->bus()->isSet(SystemBus::C)); },
-
-        /* 0x2 SUB */ [](ALU* alu) { return alu->lhs()->getValue() + ~(alu->getValue()) + 1; },
-
-        /* 0x3 SBB */ [](ALU* alu) { return alu->lhs()->getValue()
-                                         + ~(alu->getValue() + +(byte)(alu->bus()->isSet(SystemBus::C))) + 1; },
-        /* 0x4 AND */ [](ALU* alu) { return alu->getValue() & alu->lhs()->getValue(); },
-        /* 0x5 OR  */ [](ALU* alu) { return alu->getValue() | alu->lhs()->getValue(); },
-        /* 0x6 XOR */ [](ALU* alu) { return alu->getValue() ^ alu->lhs()->getValue(); },
-        /* 0x7 INC */ [](ALU* alu) { return alu->getValue() + 1; },
-        /* 0x8 DEC */ [](ALU* alu) { return alu->getValue() - 1; },
-        /* 0x9 NOT */ [](ALU* alu) { return ~(alu->getValue()) & 0x00FF; },
-        /* 0xA SHL */ [](ALU* alu) {
-      word ret = alu -> getValue() << 1;
-      if (alu -> bus() -> isSet(SystemBus::C)) {
+        /* 0x1 ADC */ [](int lhs, int rhs, bool carry) -> word { return rhs
+                                                                   + lhs
+                                                                   + (byte)(carry); },
+
+        /* 0x2 SUB */ [](int lhs, int rhs, bool) -> word { return lhs + ~(rhs) + 1; },
+
+        /* 0x3 SBB */ [](int lhs, int rhs, bool carry) -> word { return lhs
+                                                                   + ~(rhs + +(byte)(carry)) + 1; },
+        /* 0x4 AND */ [](int lhs, int rhs, bool) -> word { return rhs & lhs; },
+        /* 0x5 OR  */ [](int lhs, int rhs, bool) -> word { return rhs | lhs; },
+        /* 0x6 XOR */ [](int lhs, int rhs, bool) -> word { return rhs ^ lhs; },
+        /* 0x7 INC */ [](int, int rhs, bool) -> word { return rhs + 1; },
+        /* 0x8 DEC */ [](int, int rhs, bool) -> word { return rhs - 1; },
+        /* 0x9 NOT */ [](int, int rhs, bool) -> word { return ~(rhs) & 0x00FF; },
+        /* 0xA SHL */ [](int, int rhs, bool carry) -> word {
+      word ret = rhs << 1;
+      if (carry) {
         ret |= 0x0001;
       }
       return ret & 0x01FF; },
-        /* 0xB SHR */ [](ALU* alu) {
-      bool carry = (alu -> getValue() & 0x01) != 0;
-      word ret = alu -> getValue() >> 1;
-      if (alu -> bus() -> isSet(SystemBus::C)) {
+        /* 0xB SHR */ [](int, int rhs, bool carry) -> word {
+      bool carry_out = (rhs & 0x01) != 0;
+      word ret = rhs >> 1;
+      if (carry) {
         ret |= 0x0080;
       }
       ret &= 0x00FF;
-      if (carry) {
+      if (carry_out) {
         ret |= 0x0100;
       }
       return ret; },
@@ -94,26 +104,48 @@ SystemError ALU::onHighClock()
         /* 0xF */ nullptr,
     };
 
+    auto oper = operators[op & 0x0F];
+    if (!oper) {
+        return false;
+    }
+    auto r = oper(lhs, rhs, (flags & SystemBus::C) != 0);
+    result = (byte)(r & 0xFF);
+    flags = SystemBus::Clear;
+    if ((result & 0x00FF) == 0) {
+        flags |= SystemBus::Z;
+    }
+    if (r & 0x0100) {
+        flags |= SystemBus::C;
+    }
+
+    auto s1 = (bool)(lhs & 0x80);
+    auto s2 = (bool)(rhs & 0x80);
+    auto sr = (bool)(result & 0x80);
+    if ((op == ADD) || (op == ADC)) {
+        if (!(s1 ^ s2) && (sr ^ s1)) {
+            flags |= SystemBus::V;
+        }
+    } else if ((op == SUB) || (op == SBB)) {
+        if ((s1 ^ s2) && (sr ^ s1)) {
+            flags |= SystemBus::V;
+        }
+    }
+    return true;
+}
+
+SystemError ALU::onHighClock()
+{
     auto err = Register::onHighClock();
     if (err != NoError) {
         return err;
     }
     if (bus()->putID() == id()) {
         if (!bus()->xdata()) {
-            m_operator = operators[bus()->opflags()];
-            if (m_operator) {
-                auto result = m_operator(this);
-                byte val = (byte)(result & 0xFF);
-                bus()->clearFlags();
-                if ((val & 0x00FF) == 0) {
-                    bus()->setFlag(SystemBus::Z);
-                }
-                if (result & 0x0100) {
-                    bus()->setFlag(SystemBus::C);
-                }
-                this->setOverflow(val);
-                m_lhs->setValue(val);
-                m_operator = nullptr;
+            byte flags = bus()->flags();
+            byte result;
+            if (operate(bus()->opflags(), m_lhs->getValue(), getValue(), flags, result)) {
+                bus()->setFlags(flags);
+                m_lhs->setValue(result);
             }
         } else if (!bus()->xaddr()) {
             bus()->setFlags(bus()->readDataBus());
@@ -122,18 +154,6 @@ SystemError ALU::onHighClock()
     return NoError;
 }
 
-void ALU::setOverflow(word result)
-{
-    auto s1 = (bool)(lhs()->getValue() & 0x80);
-    auto s2 = (bool)(this->getValue() & 0x80);
-    auto sr = (bool)(result & 0x0080);
-    if ((bus()->opflags() == ADD) || (bus()->opflags() == ADC)) {
-        bus()->setFlag(SystemBus::V, !(s1 ^ s2) & (sr ^ s1));
-    } else if ((bus()->opflags() == SUB) || (bus()->opflags() == SBB)) {
-        bus()->setFlag(SystemBus::V, (s1 ^ s2) & (sr ^ s1));
-    }
-}
-
 //
 // http://teaching.idallen.com/dat2343/10f/notes/040_overflow.txt
 //
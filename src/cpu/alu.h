@@ -17,17 +17,11 @@
 
 namespace Obelix::JV80::CPU {
 
-class ALU;
-
-typedef std::function<word(ALU*)> Operator;
+typedef word (*Operator)(int, int, bool);
 
 class ALU : public Register {
-    Operator m_operator = nullptr;
     Register* m_lhs;
 
-private:
-    void setOverflow(word);
-
 public:
     enum Operations {
         ADD = 0x00,
@@ -49,6 +43,8 @@ public:
     ALU(int, Register* lhs);
     Register* lhs() const { return m_lhs; }
 
+    static bool operate(byte, byte, byte, byte&, byte&);
+
     std::ostream& status(std::ostream&) override;
     SystemError onRisingClockEdge() override;
     SystemError onHighClock() override;
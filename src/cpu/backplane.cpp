@@ -4,6 +4,10 @@
  * SPDX-License-Identifier: GPL-3.0-or-later
  */
 
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+
 #include <cpu/addressregister.h>
 #include <cpu/alu.h>
 #include <cpu/backplane.h>
@@ -30,14 +34,17 @@ static byte mem[] = {
     /* 0x0010 */ HLT
 };
 
-static MemoryBank image { 0x00, 0x11, true, mem };
-
 BackPlane::BackPlane()
     : clock(this, 1.0)
 {
 }
 
 void BackPlane::defaultSetup()
+{
+    insertComponents(new Memory(0x0000, 0xC000, 0xC000, 0x4000, MemoryBank(0x00, sizeof(mem), true, mem)));
+}
+
+void BackPlane::insertComponents(Memory* memory)
 {
     insert(new Register(GP_A)); // 0x00
     insert(new Register(GP_B)); // 0x01
@@ -52,7 +59,13 @@ void BackPlane::defaultSetup()
     insert(new AddressRegister(Si, "Si"));                     // 0x0A
     insert(new AddressRegister(Di, "Di"));                     // 0x0B
     insert(new AddressRegister(TX, "TX"));                     // 0x0C
-    insert(new Memory(0x0000, 0xC000, 0xC000, 0x4000, image)); // 0x0F
+    insert(memory);                                            // 0x0F
+
+    // Unlike components inserted by users of the system, these are owned by
+    // the system, so forks don't leak them.
+    for (int ix : { GP_A, GP_B, GP_C, GP_D, LHS, RHS, IR, PC, SP, Si, Di, TX, MEMADDR }) {
+        m_owned.emplace_back(component(ix));
+    }
 }
 
 SystemBus::RunMode BackPlane::runMode()
@@ -77,11 +90,242 @@ Memory* BackPlane::memory() const
 
 void BackPlane::loadImage(word sz, const byte* data, word addr, bool writable)
 {
-    image = MemoryBank(addr, sz, writable, data);
-    memory()->add(image);
+    memory()->add(MemoryBank(addr, sz, writable, data));
     reset();
 }
 
+/**
+ * Captures the state of the registers, the bus, and the Controller's
+ * sequencer.
+ */
+StateFileHeader BackPlane::captureState()
+{
+    StateFileHeader header;
+    for (int ix = GP_A; ix <= MEMADDR; ix++) {
+        if ((ix == MEM) || ((ix > TX) && (ix < MEMADDR))) {
+            continue;
+        }
+        header.registers[ix] = component(ix)->getValue();
+    }
+    header.dataBus = bus().readDataBus();
+    header.addrBus = bus().readAddrBus();
+    header.getID = bus().getID();
+    header.putID = bus().putID();
+    header.opflags = bus().opflags();
+    header.flags = bus().flags();
+    header.lines = (bus().xdata() ? StateFileHeader::XData : 0)
+        | (bus().xaddr() ? StateFileHeader::XAddr : 0)
+        | (bus().io() ? StateFileHeader::IO : 0)
+        | (bus().halt() ? StateFileHeader::Halt : 0)
+        | (bus().sus() ? StateFileHeader::Sus : 0)
+        | (bus().nmi() ? StateFileHeader::NMI : 0);
+    header.phase = m_phase;
+    header.sequencer = controller()->sequencerState();
+    return header;
+}
+
+void BackPlane::restoreState(const StateFileHeader& header)
+{
+    for (int ix = GP_A; ix <= TX; ix++) {
+        if (ix == MEM) {
+            continue;
+        }
+        if (auto reg = dynamic_cast<Register*>(component(ix)); reg) {
+            reg->setValue(header.registers[ix]);
+        } else if (auto addressRegister = dynamic_cast<AddressRegister*>(component(ix)); addressRegister) {
+            addressRegister->setValue(header.registers[ix]);
+        }
+    }
+    memory()->setValue(header.registers[MEMADDR]);
+    bus().initialize(header.lines & StateFileHeader::XData, header.lines & StateFileHeader::XAddr,
+        header.lines & StateFileHeader::IO, header.getID, header.putID, header.opflags,
+        header.dataBus, header.addrBus);
+    bus().setFlags(header.flags);
+    bus().restoreLines(header.lines & StateFileHeader::Halt, header.lines & StateFileHeader::Sus,
+        header.lines & StateFileHeader::NMI);
+    controller()->restoreSequencerState(header.sequencer);
+    m_phase = (header.phase == IOClock) ? IOClock : SystemClock;
+    if (m_callStack) {
+        m_callStack->reset();
+    }
+    if (m_history) {
+        startHistory();
+    }
+    error(NoError);
+}
+
+/**
+ * Saves the complete state of the machine: the registers, the bus, the
+ * Controller's sequencer, and the contents of all RAM banks. ROM banks are
+ * only identified by their hash. Statistics and instrumentation are not
+ * part of the state. Must be called while the system is stopped.
+ *
+ * @return The state in the format described in statefile.h.
+ */
+std::vector<byte> BackPlane::saveState()
+{
+    auto header = captureState();
+    auto banks = memory()->banks();
+    header.banks = banks.size();
+    std::vector<StateBankInfo> infos;
+    size_t size = sizeof(StateFileHeader) + banks.size() * sizeof(StateBankInfo);
+    std::vector<byte> image;
+    for (auto& bank : banks) {
+        StateBankInfo info;
+        info.start = bank.start();
+        info.size = bank.size();
+        info.writable = bank.writable();
+        image.resize(bank.size());
+        memory()->read(bank.start(), bank.size(), image.data());
+        info.hash = imageHash(image.data(), bank.size());
+        if (bank.writable()) {
+            info.offset = (size + STATE_ALIGNMENT - 1) & ~(STATE_ALIGNMENT - 1);
+            size = info.offset + bank.size();
+        }
+        infos.push_back(info);
+    }
+
+    std::vector<byte> ret(size);
+    memcpy(ret.data(), &header, sizeof(header));
+    memcpy(ret.data() + sizeof(header), infos.data(), infos.size() * sizeof(StateBankInfo));
+    for (auto& info : infos) {
+        if (info.writable) {
+            memory()->read(info.start, info.size, ret.data() + info.offset);
+        }
+    }
+    return ret;
+}
+
+bool BackPlane::saveState(const std::string& path)
+{
+    auto state = saveState();
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    file.write((const char*)state.data(), (std::streamsize)state.size());
+    return file.good();
+}
+
+/**
+ * Restores a state returned by saveState(). If the memory banks of the
+ * machine are laid out as in the saved state, the RAM contents are copied
+ * into the existing banks, which makes restoring the same state over and
+ * over again cheap. Otherwise the memory is rebuilt from the state.
+ *
+ * The ROM banks of the state must be loaded, at the same addresses, and
+ * their contents must match the saved hashes. Must be called while the
+ * system is stopped.
+ *
+ * @return false if the state is malformed or refers to ROM that is not
+ * loaded. The machine is left untouched in that case.
+ */
+bool BackPlane::loadState(const byte* data, size_t size)
+{
+    StateFileHeader header;
+    if (size < sizeof(header)) {
+        return false;
+    }
+    memcpy(&header, data, sizeof(header));
+    if (memcmp(header.magic, StateFileHeader().magic, sizeof(header.magic)) || (header.version != 1)
+        || (header.banks > 256) || (size < sizeof(header) + header.banks * sizeof(StateBankInfo))
+        || ((header.phase != SystemClock) && (header.phase != IOClock))
+        || !controller()->validSequencerState(header.sequencer, header.registers[IR])) {
+        return false;
+    }
+    std::vector<StateBankInfo> infos(header.banks);
+    memcpy(infos.data(), data + sizeof(header), infos.size() * sizeof(StateBankInfo));
+
+    auto banks = memory()->banks();
+    auto sameLayout = banks.size() == infos.size();
+    std::vector<std::vector<byte>> roms(infos.size());
+    auto bank = banks.begin();
+    for (auto ix = 0u; ix < infos.size(); ix++) {
+        auto& info = infos[ix];
+        if (info.start + info.size > 0x10000) {
+            return false;
+        }
+        if (info.writable) {
+            if ((info.offset > size) || (info.size > size - info.offset)) {
+                return false;
+            }
+        } else {
+            auto loaded = std::any_of(banks.begin(), banks.end(), [&info](const MemoryBank& b) {
+                return !b.writable() && (b.start() == info.start) && (b.size() == info.size);
+            });
+            if (!loaded) {
+                return false;
+            }
+            roms[ix].resize(info.size);
+            memory()->read(info.start, info.size, roms[ix].data());
+            if (imageHash(roms[ix].data(), info.size) != info.hash) {
+                return false;
+            }
+        }
+        if (sameLayout) {
+            sameLayout = (bank->start() == info.start) && (bank->size() == info.size)
+                && (bank->writable() == (bool)info.writable);
+            bank++;
+        }
+    }
+    if (!sameLayout) {
+        // Rebuilding the memory must not fail halfway, so overlapping banks
+        // are rejected before anything is changed:
+        auto sorted = infos;
+        std::sort(sorted.begin(), sorted.end(), [](const StateBankInfo& a, const StateBankInfo& b) {
+            return a.start < b.start;
+        });
+        for (auto ix = 1u; ix < sorted.size(); ix++) {
+            if (sorted[ix - 1].start + sorted[ix - 1].size > sorted[ix].start) {
+                return false;
+            }
+        }
+    }
+
+    if (sameLayout) {
+        for (auto& info : infos) {
+            if (info.writable) {
+                memory()->write(info.start, info.size, data + info.offset);
+            }
+        }
+    } else {
+        memory()->initialize();
+        for (auto ix = 0u; ix < infos.size(); ix++) {
+            auto& info = infos[ix];
+            auto contents = (info.writable) ? data + info.offset : roms[ix].data();
+            if (!memory()->add(MemoryBank(info.start, info.size, info.writable, contents))) {
+                return false;
+            }
+        }
+    }
+    memory()->imageRestored();
+    restoreState(header);
+    return true;
+}
+
+bool BackPlane::loadState(const std::string& path)
+{
+    StateFile file(path);
+    return file.valid() && loadState(file.data(), file.size());
+}
+
+/**
+ * Creates a copy of the machine which shares all memory pages with this
+ * one, see Memory::fork(). The state of the registers, the bus, and the
+ * Controller is copied, as are the engine and clock settings. IO channels,
+ * breakpoints, and instrumentation are not. Must be called while the system
+ * is stopped.
+ */
+std::unique_ptr<BackPlane> BackPlane::fork()
+{
+    auto ret = std::make_unique<BackPlane>();
+    ret->insertComponents(new Memory());
+    ret->memory()->fork(*memory());
+    ret->restoreState(captureState());
+    ret->setEngine(m_engine);
+    ret->setRunMode(runMode());
+    ret->setFreeRunning(freeRunning());
+    ret->setClockSpeed(clockSpeed());
+    return ret;
+}
+
 void BackPlane::run(word fromAddress)
 {
     if (!bus().sus()) {
@@ -93,8 +337,560 @@ void BackPlane::run(word fromAddress)
     auto* pc = dynamic_cast<AddressRegister*>(component(PC));
     if ((fromAddress != 0xFFFF) && (fromAddress != pc->getValue())) {
         pc->setValue(fromAddress);
+        if (m_history) {
+            startHistory();
+        }
+        if (m_inputLog && !m_inputLog->replaying()) {
+            recordInput();
+        }
     }
-    clock.start();
+    m_instructionsAtStart = controller()->instructions();
+    m_limitCycles = 0;
+    controller()->setBreakpoints((!m_breakpoints.empty()) ? &m_breakpoints : nullptr);
+    if (m_snapshots) {
+        m_snapshots->invalidate();
+        publishSnapshot();
+    }
+    if ((m_engine == Functional) && (runMode() == SystemBus::Continuous)) {
+        runFunctional();
+    } else {
+        m_functionalRun = false;
+        clock.start();
+    }
+    if (m_snapshots) {
+        publishSnapshot();
+    }
+}
+
+/**
+ * Makes the system publish snapshots of its state while it runs: when a run
+ * starts and ends, and every SNAPSHOT_INTERVAL cycles in between. Must be
+ * called while the system is stopped.
+ */
+void BackPlane::enableSnapshots()
+{
+    if (!m_snapshots) {
+        m_snapshots = std::make_unique<SnapshotBuffer>();
+    }
+}
+
+/**
+ * @return The most recently published snapshot, or nullptr if snapshots
+ * are not enabled or nothing was published yet. Safe to call from another
+ * thread than the one running the system, but only from one thread. The
+ * snapshot remains valid until the next call.
+ */
+const MachineState* BackPlane::snapshot()
+{
+    return (m_snapshots) ? m_snapshots->latest() : nullptr;
+}
+
+/**
+ * Makes the system record the state of the bus and the controller in a
+ * CycleTrace every system clock cycle, after the data on the bus has been
+ * latched. The trace holds the
+ * last <capacity> cycles. Cycles executed by the FunctionalEngine are not
+ * traced. Must be called while the system is stopped.
+ *
+ * traceTo() sends the same records to a TraceWriter, which keeps all of
+ * them. The writer is not owned by the system.
+ */
+void BackPlane::enableTrace(size_t capacity)
+{
+    if (!m_trace || (m_trace->capacity() < capacity)) {
+        m_trace = std::make_unique<CycleTrace>(capacity);
+    }
+}
+
+/**
+ * Makes the Controller and the FunctionalEngine count executed
+ * instructions and microcode steps. Counting continues across runs until
+ * disableCounters() is called. Must be called while the system is stopped.
+ *
+ * @return The counters, which remain owned by the system.
+ */
+ExecutionCounters* BackPlane::enableCounters()
+{
+    if (!m_counters) {
+        m_counters = std::make_unique<ExecutionCounters>(controller()->microCodeTable());
+        controller()->setCounters(m_counters.get());
+    }
+    return m_counters.get();
+}
+
+void BackPlane::disableCounters()
+{
+    controller()->setCounters(nullptr);
+    m_counters.reset();
+}
+
+/**
+ * Makes the Controller and the FunctionalEngine maintain a shadow call
+ * stack. Like the counters, the call statistics accumulate across runs
+ * until disableCallStack() is called. A reset drops the frames but keeps
+ * the statistics. Must be called while the system is stopped.
+ *
+ * @return The call stack, which remains owned by the system.
+ */
+CallStack* BackPlane::enableCallStack()
+{
+    if (!m_callStack) {
+        m_callStack = std::make_unique<CallStack>();
+        controller()->setCallStack(m_callStack.get());
+    }
+    return m_callStack.get();
+}
+
+void BackPlane::disableCallStack()
+{
+    controller()->setCallStack(nullptr);
+    m_callStack.reset();
+}
+
+/**
+ * Makes the Controller and the FunctionalEngine record which instructions
+ * are executed, and which way conditional instructions go. Coverage
+ * accumulates across runs and resets until disableCoverage() is called.
+ * Must be called while the system is stopped.
+ *
+ * @return The coverage bitmaps, which remain owned by the system.
+ */
+Coverage* BackPlane::enableCoverage()
+{
+    if (!m_coverage) {
+        m_coverage = std::make_unique<Coverage>(controller()->microCodeTable());
+        controller()->setCoverage(m_coverage.get());
+    }
+    return m_coverage.get();
+}
+
+void BackPlane::disableCoverage()
+{
+    controller()->setCoverage(nullptr);
+    m_coverage.reset();
+}
+
+/**
+ * Makes the memory count reads and writes per byte and track the use of
+ * the stack, in both engines. The statistics accumulate across runs until
+ * disableMemoryProfile() is called. Must be called while the system is
+ * stopped.
+ *
+ * @return The profile, which remains owned by the system.
+ */
+MemoryProfile* BackPlane::enableMemoryProfile()
+{
+    if (!m_memoryProfile) {
+        m_memoryProfile = std::make_unique<MemoryProfile>();
+        memory()->setProfile(m_memoryProfile.get());
+    }
+    return m_memoryProfile.get();
+}
+
+void BackPlane::disableMemoryProfile()
+{
+    memory()->setProfile(nullptr);
+    m_memoryProfile.reset();
+}
+
+/**
+ * Records the execution history of both engines, so the machine can be
+ * stepped backwards with stepBack() and reverseContinue(). A checkpoint of
+ * the memory is taken every <interval> instructions, and at most
+ * <checkpoints> of them are kept. Must be called while the system is
+ * stopped.
+ *
+ * @return The history, which remains owned by the system.
+ */
+History* BackPlane::enableHistory(unsigned long interval, size_t checkpoints)
+{
+    if (!m_history) {
+        m_history = std::make_unique<History>(*memory(), interval, checkpoints);
+        memory()->setHistory(m_history.get());
+        controller()->setHistory(m_history.get());
+        startHistory();
+    }
+    return m_history.get();
+}
+
+void BackPlane::disableHistory()
+{
+    memory()->setHistory(nullptr);
+    controller()->setHistory(nullptr);
+    m_history.reset();
+}
+
+/**
+ * Starts the history over at the current state of the machine. Only
+ * instruction boundaries can be returned to, so if the machine is in the
+ * middle of an instruction the history starts at the next boundary.
+ */
+void BackPlane::startHistory()
+{
+    m_history->clear();
+    if (controller()->getStep() > 2) {
+        return;
+    }
+    HistoryRecord record;
+    for (int ix = GP_A; ix <= GP_D; ix++) {
+        record.gp[ix] = component(ix)->getValue();
+    }
+    record.lhs = component(LHS)->getValue();
+    record.rhs = component(RHS)->getValue();
+    record.ir = controller()->getValue();
+    record.pc = component(PC)->getValue();
+    record.sp = component(SP)->getValue();
+    record.si = component(Si)->getValue();
+    record.di = component(Di)->getValue();
+    record.tx = component(TX)->getValue();
+    record.memAddr = memory()->getValue();
+    record.flags = bus().flags();
+    record.scratch = controller()->scratch();
+    record.interruptVector = controller()->interruptVector();
+    record.servicingNMI = controller()->servicingNMI();
+    record.nmi = bus().nmi();
+    record.step = controller()->getStep();
+    m_history->instruction(record);
+}
+
+/**
+ * Puts the machine back at instruction boundary <instruction> of the
+ * history. The machine is left ready to fetch the next instruction, with
+ * the same bus transfer pending as when it got there.
+ */
+bool BackPlane::seek(unsigned long instruction)
+{
+    HistoryRecord record;
+    if (!m_history->seek(instruction, record)) {
+        return false;
+    }
+    for (int ix = GP_A; ix <= GP_D; ix++) {
+        dynamic_cast<Register*>(component(ix))->setValue(record.gp[ix]);
+    }
+    dynamic_cast<Register*>(component(LHS))->setValue(record.lhs);
+    dynamic_cast<Register*>(component(RHS))->setValue(record.rhs);
+    dynamic_cast<AddressRegister*>(component(PC))->setValue(record.pc);
+    dynamic_cast<AddressRegister*>(component(SP))->setValue(record.sp);
+    dynamic_cast<AddressRegister*>(component(Si))->setValue(record.si);
+    dynamic_cast<AddressRegister*>(component(Di))->setValue(record.di);
+    dynamic_cast<AddressRegister*>(component(TX))->setValue(record.tx);
+    controller()->setValue(record.ir);
+    memory()->setValue(record.memAddr);
+    if (record.step == 1) {
+        bus().initialize(true, false, true, PC, MEMADDR, SystemBus::Inc);
+    } else {
+        bus().initialize(true, true, true, 0, 0, 0);
+    }
+    bus().setFlags(record.flags);
+    bus().restoreLines(true, true, record.nmi);
+    controller()->setState(record.step, record.scratch, record.interruptVector, record.servicingNMI);
+    m_phase = IOClock;
+    if (m_callStack) {
+        m_callStack->reset();
+    }
+    memory()->imageRestored();
+    error(NoError);
+    return true;
+}
+
+/**
+ * Steps back <n> instructions. If the machine stopped in the middle of an
+ * instruction, going back to the start of that instruction counts as the
+ * first step. The machine must be stopped.
+ *
+ * @return false if the history doesn't reach back that far. The machine is
+ * then left at the oldest instruction in the history.
+ */
+bool BackPlane::stepBack(unsigned long n)
+{
+    if (!m_history || m_history->empty() || !n) {
+        return false;
+    }
+    auto& last = m_history->record(m_history->position());
+    auto atBoundary = bus().halt() && (controller()->getStep() == last.step)
+        && (component(PC)->getValue() == last.pc);
+    if (!atBoundary) {
+        n--;
+    }
+    auto ret = n <= m_history->position() - m_history->first();
+    seek((ret) ? m_history->position() - n : m_history->first());
+    return ret;
+}
+
+/**
+ * Runs backwards until the last instruction boundary where the PC is a
+ * breakpoint, or to the start of the history if there is none. The machine
+ * must be stopped.
+ *
+ * @return true if the machine stopped at a breakpoint.
+ */
+bool BackPlane::reverseContinue()
+{
+    if (!m_history || m_history->empty()) {
+        return false;
+    }
+    unsigned long instruction;
+    if (m_history->findBreakpoint(m_breakpoints, instruction)) {
+        return seek(instruction);
+    }
+    seek(m_history->first());
+    return false;
+}
+
+/**
+ * Records the bytes read from the IO channels and the NMIs the machine
+ * receives, in both engines, so the run can be reproduced exactly with
+ * replayInput(). The recording starts with the current state of the
+ * machine, and starts over when the machine is reset or run from another
+ * address. NMIs should be raised through InputLog::nmi() while recording,
+ * which makes them take effect at a cycle boundary. Must be called while
+ * the system is stopped.
+ *
+ * @return The log, which remains owned by the system.
+ */
+InputLog* BackPlane::recordInput()
+{
+    if (!m_inputLog) {
+        m_inputLog = std::make_unique<InputLog>();
+    }
+    m_inputLog->record(saveState(), !bus().nmi());
+    attachInputLog(m_inputLog.get());
+    return m_inputLog.get();
+}
+
+/**
+ * Puts the machine in the state the recording in <log> started with, and
+ * makes the next runs take their input from the log. IO channels the log
+ * reads from are created if the system doesn't have them. Must be called
+ * while the system is stopped.
+ *
+ * @return false if the recorded state can't be restored, see loadState().
+ */
+bool BackPlane::replayInput(std::unique_ptr<InputLog> log)
+{
+    if (!log || !loadState(log->state().data(), log->state().size())) {
+        return false;
+    }
+    for (auto& event : log->events()) {
+        if ((event.channel != InputLog::NMI) && !channel(event.channel)) {
+            auto ch = new IOChannel(event.channel, "IN", []() -> byte {
+                return 0xFF;
+            });
+            m_owned.emplace_back(ch);
+            insertIO(ch);
+
+            // The FunctionalEngine looks up the channels when it's created:
+            m_functional.reset();
+            m_functionalRun = false;
+        }
+    }
+    log->replay();
+    m_inputLog = std::move(log);
+    attachInputLog(m_inputLog.get());
+    return true;
+}
+
+bool BackPlane::replayInput(const std::string& path)
+{
+    auto log = std::make_unique<InputLog>();
+    return log->load(path) && replayInput(std::move(log));
+}
+
+void BackPlane::disableInputLog()
+{
+    attachInputLog(nullptr);
+    m_inputLog.reset();
+}
+
+void BackPlane::attachInputLog(InputLog* log)
+{
+    controller()->setInputLog(log);
+    for (int ix = 0; ix < 16; ix++) {
+        if (auto ch = dynamic_cast<IOChannel*>(channel(ix)); ch) {
+            ch->setInputLog(log);
+        }
+    }
+}
+
+/**
+ * @return true if the last run stopped because it reached a breakpoint.
+ */
+bool BackPlane::atBreakpoint()
+{
+    return !bus().sus() && bus().halt() && m_breakpoints.test(component(PC)->getValue())
+        && (runMode() == SystemBus::Continuous);
+}
+
+/**
+ * Makes the system sample the program counter into <profiler>, or stops
+ * sampling if it is nullptr. The profiler is not owned by the system. Must
+ * be called while the system is stopped.
+ */
+void BackPlane::profileTo(Profiler* profiler)
+{
+    m_profiler = profiler;
+    m_profiledInstructions = controller()->instructions();
+}
+
+void BackPlane::profileCycle()
+{
+    if (m_profiler->mode() == Profiler::Instructions) {
+        auto instructions = controller()->instructions();
+        if (instructions == m_profiledInstructions) {
+            return;
+        }
+        m_profiledInstructions = instructions;
+    }
+    if (m_profiler->due()) {
+        m_profiler->sample(component(PC)->getValue());
+    }
+}
+
+void BackPlane::traceCycle()
+{
+    auto& b = bus();
+    auto c = controller();
+    CycleRecord r;
+    r.cycle = m_tracedCycles++;
+    r.pc = component(PC)->getValue();
+    r.dataBus = b.readDataBus();
+    r.addrBus = b.readAddrBus();
+    r.getID = b.getID();
+    r.putID = b.putID();
+    r.opflags = b.opflags();
+    r.flags = b.flags();
+    r.ir = c->getValue();
+    r.step = c->getStep();
+    r.lines = (b.xdata() ? CycleRecord::XData : 0)
+        | (b.xaddr() ? CycleRecord::XAddr : 0)
+        | (b.io() ? CycleRecord::IO : 0)
+        | (b.halt() ? CycleRecord::Halt : 0)
+        | (b.sus() ? CycleRecord::Sus : 0)
+        | (b.nmi() ? CycleRecord::NMI : 0);
+    if (m_trace) {
+        m_trace->record(r);
+    }
+    if (m_traceWriter) {
+        m_traceWriter->record(r);
+    }
+}
+
+void BackPlane::publishSnapshot()
+{
+    auto& state = m_snapshots->back();
+    for (int ix = GP_A; ix <= TX; ix++) {
+        auto c = component(ix);
+        state.registers[ix] = (c && (ix != MEM)) ? c->getValue() : 0;
+    }
+    state.registers[MEMADDR] = memory()->getValue();
+    auto& b = bus();
+    state.dataBus = b.readDataBus();
+    state.addrBus = b.readAddrBus();
+    state.getID = b.getID();
+    state.putID = b.putID();
+    state.opflags = b.opflags();
+    state.flags = b.flags();
+    state.xdata = b.xdata();
+    state.xaddr = b.xaddr();
+    state.io = b.io();
+    state.halt = b.halt();
+    state.sus = b.sus();
+    state.nmi = b.nmi();
+    state.step = controller()->getStep();
+    state.instruction = controller()->microCode()[controller()->getValue()].instruction;
+    m_snapshots->publish(*memory());
+    m_snapshotCountdown = SNAPSHOT_INTERVAL;
+}
+
+/**
+ * Runs the program using the FunctionalEngine. If the Controller is halfway
+ * through an instruction, for example because the machine was single-stepped
+ * before, that instruction is finished cycle by cycle first.
+ *
+ * Cycles are reported in the same unit as the Clock reports them: every
+ * system clock cycle is followed by an IO clock cycle, except for the last
+ * one, after which the clock stops.
+ */
+void BackPlane::runFunctional()
+{
+    if (!m_functional) {
+        m_functional = std::make_unique<FunctionalEngine>(*this);
+    }
+    if (!m_functional->valid()) {
+        m_functionalRun = false;
+        clock.start();
+        return;
+    }
+    m_functionalRun = true;
+    m_functionalPrologue = 0;
+    m_functional->setSnapshots(m_snapshots.get());
+    m_functional->setCounters(m_counters.get());
+    m_functional->setProfiler(m_profiler);
+    m_functional->setCallStack(m_callStack.get());
+    m_functional->setCoverage(m_coverage.get());
+    m_functional->setHistory(m_history.get());
+    m_functional->setInputLog(m_inputLog.get());
+    m_functional->setBreakpoints((!m_breakpoints.empty()) ? &m_breakpoints : nullptr);
+    while (!m_functional->atInstructionBoundary() && bus().halt() && bus().sus() && (error() == NoError)) {
+        onRisingClockEdge();
+        onHighClock();
+        onFallingClockEdge();
+        onLowClock();
+        m_functionalPrologue++;
+    }
+    if (!bus().halt() || !bus().sus() || (error() != NoError)) {
+        return;
+    }
+    if (m_phase == IOClock) {
+        m_functionalPrologue++;
+    }
+    // cycles() reports 2 * n - 1 cycles for n cycles of the engine:
+    m_functional->setCycleLimit((m_cycleLimit) ? (m_cycleLimit - m_functionalPrologue + 2) / 2 : 0);
+    if (m_profiler) {
+        m_profiledInstructions = controller()->instructions();
+    }
+    error(m_functional->run());
+    m_phase = IOClock;
+}
+
+void BackPlane::stop()
+{
+    clock.stop();
+    if (m_functional) {
+        m_functional->stop();
+    }
+}
+
+unsigned long BackPlane::cycles() const
+{
+    if (!m_functionalRun) {
+        return clock.cycles();
+    }
+    auto cycles = m_functional->cycles();
+    return (cycles) ? m_functionalPrologue + 2 * cycles - 1 : m_functionalPrologue;
+}
+
+/**
+ * @return The number of instructions completed in the current or last run.
+ */
+unsigned long BackPlane::instructions() const
+{
+    auto ret = controller()->instructions() - m_instructionsAtStart;
+    if (m_functionalRun) {
+        ret += m_functional->instructions();
+    }
+    return ret;
+}
+
+double BackPlane::elapsed() const
+{
+    return (m_functionalRun) ? m_functional->elapsed() : clock.elapsed();
+}
+
+double BackPlane::achievedFrequency() const
+{
+    auto secs = elapsed();
+    return (secs > 0.0) ? (double)cycles() / (1000.0 * secs) : 0.0;
 }
 
 SystemError BackPlane::reportError()
@@ -107,23 +903,24 @@ SystemError BackPlane::reportError()
     return error();
 }
 
-SystemError BackPlane::onClockEvent(const ComponentHandler& handler)
+SystemError BackPlane::onClockEvent(Component::ClockPhase phase)
 {
     if (error() != NoError) {
         return error();
     }
     switch (m_phase) {
     case SystemClock:
-        error(forAllComponents(handler));
-        if (error() == NoError) {
-            error(forAllChannels(handler));
-        }
-        return error();
+        error(forAddressedComponents(phase));
+        break;
     case IOClock:
         // xx
     default:
-        return NoError;
+        break;
+    }
+    if (m_vcd) {
+        m_vcd->sample(bus(), (phase == RisingClockEdge) || (phase == HighClock), m_phase == IOClock);
     }
+    return error();
 }
 
 SystemError BackPlane::reset()
@@ -132,11 +929,20 @@ SystemError BackPlane::reset()
         return error();
     }
     error(bus().reset());
+    if (m_callStack) {
+        m_callStack->reset();
+    }
     if (error() == NoError) {
         forAllComponents([](Component* c) -> SystemError {
             return (c) ? c->reset() : NoError;
         });
     }
+    if (m_history) {
+        startHistory();
+    }
+    if (m_inputLog && !m_inputLog->replaying()) {
+        recordInput();
+    }
     return NoError;
 }
 
@@ -157,24 +963,15 @@ SystemError BackPlane::onRisingClockEdge()
     if (error() != NoError) {
         return error();
     }
-    if (m_phase == SystemClock) {
-        if (m_output) {
-            status(*m_output);
-        }
-        if (error() != NoError) {
-            return error();
-        }
-    }
-    return onClockEvent([](Component* c) -> SystemError {
-        return (c) ? c->onRisingClockEdge() : NoError;
-    });
+    return onClockEvent(RisingClockEdge);
 }
 
 SystemError BackPlane::onHighClock()
 {
-    error(onClockEvent([](Component* c) -> SystemError {
-        return (c) ? c->onHighClock() : NoError;
-    }));
+    error(onClockEvent(HighClock));
+    if ((m_trace || m_traceWriter) && (m_phase == SystemClock)) {
+        traceCycle();
+    }
     if ((error() == NoError) && !bus().halt()) {
         stop();
     }
@@ -183,19 +980,24 @@ SystemError BackPlane::onHighClock()
 
 SystemError BackPlane::onFallingClockEdge()
 {
-    return onClockEvent([](Component* c) -> SystemError {
-        return (c) ? c->onFallingClockEdge() : NoError;
-    });
+    return onClockEvent(FallingClockEdge);
 }
 
 SystemError BackPlane::onLowClock()
 {
-    error(onClockEvent([](Component* c) -> SystemError {
-        return (c) ? c->onLowClock() : NoError;
-    }));
+    error(onClockEvent(LowClock));
+    if (m_cycleLimit && (++m_limitCycles >= m_cycleLimit)) {
+        bus().suspend();
+    }
     if ((error() == NoError) && (!bus().halt() || !bus().sus())) {
         stop();
     }
+    if (m_profiler && (m_phase == SystemClock)) {
+        profileCycle();
+    }
+    if (m_snapshots && (m_phase == SystemClock) && (--m_snapshotCountdown == 0)) {
+        publishSnapshot();
+    }
     m_phase = (m_phase == SystemClock) ? IOClock : SystemClock;
     return error();
 }
@@ -6,26 +6,78 @@
 
 #pragma once
 
+#include <cpu/breakpoints.h>
+#include <cpu/callstack.h>
 #include <cpu/clock.h>
 #include <cpu/controller.h>
+#include <cpu/counters.h>
+#include <cpu/coverage.h>
+#include <cpu/functionalengine.h>
+#include <cpu/history.h>
+#include <cpu/inputlog.h>
 #include <cpu/memory.h>
+#include <cpu/profiler.h>
+#include <cpu/snapshot.h>
+#include <cpu/statefile.h>
 #include <cpu/systembus.h>
+#include <cpu/trace.h>
+#include <cpu/tracefile.h>
+#include <cpu/vcd.h>
 #include <functional>
+#include <memory>
 #include <vector>
 
 namespace Obelix::JV80::CPU {
 
 class BackPlane : public ComponentContainer {
+public:
+    enum Engine {
+        CycleAccurate = 0,
+        Functional = 1,
+    };
+
 private:
     enum ClockPhase {
         SystemClock = 0x00,
         IOClock = 0x01,
     };
+    std::vector<std::unique_ptr<ConnectedComponent>> m_owned;
     Clock clock;
     ClockPhase m_phase = SystemClock;
-    std::ostream* m_output = nullptr;
+    std::unique_ptr<CycleTrace> m_trace;
+    TraceWriter* m_traceWriter = nullptr;
+    uint64_t m_tracedCycles = 0;
+    VcdWriter* m_vcd = nullptr;
+    std::unique_ptr<ExecutionCounters> m_counters;
+    Profiler* m_profiler = nullptr;
+    unsigned long m_profiledInstructions = 0;
+    std::unique_ptr<CallStack> m_callStack;
+    Breakpoints m_breakpoints;
+    std::unique_ptr<Coverage> m_coverage;
+    std::unique_ptr<MemoryProfile> m_memoryProfile;
+    std::unique_ptr<History> m_history;
+    std::unique_ptr<InputLog> m_inputLog;
+    Engine m_engine = CycleAccurate;
+    std::unique_ptr<FunctionalEngine> m_functional;
+    bool m_functionalRun = false;
+    unsigned long m_functionalPrologue = 0;
+    unsigned long m_instructionsAtStart = 0;
+    std::unique_ptr<SnapshotBuffer> m_snapshots;
+    int m_snapshotCountdown = SNAPSHOT_INTERVAL;
+    unsigned long m_cycleLimit = 0;
+    unsigned long m_limitCycles = 0;
 
-    SystemError onClockEvent(const ComponentHandler&);
+    void insertComponents(Memory*);
+    StateFileHeader captureState();
+    void restoreState(const StateFileHeader&);
+    void startHistory();
+    bool seek(unsigned long);
+    void attachInputLog(InputLog*);
+    SystemError onClockEvent(Component::ClockPhase);
+    void runFunctional();
+    void publishSnapshot();
+    void traceCycle();
+    void profileCycle();
 
 protected:
     SystemError reportError() override;
@@ -34,13 +86,17 @@ public:
     BackPlane();
     ~BackPlane() override = default;
     void run(word = 0x0000);
-    void stop() { clock.stop(); }
+    void stop();
     SystemBus::RunMode runMode();
     void setRunMode(SystemBus::RunMode runMode);
     Controller* controller() const;
     Memory* memory() const;
     void loadImage(word, const byte*, word addr = 0, bool writable = true);
-    void setOutputStream(std::ostream& os) { m_output = &os; }
+    std::vector<byte> saveState();
+    bool saveState(const std::string&);
+    bool loadState(const byte*, size_t);
+    bool loadState(const std::string&);
+    std::unique_ptr<BackPlane> fork();
 
     std::ostream& status(std::ostream&) override;
     SystemError reset() override;
@@ -51,6 +107,51 @@ public:
 
     bool setClockSpeed(double);
     double clockSpeed();
+    void setFreeRunning(bool freeRunning) { clock.setFreeRunning(freeRunning); }
+    bool freeRunning() const { return clock.freeRunning(); }
+    unsigned long cycles() const;
+    unsigned long instructions() const;
+    double elapsed() const;
+    double achievedFrequency() const;
+    void setEngine(Engine engine) { m_engine = engine; }
+    void setCycleLimit(unsigned long limit) { m_cycleLimit = limit; }
+    unsigned long cycleLimit() const { return m_cycleLimit; }
+    Engine engine() const { return m_engine; }
+    void enableSnapshots();
+    const MachineState* snapshot();
+    void enableTrace(size_t = CycleTrace::DEFAULT_CAPACITY);
+    void disableTrace() { m_trace.reset(); }
+    const CycleTrace* trace() const { return m_trace.get(); }
+    void traceTo(TraceWriter* writer) { m_traceWriter = writer; }
+    void dumpTo(VcdWriter* vcd) { m_vcd = vcd; }
+    ExecutionCounters* enableCounters();
+    void disableCounters();
+    ExecutionCounters* counters() const { return m_counters.get(); }
+    void profileTo(Profiler*);
+    Profiler* profiler() const { return m_profiler; }
+    CallStack* enableCallStack();
+    void disableCallStack();
+    CallStack* callStack() const { return m_callStack.get(); }
+    Breakpoints& breakpoints() { return m_breakpoints; }
+    Coverage* enableCoverage();
+    void disableCoverage();
+    Coverage* coverage() const { return m_coverage.get(); }
+    MemoryProfile* enableMemoryProfile();
+    void disableMemoryProfile();
+    MemoryProfile* memoryProfile() const { return m_memoryProfile.get(); }
+    History* enableHistory(unsigned long = History::DEFAULT_INTERVAL, size_t = History::DEFAULT_CHECKPOINTS);
+    void disableHistory();
+    History* history() const { return m_history.get(); }
+    bool stepBack(unsigned long = 1);
+    bool reverseContinue();
+    InputLog* recordInput();
+    bool replayInput(std::unique_ptr<InputLog>);
+    bool replayInput(const std::string&);
+    void disableInputLog();
+    InputLog* inputLog() const { return m_inputLog.get(); }
+    bool atBreakpoint();
+
+    constexpr static int SNAPSHOT_INTERVAL = 16384;
 
     void defaultSetup();
 };
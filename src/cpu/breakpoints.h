@@ -0,0 +1,66 @@
+/*
+ * Copyright (c) 2021, Jan de Visser <jan@finiandarcy.com>
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#pragma once
+
+#include <bitset>
+#include <vector>
+
+#include <cpu/component.h>
+
+namespace Obelix::JV80::CPU {
+
+/**
+ * Set of addresses at which a run stops. The system checks the PC when an
+ * instruction completes, so execution stops before the instruction at the
+ * breakpoint is executed, and continuing from a breakpoint does not stop
+ * at that same breakpoint again.
+ */
+class Breakpoints {
+public:
+    void set(word address)
+    {
+        if (!m_addresses.test(address)) {
+            m_addresses.set(address);
+            m_count++;
+        }
+    }
+
+    void clear(word address)
+    {
+        if (m_addresses.test(address)) {
+            m_addresses.reset(address);
+            m_count--;
+        }
+    }
+
+    void clear()
+    {
+        m_addresses.reset();
+        m_count = 0;
+    }
+
+    bool test(word address) const { return m_addresses.test(address); }
+    bool empty() const { return m_count == 0; }
+    size_t size() const { return m_count; }
+
+    std::vector<word> list() const
+    {
+        std::vector<word> ret;
+        for (auto addr = 0; (addr < 0x10000) && (ret.size() < m_count); addr++) {
+            if (m_addresses.test(addr)) {
+                ret.push_back(addr);
+            }
+        }
+        return ret;
+    }
+
+private:
+    std::bitset<0x10000> m_addresses;
+    size_t m_count = 0;
+};
+
+}
@@ -0,0 +1,151 @@
+/*
+ * Copyright (c) 2021, Jan de Visser <jan@finiandarcy.com>
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include <algorithm>
+#include <cstdio>
+
+#include <cpu/callstack.h>
+#include <cpu/controller.h>
+#include <cpu/opcodes.h>
+
+namespace Obelix::JV80::CPU {
+
+/**
+ * Called by the engines when instruction <opcode>, dispatched with the PC at
+ * <dispatchPC>, completes with the PC at <pc>. For a call <dispatchPC> is
+ * one past the opcode, for an NMI it is the address of the instruction the
+ * NMI interrupted. Once a call completes the PC holds its target, once a
+ * return completes the address it went back to.
+ */
+void CallStack::completed(int opcode, word dispatchPC, word pc)
+{
+    switch (opcode) {
+    case CALL:
+    case CALL_ABS:
+        call(dispatchPC - 1, pc, dispatchPC + 2, false);
+        break;
+    case MicroCodeTable::NMI:
+        call(dispatchPC, pc, dispatchPC, true);
+        break;
+    case RET:
+    case RTI:
+        ret(pc);
+        break;
+    default:
+        break;
+    }
+}
+
+/**
+ * Pushes a frame for a call from <callSite> to <target>. If the stack is
+ * MAX_DEPTH frames deep the oldest frame is dropped.
+ */
+void CallStack::call(word callSite, word target, word returnAddress, bool interrupt)
+{
+    if (m_frames.size() >= MAX_DEPTH) {
+        m_frames.erase(m_frames.begin());
+    }
+    m_frames.push_back({ callSite, target, returnAddress, interrupt, m_cycles, 0 });
+}
+
+/**
+ * Pops the frames up to and including the innermost one returning to <pc>.
+ */
+void CallStack::ret(word pc)
+{
+    auto it = std::find_if(m_frames.rbegin(), m_frames.rend(), [pc](const CallFrame& frame) {
+        return frame.returnAddress == pc;
+    });
+    if (it == m_frames.rend()) {
+        m_mismatches++;
+        return;
+    }
+    auto depth = m_frames.rend() - it - 1;
+    while (m_frames.size() > (size_t)depth) {
+        pop(m_frames, m_routines, m_cycles);
+    }
+}
+
+void CallStack::pop(std::vector<CallFrame>& frames, std::map<word, RoutineStats>& routines, unsigned long cycles)
+{
+    auto& frame = frames.back();
+    auto duration = cycles - frame.entryCycle;
+    auto& stats = routines[frame.target];
+    stats.calls++;
+    stats.inclusive += duration;
+    stats.exclusive += duration - frame.calleeCycles;
+    frames.pop_back();
+    if (!frames.empty()) {
+        frames.back().calleeCycles += duration;
+    }
+}
+
+/**
+ * @return The statistics of all routines, including the activations which
+ * are still on the stack.
+ */
+std::map<word, RoutineStats> CallStack::routines() const
+{
+    auto ret = m_routines;
+    auto frames = m_frames;
+    while (!frames.empty()) {
+        pop(frames, ret, m_cycles);
+    }
+    return ret;
+}
+
+void CallStack::clear()
+{
+    m_frames.clear();
+    m_routines.clear();
+    m_cycles = 0;
+    m_mismatches = 0;
+}
+
+/**
+ * Writes the frames on the stack, innermost first, starting with the
+ * current <pc>.
+ */
+std::ostream& CallStack::backtrace(std::ostream& os, word pc, const SymbolTable* symbols) const
+{
+    char buf[120];
+    auto location = [symbols](word address) {
+        return (symbols && !symbols->empty()) ? symbols->format(address) : std::string();
+    };
+    snprintf(buf, 120, "#0  %04x  %s", pc, location(pc).c_str());
+    os << buf << std::endl;
+    auto level = 1;
+    for (auto it = m_frames.rbegin(); it != m_frames.rend(); it++, level++) {
+        snprintf(buf, 120, "#%-2d %04x  %s%s", level, it->callSite, location(it->callSite).c_str(),
+            (it->interrupt) ? " <NMI>" : "");
+        os << buf << std::endl;
+    }
+    return os;
+}
+
+/**
+ * Lists the <count> routines with the most inclusive cycles.
+ */
+std::ostream& CallStack::writeProfile(std::ostream& os, const SymbolTable* symbols, size_t count) const
+{
+    auto stats = routines();
+    std::vector<std::pair<word, RoutineStats>> sorted(stats.begin(), stats.end());
+    std::stable_sort(sorted.begin(), sorted.end(), [](auto& r1, auto& r2) {
+        return r1.second.inclusive > r2.second.inclusive;
+    });
+
+    char buf[120];
+    os << "     Calls   Inclusive   Exclusive  Routine" << std::endl;
+    for (auto ix = 0u; (ix < sorted.size()) && (ix < count); ix++) {
+        auto& [target, s] = sorted[ix];
+        snprintf(buf, 120, "%10lu  %10lu  %10lu  %04x %s", s.calls, s.inclusive, s.exclusive, target,
+            (symbols && !symbols->empty()) ? symbols->format(target).c_str() : "");
+        os << buf << std::endl;
+    }
+    return os;
+}
+
+}
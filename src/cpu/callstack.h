@@ -0,0 +1,77 @@
+/*
+ * Copyright (c) 2021, Jan de Visser <jan@finiandarcy.com>
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#pragma once
+
+#include <map>
+#include <ostream>
+#include <vector>
+
+#include <cpu/profiler.h>
+
+namespace Obelix::JV80::CPU {
+
+struct CallFrame {
+    word callSite = 0; // Address of the call, or of the interrupted instruction
+    word target = 0; // Entry point of the routine
+    word returnAddress = 0;
+    bool interrupt = false;
+    unsigned long entryCycle = 0;
+    unsigned long calleeCycles = 0; // Cycles spent in routines called from this one
+};
+
+struct RoutineStats {
+    unsigned long calls = 0;
+    unsigned long inclusive = 0;
+    unsigned long exclusive = 0;
+};
+
+/**
+ * Shadow of the guest call stack.
+ *
+ * The Controller and the FunctionalEngine push a frame when a CALL, CALL_ABS
+ * or NMI completes and pop when a RET or RTI completes, so backtraces never
+ * depend on the contents of guest memory. A return pops every frame up to
+ * and including the one it returns to. A return to an address which is not
+ * on the stack, for instance a RET used as a computed jump, is counted as a
+ * mismatch and leaves the stack alone.
+ *
+ * Cycles are counted in system clock cycles. Every activation of a routine
+ * is counted, so the inclusive cycles of recursive routines include the
+ * cycles of the nested activations more than once.
+ */
+class CallStack {
+public:
+    void tick() { m_cycles++; }
+    unsigned long cycles() const { return m_cycles; }
+
+    void call(word, word, word, bool);
+    void ret(word);
+    void completed(int, word, word);
+
+    const std::vector<CallFrame>& frames() const { return m_frames; }
+    size_t depth() const { return m_frames.size(); }
+    unsigned long mismatches() const { return m_mismatches; }
+    std::map<word, RoutineStats> routines() const;
+
+    void reset() { m_frames.clear(); }
+    void clear();
+
+    std::ostream& backtrace(std::ostream&, word, const SymbolTable* = nullptr) const;
+    std::ostream& writeProfile(std::ostream&, const SymbolTable* = nullptr, size_t = 20) const;
+
+    constexpr static size_t MAX_DEPTH = 1024;
+
+private:
+    std::vector<CallFrame> m_frames;
+    std::map<word, RoutineStats> m_routines;
+    unsigned long m_cycles = 0;
+    unsigned long m_mismatches = 0;
+
+    static void pop(std::vector<CallFrame>&, std::map<word, RoutineStats>&, unsigned long);
+};
+
+}
@@ -4,9 +4,8 @@
  * SPDX-License-Identifier: GPL-3.0-or-later
  */
 
-// #include <chrono>
+#include <chrono>
 #include <cmath>
-#include <ctime>
 #include <thread>
 
 #include <cpu/clock.h>
@@ -18,7 +17,7 @@ namespace Obelix::JV80::CPU {
  */
 unsigned long Clock::tick() const
 {
-    return (unsigned long)round(1000000.0 / (2.0 * khz));
+    return (unsigned long)round(1000000.0 / (2.0 * frequency()));
 }
 
 ClockListener* Clock::setListener(ClockListener* listener)
@@ -35,20 +34,49 @@ void Clock::sendEvent(ClockListener::ClockEvent event)
     }
 }
 
-void Clock::sleep() const
+/**
+ * @return The number of cycles to run back to back before checking the
+ * deadline, i.e. the number of cycles in PACING_INTERVAL_MS of guest time.
+ */
+unsigned long Clock::batchSize(double freq) const
 {
-    // auto start = std::chrono::high_resolution_clock::now();
-    struct timespec req = { 0 };
-    req.tv_sec = 0;
-    req.tv_nsec = tick();
-    nanosleep(&req, (struct timespec*)nullptr);
-    // auto finish = std::chrono::high_resolution_clock::now();
-    //  std::cout << std::chrono::duration_cast<std::chrono::microseconds>(finish - start).count() << std::endl;
+    if (m_freeRunning) {
+        return FREE_RUNNING_BATCH;
+    }
+    auto ret = (unsigned long)(freq * PACING_INTERVAL_MS);
+    return (ret > 0) ? ret : 1;
 }
 
+/**
+ * Runs the owner's clock phases until the clock is stopped or an error
+ * occurs.
+ *
+ * Instead of sleeping after every phase, which costs a kernel round trip
+ * that is much longer than a tick at higher frequencies, the clock runs
+ * batches of cycles back to back and then sleeps until the absolute time
+ * at which the last cycle of the batch should have finished. Because the
+ * deadline is computed from the start of the run and not from the end of
+ * the previous sleep, oversleeping in one batch is made up in the next.
+ * If the host falls more than MAX_LAG_MS behind, for example because the
+ * process was descheduled, the schedule is restarted from the current
+ * time instead of running flat out to catch up.
+ */
 SystemError Clock::start()
 {
+    using namespace std::chrono;
+
     SystemError err = NoError;
+    unsigned long cycles = 0;
+    m_cycles.store(0, std::memory_order_relaxed);
+    m_elapsed.store(0.0, std::memory_order_relaxed);
+
+    auto started = steady_clock::now();
+    auto epoch = started;
+    unsigned long epochCycles = 0;
+    double pacedKhz = frequency();
+    bool paced = !m_freeRunning;
+    unsigned long checkpoint = batchSize(pacedKhz);
+
     sendEvent(ClockListener::Started);
     for (state = Running; err == NoError && state == Running;) {
         if ((err = owner->onRisingClockEdge()) != NoError) {
@@ -57,15 +85,41 @@ SystemError Clock::start()
         if ((err = owner->onHighClock()) != NoError) {
             break;
         };
-        sleep();
         if ((err = owner->onFallingClockEdge()) != NoError) {
             break;
         };
         if ((err = owner->onLowClock()) != NoError) {
             break;
         }
-        sleep();
+        if (++cycles < checkpoint) {
+            continue;
+        }
+
+        auto now = steady_clock::now();
+        m_cycles.store(cycles, std::memory_order_relaxed);
+        m_elapsed.store(duration<double>(now - started).count(), std::memory_order_relaxed);
+        if (!m_freeRunning) {
+            if (!paced || (frequency() != pacedKhz)) {
+                pacedKhz = frequency();
+                paced = true;
+                epoch = now;
+                epochCycles = cycles;
+            } else {
+                auto deadline = epoch + duration_cast<steady_clock::duration>(duration<double, std::milli>((double)(cycles - epochCycles) / pacedKhz));
+                if (now < deadline) {
+                    std::this_thread::sleep_until(deadline);
+                } else if (duration<double, std::milli>(now - deadline).count() > MAX_LAG_MS) {
+                    epoch = now;
+                    epochCycles = cycles;
+                }
+            }
+        } else {
+            paced = false;
+        }
+        checkpoint = cycles + batchSize(pacedKhz);
     }
+    m_cycles.store(cycles, std::memory_order_relaxed);
+    m_elapsed.store(duration<double>(steady_clock::now() - started).count(), std::memory_order_relaxed);
     sendEvent((err != NoError) ? ClockListener::Error : ClockListener::Stopped);
     return err;
 }
@@ -77,8 +131,8 @@ void Clock::stop()
 
 bool Clock::setSpeed(double freq)
 {
-    if ((freq > 0) && (freq <= 1000)) {
-        khz = freq;
+    if ((freq > 0) && (freq <= MAX_FREQUENCY)) {
+        khz.store(freq, std::memory_order_relaxed);
         sendEvent(ClockListener::FreqChange);
         return true;
     } else {
@@ -86,4 +140,27 @@ bool Clock::setSpeed(double freq)
     }
 }
 
+/**
+ * In free-running mode the clock does not sleep between phases, and the
+ * system runs as fast as the host allows. The configured frequency is
+ * retained and used again when free-running mode is switched off.
+ */
+void Clock::setFreeRunning(bool freeRunning)
+{
+    m_freeRunning = freeRunning;
+    sendEvent(ClockListener::FreqChange);
+}
+
+/**
+ * @return Number of cycles per second achieved by the last (or current)
+ * run of the clock, in kHz. This is updated every PACING_INTERVAL_MS while
+ * the clock is running, so it can be compared with frequency() to see how
+ * well the host keeps up with the requested speed.
+ */
+double Clock::achievedFrequency() const
+{
+    auto secs = elapsed();
+    return (secs > 0.0) ? (double)cycles() / (1000.0 * secs) : 0.0;
+}
+
 }
@@ -6,6 +6,8 @@
 
 #pragma once
 
+#include <atomic>
+
 #include <cpu/component.h>
 
 namespace Obelix::JV80::CPU {
@@ -37,13 +39,17 @@ public:
     };
 
 private:
-    double khz;
+    // Set by the GUI thread while the clock runs on another one:
+    std::atomic<double> khz;
     Component* owner;
     State state = Stopped;
     ClockListener* m_listener = nullptr;
+    bool m_freeRunning = false;
+    std::atomic<unsigned long> m_cycles = 0;
+    std::atomic<double> m_elapsed = 0.0;
 
     void sendEvent(ClockListener::ClockEvent);
-    void sleep() const;
+    unsigned long batchSize(double) const;
 
 public:
     Clock(Component* o, double speed_khz)
@@ -54,7 +60,7 @@ public:
 
     virtual ~Clock() = default;
 
-    double frequency() { return khz; }
+    double frequency() const { return khz.load(std::memory_order_relaxed); }
 
     unsigned long tick() const;
 
@@ -64,6 +70,18 @@ public:
 
     bool setSpeed(double);
 
+    bool freeRunning() const { return m_freeRunning; }
+    void setFreeRunning(bool);
+
+    unsigned long cycles() const { return m_cycles.load(std::memory_order_relaxed); }
+    double elapsed() const { return m_elapsed.load(std::memory_order_relaxed); }
+    double achievedFrequency() const;
+
+    constexpr static double MAX_FREQUENCY = 10000.0;
+    constexpr static double PACING_INTERVAL_MS = 1.0;
+    constexpr static double MAX_LAG_MS = 50.0;
+    constexpr static unsigned long FREE_RUNNING_BATCH = 4096;
+
     ClockListener* setListener(ClockListener*);
 };
 
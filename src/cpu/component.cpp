@@ -8,18 +8,27 @@
 
 namespace Obelix::JV80::CPU {
 
-ComponentListener* Component::setListener(ComponentListener* l)
+/**
+ * Sets the listener for the events of this component. Only the events
+ * with their eventBit set in <mask> are sent to the listener.
+ *
+ * @return The previous listener.
+ */
+ComponentListener* Component::setListener(ComponentListener* l, unsigned int mask)
 {
     ComponentListener* old = listener;
     listener = l;
+    setEventMask(mask);
     return old;
 }
 
-void Component::sendEvent(int ev) const
+/**
+ * Changes the set of events sent to the listener. The mask is not
+ * synchronized with a running system; change it while the system is stopped.
+ */
+void Component::setEventMask(unsigned int mask)
 {
-    if (listener) {
-        listener->componentEvent(this, ev);
-    }
+    m_eventMask = (listener) ? mask : 0;
 }
 
 std::ostream& operator<<(std::ostream& os, Component& c)
@@ -37,10 +37,20 @@ public:
 class Component {
 private:
     ComponentListener* listener = nullptr;
+    unsigned int m_eventMask = 0;
     SystemError m_error = NoError;
 
 protected:
-    void sendEvent(int) const;
+    /*
+     * The mask is zero when there is no listener, so with nobody listening
+     * sending an event costs a single test.
+     */
+    void sendEvent(int ev) const
+    {
+        if (m_eventMask & eventBit(ev)) [[unlikely]] {
+            listener->componentEvent(this, ev);
+        }
+    }
 
     SystemError error(SystemError err)
     {
@@ -49,8 +59,25 @@ protected:
     }
 
 public:
+    enum ClockPhase {
+        RisingClockEdge = 0,
+        HighClock = 1,
+        FallingClockEdge = 2,
+        LowClock = 3,
+    };
+
+    enum ClockPhaseMask {
+        OnRisingClockEdge = 1 << RisingClockEdge,
+        OnHighClock = 1 << HighClock,
+        OnFallingClockEdge = 1 << FallingClockEdge,
+        OnLowClock = 1 << LowClock,
+        OnAllClockPhases = 0x0F,
+    };
+
     virtual ~Component() = default;
-    ComponentListener* setListener(ComponentListener*);
+    ComponentListener* setListener(ComponentListener*, unsigned int = ALL_EVENTS);
+    void setEventMask(unsigned int);
+    unsigned int eventMask() const { return m_eventMask; }
     SystemError error() const { return m_error; }
     virtual std::ostream& status(std::ostream& os) { return os; }
     virtual SystemError reset() { return error(NoError); }
@@ -59,11 +86,19 @@ public:
     virtual SystemError onFallingClockEdge() { return error(NoError); }
     virtual SystemError onLowClock() { return error(NoError); };
 
+    // The clock phases this component implements, as a ClockPhaseMask.
+    // Components are only called for the phases they declare here.
+    virtual int clockPhases() const { return OnAllClockPhases; }
+
     constexpr static int EV_VALUECHANGED = 0;
 
+    constexpr static unsigned int eventBit(int ev) { return 1u << ev; }
+    constexpr static unsigned int ALL_EVENTS = ~0u;
+
     friend std::ostream& operator<<(std::ostream&, Component&);
 };
 
 typedef std::function<void(Component*)> ComponentHandler;
+typedef SystemError (Component::*ClockHandler)();
 
 }
@@ -8,10 +8,19 @@
 #include <cstring>
 #include <iomanip>
 #include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
 #include <vector>
 
 #include <cpu/addressregister.h>
+#include <cpu/breakpoints.h>
+#include <cpu/callstack.h>
 #include <cpu/controller.h>
+#include <cpu/counters.h>
+#include <cpu/coverage.h>
+#include <cpu/history.h>
+#include <cpu/inputlog.h>
 #include <cpu/opcodes.h>
 #include <cpu/register.h>
 #include <cpu/registers.h>
@@ -35,69 +44,102 @@ static MicroCode mcNMI = {
                                                                          }
 };
 
-MicroCodeRunner::MicroCodeRunner(Controller* controller, SystemBus* bus, const MicroCode* microCode)
-    : m_controller(controller)
-    , m_bus(bus)
-    , mc(microCode)
-    , steps()
+MicroCodeTable::MicroCodeTable(const MicroCode* microCode)
+    : m_microCode(microCode)
 {
-
-    evaluateCondition();
-    fetchSteps();
-    if (!(mc->addressingMode & AddressingMode::Done)) {
-        int ix = -1;
-        do {
-            ix++;
-            steps.emplace_back(mc->steps[ix]);
-        } while (!(mc->steps[ix].opflags & SystemBus::Done));
+    size_t offsets[257][2];
+    for (int opcode = 0; opcode <= NMI; opcode++) {
+        auto mc = (opcode < NMI) ? m_microCode + opcode : &mcNMI;
+        for (int valid = 0; valid < 2; valid++) {
+            offsets[opcode][valid] = m_steps.size();
+            if (mc->opcode) {
+                expand(mc, valid, m_steps);
+            }
+        }
+    }
+    m_steps.shrink_to_fit();
+
+    for (int opcode = 0; opcode <= NMI; opcode++) {
+        auto mc = (opcode < NMI) ? m_microCode + opcode : &mcNMI;
+        for (int valid = 0; valid < 2; valid++) {
+            auto& entry = m_entries[opcode][valid];
+            auto end = ((valid == 0) ? offsets[opcode][1] : ((opcode < NMI) ? offsets[opcode + 1][0] : m_steps.size()));
+            entry.microCode = (mc->opcode) ? mc : nullptr;
+            entry.steps = m_steps.data() + offsets[opcode][valid];
+            entry.size = (int)(end - offsets[opcode][valid]);
+
+            // Every operand byte is fetched by a step moving PC to MEMADDR
+            // and incrementing it:
+            for (auto ix = 0; ix < entry.size; ix++) {
+                auto& s = entry.steps[ix];
+                if ((s.action == MicroCode::XADDR) && (s.src == PC) && (s.target == MEMADDR) && (s.opflags & SystemBus::Inc)) {
+                    entry.length++;
+                }
+            }
+        }
     }
 }
 
-void MicroCodeRunner::evaluateCondition()
+/**
+ * Returns the table for the microcode <microCode>. The table is built the
+ * first time it is requested and shared by all Controllers and
+ * FunctionalEngines using the same microcode.
+ */
+const MicroCodeTable& MicroCodeTable::get(const MicroCode* microCode)
 {
-    byte valid_byte;
-    switch (mc->condition_op) {
-    case MicroCode::And:
-        valid_byte = m_bus->isSet((SystemBus::ProcessorFlags)mc->condition);
-        break;
-    case MicroCode::Nand:
-        valid_byte = !m_bus->isSet((SystemBus::ProcessorFlags)mc->condition);
-        break;
-    default:
-        valid_byte = true;
-        break;
+    static std::mutex mutex;
+    static std::map<const MicroCode*, std::unique_ptr<MicroCodeTable>> tables;
+
+    std::lock_guard<std::mutex> lock(mutex);
+    auto& table = tables[microCode];
+    if (!table) {
+        table.reset(new MicroCodeTable(microCode));
     }
-    valid = valid_byte != 0;
+    return *table;
 }
 
-void MicroCodeRunner::fetchSteps()
+/**
+ * Appends the microcode steps executed for instruction <mc> to <steps>: first
+ * the steps fetching the operand as specified by the addressing mode, then the
+ * steps of the instruction itself.
+ *
+ * @param valid The result of evaluating the instruction's condition.
+ */
+void MicroCodeTable::expand(const MicroCode* mc, bool valid, std::vector<MicroCode::MicroCodeStep>& steps)
 {
     switch (mc->addressingMode & AddressingMode::Mask) {
     case DirectByte:
-        fetchDirectByte();
+        fetchDirectByte(mc, valid, steps);
         break;
     case DirectWord:
-        fetchDirectWord();
+        fetchDirectWord(mc, valid, steps);
         break;
     case AbsoluteByte:
-        fetchAbsoluteByte();
+        fetchAbsoluteByte(mc, valid, steps);
         break;
     case AbsoluteWord:
-        fetchAbsoluteWord();
+        fetchAbsoluteWord(mc, valid, steps);
         break;
     default:
         break;
     }
+    if (!(mc->addressingMode & AddressingMode::Done)) {
+        int ix = -1;
+        do {
+            ix++;
+            steps.emplace_back(mc->steps[ix]);
+        } while (!(mc->steps[ix].opflags & SystemBus::Done));
+    }
 }
 
-void MicroCodeRunner::fetchDirectByte()
+void MicroCodeTable::fetchDirectByte(const MicroCode* mc, bool valid, std::vector<MicroCode::MicroCodeStep>& steps)
 {
     byte target = (valid) ? mc->target : TX;
     steps.push_back({ MicroCode::Action::XADDR, PC, MEMADDR, SystemBus::Inc });
     steps.push_back({ MicroCode::Action::XDATA, MEM, target, SystemBus::None });
 }
 
-void MicroCodeRunner::fetchDirectWord()
+void MicroCodeTable::fetchDirectWord(const MicroCode* mc, bool valid, std::vector<MicroCode::MicroCodeStep>& steps)
 {
     byte target = (valid && (mc->target != PC) && (mc->target != MEMADDR)) ? mc->target : TX;
     steps.push_back({ MicroCode::Action::XADDR, PC, MEMADDR, SystemBus::Inc });
@@ -109,7 +151,7 @@ void MicroCodeRunner::fetchDirectWord()
     }
 }
 
-void MicroCodeRunner::fetchAbsoluteByte()
+void MicroCodeTable::fetchAbsoluteByte(const MicroCode* mc, bool valid, std::vector<MicroCode::MicroCodeStep>& steps)
 {
     steps.push_back({ MicroCode::Action::XADDR, PC, MEMADDR, SystemBus::Inc });
     steps.push_back({ MicroCode::Action::XDATA, MEM, TX, SystemBus::None });
@@ -121,7 +163,7 @@ void MicroCodeRunner::fetchAbsoluteByte()
     }
 }
 
-void MicroCodeRunner::fetchAbsoluteWord()
+void MicroCodeTable::fetchAbsoluteWord(const MicroCode* mc, bool valid, std::vector<MicroCode::MicroCodeStep>& steps)
 {
     steps.push_back({ MicroCode::Action::XADDR, PC, MEMADDR, SystemBus::Inc });
     steps.push_back({ MicroCode::Action::XDATA, MEM, TX, SystemBus::None });
@@ -135,16 +177,42 @@ void MicroCodeRunner::fetchAbsoluteWord()
     }
 }
 
+// -----------------------------------------------------------------------
+
+MicroCodeRunner::MicroCodeRunner(Controller* controller)
+    : m_controller(controller)
+{
+}
+
+void MicroCodeRunner::start(const MicroCodeTable::Entry& entry)
+{
+    m_entry = (entry.microCode) ? &entry : nullptr;
+    m_constant = 0;
+    m_complete = false;
+}
+
+/**
+ * Resumes an instruction which was saved partway through. <entry> may be
+ * null if no instruction was running.
+ */
+void MicroCodeRunner::restore(const MicroCodeTable::Entry* entry, word constant, bool complete)
+{
+    m_entry = (entry && entry->microCode) ? entry : nullptr;
+    m_constant = constant;
+    m_complete = complete;
+}
+
 bool MicroCodeRunner::grabConstant(int step)
 {
-    switch (mc->addressingMode & Mask) {
+    auto bus = m_controller->bus();
+    switch (m_entry->microCode->addressingMode & Mask) {
     case Immediate:
         m_complete = (step == 1);
         break;
     case DirectByte:
     case ImmediateByte:
         if (step == 2) {
-            m_constant = m_bus->readDataBus();
+            m_constant = bus->readDataBus();
             m_complete = true;
         }
         break;
@@ -153,9 +221,9 @@ bool MicroCodeRunner::grabConstant(int step)
     case AbsoluteByte:
     case AbsoluteWord:
         if (step == 2) {
-            m_constant = m_bus->readDataBus();
+            m_constant = bus->readDataBus();
         } else if (step == 4) {
-            m_constant |= (((word)m_bus->readDataBus()) << 8);
+            m_constant |= (((word)bus->readDataBus()) << 8);
             m_complete = true;
         }
         break;
@@ -167,47 +235,44 @@ bool MicroCodeRunner::grabConstant(int step)
 
 SystemError MicroCodeRunner::executeNextStep(int step)
 {
-    MicroCode::MicroCodeStep s = steps[step];
+    auto& s = m_entry->steps[step];
+    auto bus = m_controller->bus();
     byte src = (s.src != DEREFCONTROLLER) ? s.src : m_controller->scratch();
     byte target = (s.target != DEREFCONTROLLER) ? s.target : m_controller->scratch();
     switch (s.action) {
     case MicroCode::XDATA:
-        m_bus->xdata(src, target, s.opflags & SystemBus::Mask);
+        bus->xdata(src, target, s.opflags & SystemBus::Mask);
         break;
     case MicroCode::XADDR:
-        m_bus->xaddr(src, target, s.opflags & SystemBus::Mask);
+        bus->xaddr(src, target, s.opflags & SystemBus::Mask);
         break;
     case MicroCode::IO:
-        m_bus->io(src, target, s.opflags & SystemBus::Mask);
+        bus->io(src, target, s.opflags & SystemBus::Mask);
         break;
     case MicroCode::OTHER:
         switch (s.opflags & SystemBus::Mask) {
         case SystemBus::Halt:
-            m_bus->stop();
+            bus->stop();
             break;
         default:
             std::cerr << "Unhandled operation flag '" << std::hex << s.opflags
-                      << "' for instruction " << std::hex << mc->opcode << " step "
+                      << "' for instruction " << std::hex << m_entry->microCode->opcode << " step "
                       << std::dec << step << std::endl;
             return InvalidMicroCode;
         }
         break;
     default:
         std::cerr << "Unhandled microcode action '" << std::hex << s.action
-                  << "' for instruction " << std::hex << mc->opcode << " step "
+                  << "' for instruction " << std::hex << m_entry->microCode->opcode << " step "
                   << std::dec << step << std::endl;
         return InvalidMicroCode;
     }
     return NoError;
 }
 
-bool MicroCodeRunner::hasStep(int step)
-{
-    return steps.size() > step;
-}
-
 std::string MicroCodeRunner::instruction() const
 {
+    auto mc = m_entry->microCode;
     if (strchr(mc->instruction, '%')) {
         char buf[32];
         snprintf(buf, 32, mc->instruction, m_constant);
@@ -226,14 +291,109 @@ word MicroCodeRunner::constant() const
 
 Controller::Controller(const MicroCode* mc)
     : Register(IR)
-    , microCode(mc)
+    , m_microCode(mc)
+    , m_table(MicroCodeTable::get(mc))
+    , m_runner(this)
+{
+}
+
+const MicroCode* Controller::nmiMicroCode()
+{
+    return &mcNMI;
+}
+
+/**
+ * Restores the sequencer state, for example after the processor state was
+ * advanced by the FunctionalEngine. Any partially executed instruction is
+ * discarded.
+ */
+void Controller::setState(int s, byte scratch, word interruptVector, bool servicingNMI)
+{
+    m_runner.clear();
+    step = s;
+    m_scratch = scratch;
+    m_interruptVector = interruptVector;
+    m_servicingNMI = servicingNMI;
+    sendEvent(EV_STEPCHANGED);
+}
+
+SequencerState Controller::sequencerState() const
+{
+    SequencerState ret;
+    ret.step = step;
+    ret.scratch = m_scratch;
+    ret.interruptVector = m_interruptVector;
+    ret.servicingNMI = m_servicingNMI;
+    ret.suspended = m_suspended;
+    if (auto entry = m_runner.entry(); entry) {
+        for (auto valid = 0; valid < 2; valid++) {
+            if (entry == &m_table.entry(getValue(), valid)) {
+                ret.running = SequencerState::Instruction;
+                ret.valid = valid;
+            } else if (entry == &m_table.entry(MicroCodeTable::NMI, valid)) {
+                ret.running = SequencerState::NMIInstruction;
+                ret.valid = valid;
+            }
+        }
+        ret.constant = m_runner.constant();
+        ret.complete = m_runner.complete();
+    }
+    return ret;
+}
+
+/**
+ * Checks a state read from a file before it is restored: the instruction
+ * must exist, and the step must lie within it.
+ *
+ * @param ir The value IR will have when the state is restored.
+ */
+bool Controller::validSequencerState(const SequencerState& state, byte ir) const
 {
+    if ((state.valid > 1) || (state.complete > 1) || (state.servicingNMI > 1)) {
+        return false;
+    }
+    switch (state.running) {
+    case SequencerState::NoInstruction:
+        return state.step <= 2;
+    case SequencerState::Instruction:
+        return state.step <= m_table.entry(ir, state.valid).size + 2;
+    case SequencerState::NMIInstruction:
+        return state.step <= m_table.entry(MicroCodeTable::NMI, state.valid).size + 2;
+    default:
+        return false;
+    }
+}
+
+/**
+ * Restores a state returned by sequencerState(). IR must already hold the
+ * value it had when the state was taken. States read from a file must be
+ * checked with validSequencerState() first.
+ */
+void Controller::restoreSequencerState(const SequencerState& state)
+{
+    step = state.step;
+    m_scratch = state.scratch;
+    m_interruptVector = state.interruptVector;
+    m_servicingNMI = state.servicingNMI;
+    m_suspended = state.suspended;
+    switch (state.running) {
+    case SequencerState::Instruction:
+        m_runner.restore(&m_table.entry(getValue(), state.valid), state.constant, state.complete);
+        break;
+    case SequencerState::NMIInstruction:
+        m_runner.restore(&m_table.entry(MicroCodeTable::NMI, state.valid), state.constant, state.complete);
+        break;
+    default:
+        m_runner.clear();
+        break;
+    }
+    sendEvent(EV_STEPCHANGED);
 }
 
 std::string Controller::instruction() const
 {
-    if (m_runner) {
-        return m_runner->instruction();
+    if (m_runner.active()) {
+        return m_runner.instruction();
     } else {
         return "----";
     }
@@ -241,8 +401,8 @@ std::string Controller::instruction() const
 
 word Controller::constant() const
 {
-    if (m_runner) {
-        return m_runner->constant();
+    if (m_runner.active()) {
+        return m_runner.constant();
     } else {
         return 0;
     }
@@ -259,6 +419,7 @@ std::ostream& Controller::status(std::ostream& os)
 SystemError Controller::reset()
 {
     step = 0;
+    m_instructionCycles = 0;
     Register::reset();
     return NoError;
 }
@@ -291,7 +452,7 @@ SystemError Controller::onHighClock()
         this->Register::onHighClock();
     }
     m_suspended++;
-    if (m_runner && m_runner->grabConstant(step - 2)) {
+    if (m_runner.active() && m_runner.grabConstant(step - 2)) {
         sendEvent(EV_VALUECHANGED);
     }
     return NoError;
@@ -299,14 +460,21 @@ SystemError Controller::onHighClock()
 
 SystemError Controller::onLowClock()
 {
-    const MicroCode* mc = nullptr;
-
-    if ((m_suspended >= 1) && (runMode() == SystemBus::BreakAtInstruction) && m_runner && m_runner->complete()) {
+    if ((m_suspended >= 1) && (runMode() == SystemBus::BreakAtInstruction) && m_runner.active() && m_runner.complete()) {
         m_suspended = -16;
         bus()->suspend();
         return NoError;
     }
 
+    if (m_counters) {
+        m_instructionCycles++;
+    }
+    if (m_callStack) {
+        m_callStack->tick();
+    }
+    if (m_inputLog) {
+        m_inputLog->clock(*bus());
+    }
     switch (step) {
     case 0:
         bus()->xaddr(PC, MEMADDR, SystemBus::Inc);
@@ -315,42 +483,70 @@ SystemError Controller::onLowClock()
         bus()->xdata(MEM, IR, SystemBus::None);
         m_suspended = 0;
         break;
-    case 2:
+    case 2: {
+        const MicroCodeTable::Entry* entry = nullptr;
+        int opcode = MicroCodeTable::NMI;
         if (!bus()->nmi()) {
             if ((m_interruptVector != 0xFFFF) && !m_servicingNMI) {
-                mc = &mcNMI;
+                entry = &m_table.nmi(bus()->flags());
                 m_servicingNMI = true;
             }
             bus()->clearNmi();
-        } else {
-            mc = microCode + getValue();
-            if (!mc->opcode) {
-                m_runner = nullptr;
-            } else if (mc->opcode != getValue()) {
+        }
+        if (!entry) {
+            opcode = getValue();
+            auto mc = m_microCode + getValue();
+            if (mc->opcode && (mc->opcode != getValue())) {
                 std::cerr << "Microcode mismatch for opcode " << std::hex << getValue()
                           << ": 'opcode' field contains " << std::hex << mc->opcode
                           << std::endl;
                 return InvalidMicroCode;
             }
+            entry = &m_table.instruction(getValue(), bus()->flags());
+        }
+        if (m_counters) {
+            m_counted = opcode;
+            m_counters->dispatch(*entry, opcode);
+        }
+        if (m_callStack) {
+            trackDispatch(opcode);
+        }
+        if (m_coverage && (opcode != MicroCodeTable::NMI)) {
+            m_coverage->hit(pc() - 1, *entry, opcode);
         }
-        m_runner = (mc->opcode) ? new MicroCodeRunner(this, bus(), mc) : nullptr;
+        m_runner.start(*entry);
+    }
         // fall through:
     default:
-        if (m_runner && m_runner->hasStep(step - 2)) {
-            auto err = m_runner->executeNextStep(step - 2);
+        if (m_runner.active() && m_runner.hasStep(step - 2)) {
+            if (m_counters) {
+                m_counters->steps[m_table.stepIndex(*m_runner.entry(), step - 2)]++;
+            }
+            auto err = m_runner.executeNextStep(step - 2);
             if (err != NoError) {
                 return err;
             }
             if (!bus()->halt()) {
                 sendEvent(EV_AFTERINSTRUCTION);
+                if (m_counters) {
+                    m_counters->cycles[m_counted] += m_instructionCycles;
+                    m_instructionCycles = 0;
+                }
             }
         } else {
             if (getValue() == RTI) {
                 m_servicingNMI = false;
             }
             sendEvent(EV_AFTERINSTRUCTION);
-            delete m_runner;
-            m_runner = nullptr;
+            m_instructions++;
+            if (m_counters) {
+                m_counters->cycles[m_counted] += m_instructionCycles;
+                m_instructionCycles = 0;
+            }
+            if (m_callStack) {
+                m_callStack->completed(m_callOpcode, m_dispatchPC, pc());
+            }
+            m_runner.clear();
             setValue(0);
             if (!bus()->nmi()) {
                 step = 1;
@@ -358,6 +554,12 @@ SystemError Controller::onLowClock()
                 step = 0;
                 bus()->xaddr(PC, MEMADDR, SystemBus::Inc);
             }
+            if (m_history) {
+                recordHistory();
+            }
+            if (m_breakpoints && m_breakpoints->test(pc())) {
+                bus()->suspend();
+            }
         }
         break;
     }
@@ -369,16 +571,73 @@ SystemError Controller::onLowClock()
     return NoError;
 }
 
+/**
+ * Makes the Controller count executed instructions, cycles and microcode
+ * steps in <counters>, or stop counting if <counters> is null.
+ */
+void Controller::setCounters(ExecutionCounters* counters)
+{
+    m_counters = counters;
+    m_instructionCycles = 0;
+}
+
+word Controller::pc() const
+{
+    return bus()->backplane().component(PC)->getValue();
+}
+
+/**
+ * Remembers the PC of calls and NMIs, which is one past the opcode of the
+ * call, or the address of the instruction the NMI interrupted.
+ */
+void Controller::trackDispatch(int opcode)
+{
+    m_callOpcode = opcode;
+    if ((opcode == CALL) || (opcode == CALL_ABS) || (opcode == MicroCodeTable::NMI)) {
+        m_dispatchPC = pc();
+    }
+}
+
+/**
+ * Records the instruction boundary the Controller just reached. This runs
+ * before the step is incremented, so the recorded step is the one the
+ * Controller will be at when the instruction is completed.
+ */
+void Controller::recordHistory()
+{
+    auto& backplane = bus()->backplane();
+    HistoryRecord record;
+    for (int ix = GP_A; ix <= GP_D; ix++) {
+        record.gp[ix] = backplane.component(ix)->getValue();
+    }
+    record.lhs = backplane.component(LHS)->getValue();
+    record.rhs = backplane.component(RHS)->getValue();
+    record.ir = getValue();
+    record.pc = pc();
+    record.sp = backplane.component(SP)->getValue();
+    record.si = backplane.component(Si)->getValue();
+    record.di = backplane.component(Di)->getValue();
+    record.tx = backplane.component(TX)->getValue();
+    record.memAddr = backplane.component(MEMADDR)->getValue();
+    record.flags = bus()->flags();
+    record.scratch = m_scratch;
+    record.interruptVector = m_interruptVector;
+    record.servicingNMI = m_servicingNMI;
+    record.nmi = bus()->nmi();
+    record.step = step + 1;
+    m_history->instruction(record);
+}
+
 std::string Controller::instructionWithOpcode(int opcode) const
 {
-    auto mc = microCode + opcode;
+    auto mc = m_microCode + opcode;
     return (mc && (mc->opcode == opcode)) ? mc->instruction : "NOP";
 }
 
 int Controller::opcodeForInstruction(const std::string& instr) const
 {
     for (int ix = 0; ix < 256; ix++) {
-        auto mc = microCode + ix;
+        auto mc = m_microCode + ix;
         if (mc && (mc->opcode == ix) && (instr == mc->instruction)) {
             return ix;
         }
@@ -9,6 +9,7 @@
 #include <cpu/register.h>
 #include <cpu/registers.h>
 #include <cpu/systembus.h>
+#include <cstdint>
 #include <vector>
 
 namespace Obelix::JV80::CPU {
@@ -55,7 +56,159 @@ struct MicroCode {
     MicroCodeStep steps[24];
 };
 
-class MicroCodeRunner;
+/**
+ * The microcode of all instructions, expanded once into the flat lists of
+ * steps the Controller actually executes: the operand fetch steps implied by
+ * the addressing mode, followed by the steps of the instruction itself. There
+ * is a list for every opcode for both outcomes of the instruction's condition,
+ * and one for the NMI pseudo-instruction. All lists live in a single
+ * contiguous array, so dispatching an instruction is a table lookup.
+ */
+class MicroCodeTable {
+public:
+    struct Entry {
+        const MicroCode* microCode = nullptr;
+        const MicroCode::MicroCodeStep* steps = nullptr;
+        int size = 0;
+        int length = 1; // Bytes taken by the opcode and its operands
+    };
+
+private:
+    const MicroCode* m_microCode;
+    std::vector<MicroCode::MicroCodeStep> m_steps;
+    Entry m_entries[257][2];
+
+    explicit MicroCodeTable(const MicroCode*);
+    static void expand(const MicroCode*, bool, std::vector<MicroCode::MicroCodeStep>&);
+    static void fetchDirectByte(const MicroCode*, bool, std::vector<MicroCode::MicroCodeStep>&);
+    static void fetchDirectWord(const MicroCode*, bool, std::vector<MicroCode::MicroCodeStep>&);
+    static void fetchAbsoluteByte(const MicroCode*, bool, std::vector<MicroCode::MicroCodeStep>&);
+    static void fetchAbsoluteWord(const MicroCode*, bool, std::vector<MicroCode::MicroCodeStep>&);
+
+public:
+    MicroCodeTable(const MicroCodeTable&) = delete;
+    MicroCodeTable& operator=(const MicroCodeTable&) = delete;
+
+    static const MicroCodeTable& get(const MicroCode*);
+
+    /**
+     * Returns true if the condition of instruction <mc> holds for the
+     * processor flags <flags>, or if the instruction is unconditional.
+     */
+    static bool evaluateCondition(const MicroCode* mc, byte flags)
+    {
+        switch (mc->condition_op) {
+        case MicroCode::And:
+            return (flags & mc->condition) != 0;
+        case MicroCode::Nand:
+            return (flags & mc->condition) == 0;
+        default:
+            return true;
+        }
+    }
+
+    /**
+     * The steps to execute for <opcode> given the processor flags. The
+     * microCode field of the entry is null for opcodes without microcode,
+     * which behave as NOP.
+     */
+    const Entry& instruction(byte opcode, byte flags) const
+    {
+        return m_entries[opcode][evaluateCondition(m_microCode + opcode, flags)];
+    }
+
+    const Entry& nmi(byte flags) const
+    {
+        return m_entries[NMI][evaluateCondition(m_entries[NMI][0].microCode, flags)];
+    }
+
+    /**
+     * The steps executed for <opcode>, or NMI, if its condition evaluates to
+     * <valid>.
+     */
+    const Entry& entry(int opcode, bool valid) const { return m_entries[opcode][valid]; }
+
+    /**
+     * Returns true if <opcode>, or NMI, is a conditional instruction.
+     */
+    bool conditional(int opcode) const
+    {
+        auto mc = m_entries[opcode][true].microCode;
+        return mc && (mc->condition_op != MicroCode::None);
+    }
+
+    /**
+     * Returns true if <entry>, dispatched for <opcode>, holds the steps
+     * executed when the condition of the instruction holds.
+     */
+    bool taken(const Entry& entry, int opcode) const { return &entry == &m_entries[opcode][true]; }
+
+    /**
+     * The position of step <step> of <entry> in the flat array holding the
+     * steps of all instructions.
+     */
+    size_t stepIndex(const Entry& entry, int step) const { return (entry.steps - m_steps.data()) + step; }
+    size_t stepCount() const { return m_steps.size(); }
+
+    constexpr static int NMI = 256;
+};
+
+/**
+ * The state of the Controller's sequencer as it is stored in a state file,
+ * see BackPlane::saveState(). The instruction being executed is identified
+ * by the opcode in IR, or the NMI pseudo-instruction, and the outcome of its
+ * condition.
+ */
+struct SequencerState {
+    enum Running : uint8_t {
+        NoInstruction = 0,
+        Instruction = 1,
+        NMIInstruction = 2,
+    };
+
+    uint8_t step = 0;
+    uint8_t scratch = 0;
+    uint16_t interruptVector = 0xFFFF;
+    uint8_t servicingNMI = 0;
+    Running running = NoInstruction;
+    uint8_t valid = 0;
+    uint8_t complete = 0;
+    uint16_t constant = 0;
+    uint16_t reserved = 0;
+    int32_t suspended = 0;
+};
+
+static_assert(sizeof(SequencerState) == 16);
+
+class Breakpoints;
+class CallStack;
+class Controller;
+struct Coverage;
+struct ExecutionCounters;
+class History;
+class InputLog;
+
+class MicroCodeRunner {
+private:
+    Controller* m_controller;
+    const MicroCodeTable::Entry* m_entry = nullptr;
+    word m_constant = 0;
+    bool m_complete = false;
+
+public:
+    explicit MicroCodeRunner(Controller*);
+    void start(const MicroCodeTable::Entry&);
+    void clear() { m_entry = nullptr; }
+    void restore(const MicroCodeTable::Entry*, word, bool);
+    bool active() const { return m_entry != nullptr; }
+    const MicroCodeTable::Entry* entry() const { return m_entry; }
+    SystemError executeNextStep(int step);
+    bool hasStep(int step) const { return step < m_entry->size; }
+    bool grabConstant(int step);
+    std::string instruction() const;
+    word constant() const;
+    bool complete() const { return m_complete; }
+};
 
 class Controller : public Register {
 private:
@@ -63,20 +216,52 @@ private:
     byte m_scratch = 0;
     word m_interruptVector = 0xFFFF;
     bool m_servicingNMI = false;
-    const MicroCode* microCode;
-    MicroCodeRunner* m_runner = nullptr;
+    const MicroCode* m_microCode;
+    const MicroCodeTable& m_table;
+    MicroCodeRunner m_runner;
     int m_suspended = 0;
+    unsigned long m_instructions = 0;
+    ExecutionCounters* m_counters = nullptr;
+    int m_counted = 0;
+    unsigned long m_instructionCycles = 0;
+    CallStack* m_callStack = nullptr;
+    int m_callOpcode = 0;
+    word m_dispatchPC = 0;
+    const Breakpoints* m_breakpoints = nullptr;
+    Coverage* m_coverage = nullptr;
+    History* m_history = nullptr;
+    InputLog* m_inputLog = nullptr;
+
+    void trackDispatch(int);
+    void recordHistory();
+    word pc() const;
 
 public:
     explicit Controller(const MicroCode*);
     std::string name() const override { return "IR"; }
     int alias() const override { return CONTROLLER; }
+    bool alwaysNotify() const override { return true; }
 
     std::string instruction() const;
     word constant() const;
     byte scratch() const { return m_scratch; }
     word interruptVector() const { return m_interruptVector; }
+    bool servicingNMI() const { return m_servicingNMI; }
     int getStep() const { return step; }
+    unsigned long instructions() const { return m_instructions; }
+    void setCounters(ExecutionCounters*);
+    void setCallStack(CallStack* callStack) { m_callStack = callStack; }
+    void setBreakpoints(const Breakpoints* breakpoints) { m_breakpoints = breakpoints; }
+    void setCoverage(Coverage* coverage) { m_coverage = coverage; }
+    void setHistory(History* history) { m_history = history; }
+    void setInputLog(InputLog* inputLog) { m_inputLog = inputLog; }
+    void setState(int, byte, word, bool);
+    SequencerState sequencerState() const;
+    bool validSequencerState(const SequencerState&, byte) const;
+    void restoreSequencerState(const SequencerState&);
+    const MicroCode* microCode() const { return m_microCode; }
+    const MicroCodeTable& microCodeTable() const { return m_table; }
+    static const MicroCode* nmiMicroCode();
     SystemBus::RunMode runMode() const { return bus()->runMode(); }
     void setRunMode(SystemBus::RunMode runMode) { bus()->setRunMode(runMode); }
     std::string instructionWithOpcode(int) const;
@@ -88,36 +273,11 @@ public:
     SystemError onRisingClockEdge() override;
     SystemError onHighClock() override;
     SystemError onLowClock() override;
+    int clockPhases() const override { return OnRisingClockEdge | OnHighClock | OnLowClock; }
     //  void           NMI();
 
     constexpr static int EV_STEPCHANGED = 0x02;
     constexpr static int EV_AFTERINSTRUCTION = 0x03;
 };
 
-class MicroCodeRunner {
-private:
-    Controller* m_controller;
-    SystemBus* m_bus;
-    const MicroCode* mc;
-    std::vector<MicroCode::MicroCodeStep> steps;
-    bool valid = true;
-    word m_constant = 0;
-    bool m_complete = false;
-
-    void evaluateCondition();
-    void fetchSteps();
-    void fetchDirectByte();
-    void fetchDirectWord();
-    void fetchAbsoluteByte();
-    void fetchAbsoluteWord();
-
-public:
-    MicroCodeRunner(Controller*, SystemBus*, const MicroCode*);
-    SystemError executeNextStep(int step);
-    bool hasStep(int step);
-    bool grabConstant(int step);
-    std::string instruction() const;
-    word constant() const;
-    bool complete() const { return m_complete; }
-};
 }
@@ -0,0 +1,131 @@
+/*
+ * Copyright (c) 2021, Jan de Visser <jan@finiandarcy.com>
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+#include <cpu/counters.h>
+
+namespace Obelix::JV80::CPU {
+
+namespace {
+
+const char* mnemonic(const MicroCodeTable& table, int opcode)
+{
+    auto mc = table.entry(opcode, true).microCode;
+    return (mc) ? mc->instruction : "";
+}
+
+bool conditional(const MicroCodeTable& table, int opcode)
+{
+    auto mc = table.entry(opcode, true).microCode;
+    return mc && (mc->condition_op != MicroCode::None);
+}
+
+}
+
+ExecutionCounters::ExecutionCounters(const MicroCodeTable& microCodeTable)
+    : table(microCodeTable)
+    , steps(microCodeTable.stepCount(), 0)
+{
+}
+
+void ExecutionCounters::clear()
+{
+    memset(executions, 0, sizeof(executions));
+    memset(cycles, 0, sizeof(cycles));
+    memset(taken, 0, sizeof(taken));
+    memset(notTaken, 0, sizeof(notTaken));
+    std::fill(steps.begin(), steps.end(), 0);
+}
+
+/**
+ * Writes a line for every instruction executed at least once. The NMI
+ * pseudo-instruction has opcode 0x100.
+ */
+std::ostream& ExecutionCounters::writeCSV(std::ostream& os) const
+{
+    char buf[160];
+    os << "opcode,instruction,executions,cycles,taken,not_taken" << std::endl;
+    for (int opcode = 0; opcode <= MicroCodeTable::NMI; opcode++) {
+        if (!executions[opcode]) {
+            continue;
+        }
+        snprintf(buf, 160, "0x%02x,\"%s\",%lu,%lu,%lu,%lu", opcode, mnemonic(table, opcode),
+            executions[opcode], cycles[opcode], taken[opcode], notTaken[opcode]);
+        os << buf << std::endl;
+    }
+    return os;
+}
+
+/**
+ * Writes a line for every microcode step executed at least once. Steps
+ * are numbered from the first step after the instruction fetch, and
+ * include the steps fetching the operand. The condition column tells which
+ * of the two step lists of a conditional instruction was executed.
+ */
+std::ostream& ExecutionCounters::writeStepsCSV(std::ostream& os) const
+{
+    char buf[160];
+    os << "opcode,instruction,condition,step,hits" << std::endl;
+    for (int opcode = 0; opcode <= MicroCodeTable::NMI; opcode++) {
+        for (int valid = 1; valid >= 0; valid--) {
+            auto& entry = table.entry(opcode, valid);
+            for (int step = 0; step < entry.size; step++) {
+                auto hits = steps[table.stepIndex(entry, step)];
+                if (!hits) {
+                    continue;
+                }
+                snprintf(buf, 160, "0x%02x,\"%s\",%s,%d,%lu", opcode, mnemonic(table, opcode),
+                    (valid) ? "true" : "false", step, hits);
+                os << buf << std::endl;
+            }
+        }
+    }
+    return os;
+}
+
+std::ostream& ExecutionCounters::writeJSON(std::ostream& os) const
+{
+    char buf[200];
+    auto writeSteps = [this, &os](const MicroCodeTable::Entry& entry) {
+        os << "[";
+        for (int step = 0; step < entry.size; step++) {
+            os << ((step) ? ", " : "") << steps[table.stepIndex(entry, step)];
+        }
+        os << "]";
+    };
+
+    os << "{" << std::endl
+       << "  \"instructions\": [";
+    bool first = true;
+    for (int opcode = 0; opcode <= MicroCodeTable::NMI; opcode++) {
+        if (!executions[opcode]) {
+            continue;
+        }
+        snprintf(buf, 200, "%s\n    { \"opcode\": %d, \"instruction\": \"%s\", \"executions\": %lu, \"cycles\": %lu, ",
+            (first) ? "" : ",", opcode, mnemonic(table, opcode), executions[opcode], cycles[opcode]);
+        os << buf;
+        if (conditional(table, opcode)) {
+            os << "\"taken\": " << taken[opcode] << ", \"not_taken\": " << notTaken[opcode] << ", ";
+        }
+        os << "\"steps\": ";
+        writeSteps(table.entry(opcode, true));
+        if (conditional(table, opcode)) {
+            os << ", \"steps_not_taken\": ";
+            writeSteps(table.entry(opcode, false));
+        }
+        os << " }";
+        first = false;
+    }
+    os << std::endl
+       << "  ]" << std::endl
+       << "}" << std::endl;
+    return os;
+}
+
+}
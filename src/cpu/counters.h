@@ -0,0 +1,56 @@
+/*
+ * Copyright (c) 2021, Jan de Visser <jan@finiandarcy.com>
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#pragma once
+
+#include <ostream>
+#include <vector>
+
+#include <cpu/controller.h>
+
+namespace Obelix::JV80::CPU {
+
+/**
+ * Execution statistics, collected by the Controller and the
+ * FunctionalEngine while installed with BackPlane::enableCounters().
+ *
+ * The per-instruction arrays are indexed by opcode, with an extra entry
+ * for the NMI pseudo-instruction. Cycles are system clock cycles, and
+ * include the fetch of the instruction. HLT is charged the cycles up to
+ * the moment the processor halts. Taken and not taken are only
+ * counted for conditional instructions. The step counters are indexed like
+ * the flat step array of the MicroCodeTable, see
+ * MicroCodeTable::stepIndex().
+ */
+struct ExecutionCounters {
+    explicit ExecutionCounters(const MicroCodeTable&);
+
+    const MicroCodeTable& table;
+    unsigned long executions[MicroCodeTable::NMI + 1] = {};
+    unsigned long cycles[MicroCodeTable::NMI + 1] = {};
+    unsigned long taken[MicroCodeTable::NMI + 1] = {};
+    unsigned long notTaken[MicroCodeTable::NMI + 1] = {};
+    std::vector<unsigned long> steps;
+
+    void dispatch(const MicroCodeTable::Entry& entry, int opcode)
+    {
+        executions[opcode]++;
+        if (table.conditional(opcode)) {
+            if (table.taken(entry, opcode)) {
+                taken[opcode]++;
+            } else {
+                notTaken[opcode]++;
+            }
+        }
+    }
+
+    void clear();
+    std::ostream& writeCSV(std::ostream&) const;
+    std::ostream& writeStepsCSV(std::ostream&) const;
+    std::ostream& writeJSON(std::ostream&) const;
+};
+
+}
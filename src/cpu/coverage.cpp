@@ -0,0 +1,152 @@
+/*
+ * Copyright (c) 2021, Jan de Visser <jan@finiandarcy.com>
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <vector>
+
+#include <cpu/coverage.h>
+#include <cpu/profiler.h>
+
+namespace Obelix::JV80::CPU {
+
+bool SourceMap::load(const std::string& path)
+{
+    std::ifstream is(path);
+    if (!is) {
+        return false;
+    }
+    return load(is);
+}
+
+/**
+ * @return false if a line could not be parsed. The locations read up to
+ * that line are kept.
+ */
+bool SourceMap::load(std::istream& is)
+{
+    std::string line;
+    while (std::getline(is, line)) {
+        auto start = line.find_first_not_of(" \t\r");
+        if ((start == std::string::npos) || (line[start] == '#') || (line[start] == ';')) {
+            continue;
+        }
+        std::istringstream tokens(line);
+        std::string address, location, extra;
+        if (!(tokens >> address >> location) || (tokens >> extra)) {
+            return false;
+        }
+        word addr;
+        auto colon = location.rfind(':');
+        if (!SymbolTable::parseAddress(address, addr) || (colon == std::string::npos) || (colon == 0)) {
+            return false;
+        }
+        char* end;
+        auto lineNumber = strtol(location.c_str() + colon + 1, &end, 10);
+        if (*end || (lineNumber <= 0)) {
+            return false;
+        }
+        add(addr, location.substr(0, colon), (int)lineNumber);
+    }
+    return true;
+}
+
+Coverage::Coverage(const MicroCodeTable& microCodeTable)
+    : table(microCodeTable)
+{
+}
+
+void Coverage::clear()
+{
+    executed.reset();
+    taken.reset();
+    notTaken.reset();
+}
+
+/**
+ * Writes the ranges of consecutive executed addresses, one per line.
+ * Addresses of conditional instructions which only went one way are
+ * listed separately.
+ */
+std::ostream& Coverage::writeRanges(std::ostream& os) const
+{
+    char buf[80];
+    snprintf(buf, 80, "%zu bytes executed", executed.count());
+    os << buf << std::endl;
+    for (auto addr = 0; addr < 0x10000;) {
+        if (!executed.test(addr)) {
+            addr++;
+            continue;
+        }
+        auto from = addr;
+        while ((addr < 0x10000) && executed.test(addr)) {
+            addr++;
+        }
+        snprintf(buf, 80, "%04x-%04x", from, addr - 1);
+        os << buf << std::endl;
+    }
+    for (auto addr = 0; addr < 0x10000; addr++) {
+        if (taken.test(addr) != notTaken.test(addr)) {
+            snprintf(buf, 80, "%04x branch %s", addr, (taken.test(addr)) ? "always taken" : "never taken");
+            os << buf << std::endl;
+        }
+    }
+    return os;
+}
+
+/**
+ * Writes the coverage of the source lines in <sourceMap> in lcov's
+ * tracefile format. A line counts as executed if one of its instructions
+ * was. Conditional instructions which were executed are reported as
+ * branches with two outcomes. Execution counts are not kept, so hit counts
+ * are 0 or 1.
+ */
+std::ostream& Coverage::writeLcov(std::ostream& os, const SourceMap& sourceMap, const std::string& testName) const
+{
+    struct Line {
+        bool hit = false;
+        std::vector<word> branches;
+    };
+    std::map<std::string, std::map<int, Line>> files;
+    for (auto& [address, location] : sourceMap.locations()) {
+        auto& line = files[location.file][location.line];
+        if (executed.test(address)) {
+            line.hit = true;
+        }
+        if (taken.test(address) || notTaken.test(address)) {
+            line.branches.push_back(address);
+        }
+    }
+
+    os << "TN:" << testName << std::endl;
+    for (auto& [file, lines] : files) {
+        int linesHit = 0;
+        int branches = 0;
+        int branchesHit = 0;
+        os << "SF:" << file << std::endl;
+        for (auto& [number, line] : lines) {
+            for (auto address : line.branches) {
+                os << "BRDA:" << number << "," << address << ",0," << (taken.test(address) ? 1 : 0) << std::endl;
+                os << "BRDA:" << number << "," << address << ",1," << (notTaken.test(address) ? 1 : 0) << std::endl;
+                branches += 2;
+                branchesHit += taken.test(address) + notTaken.test(address);
+            }
+        }
+        os << "BRF:" << branches << std::endl
+           << "BRH:" << branchesHit << std::endl;
+        for (auto& [number, line] : lines) {
+            os << "DA:" << number << "," << (line.hit ? 1 : 0) << std::endl;
+            linesHit += line.hit;
+        }
+        os << "LF:" << lines.size() << std::endl
+           << "LH:" << linesHit << std::endl
+           << "end_of_record" << std::endl;
+    }
+    return os;
+}
+
+}
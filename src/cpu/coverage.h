@@ -0,0 +1,80 @@
+/*
+ * Copyright (c) 2021, Jan de Visser <jan@finiandarcy.com>
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#pragma once
+
+#include <bitset>
+#include <istream>
+#include <map>
+#include <ostream>
+#include <string>
+
+#include <cpu/controller.h>
+
+namespace Obelix::JV80::CPU {
+
+/**
+ * Maps guest addresses to lines of assembler source.
+ *
+ * Source map files have one line per instruction, '<address> <file>:<line>',
+ * with the address in hexadecimal. This is the information in the address
+ * and line number columns of an assembler listing. Empty lines and lines
+ * starting with '#' or ';' are ignored.
+ */
+class SourceMap {
+public:
+    struct Location {
+        std::string file;
+        int line = 0;
+    };
+
+    bool load(const std::string&);
+    bool load(std::istream&);
+    void add(word address, const std::string& file, int line) { m_locations[address] = { file, line }; }
+    bool empty() const { return m_locations.empty(); }
+    const std::map<word, Location>& locations() const { return m_locations; }
+
+private:
+    std::map<word, Location> m_locations;
+};
+
+/**
+ * Code coverage, collected by the Controller and the FunctionalEngine while
+ * installed with BackPlane::enableCoverage().
+ *
+ * The bitmaps are indexed by address. An address is marked executed when
+ * an instruction is dispatched with its opcode or one of its operands at
+ * that address. For conditional instructions the taken and notTaken
+ * bitmaps tell which outcomes were seen, at the address of the opcode.
+ */
+struct Coverage {
+    explicit Coverage(const MicroCodeTable&);
+
+    const MicroCodeTable& table;
+    std::bitset<0x10000> executed;
+    std::bitset<0x10000> taken;
+    std::bitset<0x10000> notTaken;
+
+    void hit(word address, const MicroCodeTable::Entry& entry, int opcode)
+    {
+        for (auto ix = 0; ix < entry.length; ix++) {
+            executed.set((word)(address + ix));
+        }
+        if (table.conditional(opcode)) {
+            if (table.taken(entry, opcode)) {
+                taken.set(address);
+            } else {
+                notTaken.set(address);
+            }
+        }
+    }
+
+    void clear();
+    std::ostream& writeRanges(std::ostream&) const;
+    std::ostream& writeLcov(std::ostream&, const SourceMap&, const std::string& = "jv80") const;
+};
+
+}
@@ -5,12 +5,284 @@
  */
 
 #include <cpu/backplane.h>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
 #include <iostream>
+#include <iterator>
+#include <memory>
+#include <string>
+#include <vector>
+
+static void usage(const char* prog)
+{
+    std::cerr << "Usage: " << prog << " [--fast] [--clock <kHz>] [--functional] [--image <file>]" << std::endl
+              << "       [--trace <file>] [--vcd <file> [--vcd-window <from>:<to>]]" << std::endl
+              << "       [--counters <file>] [--step-counters <file>]" << std::endl
+              << "       [--profile <cycles> | --profile-instructions <count>] [--symbols <file>]" << std::endl
+              << "       [--calls] [--break <address>] [--coverage <file> [--source-map <file>]]" << std::endl
+              << "       [--heatmap <file>] [--stack <start>:<size>]" << std::endl
+              << "       [--load-state <file>] [--save-state <file>] [--replay <file>]" << std::endl
+              << "  --fast         Run the clock unthrottled, as fast as possible" << std::endl
+              << "  --clock <kHz>  Run the clock at the given frequency" << std::endl
+              << "  --functional   Execute whole instructions instead of clock phases" << std::endl
+              << "  --image <file> Load the given image at address 0 and run it" << std::endl
+              << "  --trace <file> Write every cycle to a trace file. Forces the cycle accurate engine" << std::endl
+              << "  --vcd <file>   Write the bus signals as a VCD file. Forces the cycle accurate engine" << std::endl
+              << "  --vcd-window <from>:<to>  Only dump the given range of cycles" << std::endl
+              << "  --counters <file>       Write instruction counts as CSV, or JSON if <file> ends in .json" << std::endl
+              << "  --step-counters <file>  Write microcode step counts as CSV" << std::endl
+              << "  --profile <cycles>      Sample the PC every <cycles> cycles and print a profile" << std::endl
+              << "  --profile-instructions <count>  Sample the PC after every <count> instructions" << std::endl
+              << "  --symbols <file>        Resolve profiled addresses using the labels in <file>" << std::endl
+              << "  --calls                 Track calls and print cycles per routine" << std::endl
+              << "  --break <address>       Stop at <address> and print a backtrace. May be repeated" << std::endl
+              << "  --coverage <file>       Write the executed address ranges, or lcov data with --source-map" << std::endl
+              << "  --source-map <file>     Map addresses to source lines for --coverage" << std::endl
+              << "  --heatmap <file>        Write reads and writes per byte as CSV and print them per page" << std::endl
+              << "  --stack <start>:<size>  Track the use of the given stack region. Default 0x8000:0x400" << std::endl
+              << "  --load-state <file>     Resume from a saved machine state instead of starting at address 0" << std::endl
+              << "  --save-state <file>     Save the machine state when the run stops" << std::endl
+              << "  --replay <file>         Replay a recorded session, starting from the recorded state" << std::endl;
+}
 
 int main(int argc, char** argv)
 {
     auto* system = new Obelix::JV80::CPU::BackPlane();
     system->defaultSetup();
-    system->run();
+    std::unique_ptr<Obelix::JV80::CPU::TraceWriter> trace;
+    std::ofstream vcdFile;
+    std::unique_ptr<Obelix::JV80::CPU::VcdWriter> vcd;
+    unsigned long vcdFrom = 0;
+    unsigned long vcdTo = ~0ul;
+    std::vector<char> image;
+    std::string countersFile;
+    std::string stepCountersFile;
+    std::unique_ptr<Obelix::JV80::CPU::Profiler> profiler;
+    Obelix::JV80::CPU::SymbolTable symbols;
+    bool calls = false;
+    std::string coverageFile;
+    Obelix::JV80::CPU::SourceMap sourceMap;
+    std::string heatmapFile;
+    bool memoryProfile = false;
+    Obelix::JV80::CPU::word stackStart = Obelix::JV80::CPU::MemoryProfile::DEFAULT_STACK;
+    Obelix::JV80::CPU::word stackSize = Obelix::JV80::CPU::MemoryProfile::DEFAULT_STACK_SIZE;
+    std::string loadStateFile;
+    std::string saveStateFile;
+    std::string replayFile;
+
+    for (int ix = 1; ix < argc; ix++) {
+        if (!strcmp(argv[ix], "--fast")) {
+            system->setFreeRunning(true);
+        } else if (!strcmp(argv[ix], "--functional")) {
+            system->setEngine(Obelix::JV80::CPU::BackPlane::Functional);
+        } else if (!strcmp(argv[ix], "--image") && (ix < argc - 1)) {
+            std::ifstream file(argv[++ix], std::ios::binary);
+            image.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+            if (!file.good() && !file.eof()) {
+                std::cerr << "Could not read image " << argv[ix] << std::endl;
+                return 1;
+            }
+            if (image.empty() || (image.size() > 0xC000)) {
+                std::cerr << "Image " << argv[ix] << " is empty or larger than RAM" << std::endl;
+                return 1;
+            }
+        } else if (!strcmp(argv[ix], "--counters") && (ix < argc - 1)) {
+            countersFile = argv[++ix];
+        } else if (!strcmp(argv[ix], "--step-counters") && (ix < argc - 1)) {
+            stepCountersFile = argv[++ix];
+        } else if ((!strcmp(argv[ix], "--profile") || !strcmp(argv[ix], "--profile-instructions")) && (ix < argc - 1)) {
+            auto mode = (!strcmp(argv[ix], "--profile")) ? Obelix::JV80::CPU::Profiler::Cycles
+                                                         : Obelix::JV80::CPU::Profiler::Instructions;
+            auto interval = strtoul(argv[++ix], nullptr, 0);
+            if (!interval) {
+                usage(argv[0]);
+                return 1;
+            }
+            profiler = std::make_unique<Obelix::JV80::CPU::Profiler>(mode, interval);
+        } else if (!strcmp(argv[ix], "--symbols") && (ix < argc - 1)) {
+            if (!symbols.load(argv[++ix])) {
+                std::cerr << "Could not read symbols from " << argv[ix] << std::endl;
+                return 1;
+            }
+        } else if (!strcmp(argv[ix], "--calls")) {
+            calls = true;
+        } else if (!strcmp(argv[ix], "--break") && (ix < argc - 1)) {
+            char* end;
+            auto address = strtoul(argv[++ix], &end, 0);
+            if (*end || (address > 0xFFFF)) {
+                std::cerr << "Invalid breakpoint address " << argv[ix] << std::endl;
+                return 1;
+            }
+            system->breakpoints().set(address);
+        } else if (!strcmp(argv[ix], "--coverage") && (ix < argc - 1)) {
+            coverageFile = argv[++ix];
+        } else if (!strcmp(argv[ix], "--source-map") && (ix < argc - 1)) {
+            if (!sourceMap.load(argv[++ix])) {
+                std::cerr << "Could not read source map " << argv[ix] << std::endl;
+                return 1;
+            }
+        } else if (!strcmp(argv[ix], "--heatmap") && (ix < argc - 1)) {
+            heatmapFile = argv[++ix];
+            memoryProfile = true;
+        } else if (!strcmp(argv[ix], "--stack") && (ix < argc - 1)) {
+            char* end;
+            stackStart = strtoul(argv[++ix], &end, 0);
+            if (*end != ':') {
+                usage(argv[0]);
+                return 1;
+            }
+            stackSize = strtoul(end + 1, nullptr, 0);
+            memoryProfile = true;
+        } else if (!strcmp(argv[ix], "--load-state") && (ix < argc - 1)) {
+            loadStateFile = argv[++ix];
+        } else if (!strcmp(argv[ix], "--save-state") && (ix < argc - 1)) {
+            saveStateFile = argv[++ix];
+        } else if (!strcmp(argv[ix], "--replay") && (ix < argc - 1)) {
+            replayFile = argv[++ix];
+        } else if (!strcmp(argv[ix], "--trace") && (ix < argc - 1)) {
+            trace = std::make_unique<Obelix::JV80::CPU::TraceWriter>(argv[++ix]);
+            if (!trace->good()) {
+                std::cerr << "Could not open trace file " << argv[ix] << std::endl;
+                return 1;
+            }
+        } else if (!strcmp(argv[ix], "--vcd") && (ix < argc - 1)) {
+            vcdFile.open(argv[++ix]);
+            if (!vcdFile.good()) {
+                std::cerr << "Could not open VCD file " << argv[ix] << std::endl;
+                return 1;
+            }
+            vcd = std::make_unique<Obelix::JV80::CPU::VcdWriter>(vcdFile);
+        } else if (!strcmp(argv[ix], "--vcd-window") && (ix < argc - 1)) {
+            char* end;
+            vcdFrom = strtoul(argv[++ix], &end, 0);
+            if (*end != ':') {
+                usage(argv[0]);
+                return 1;
+            }
+            vcdTo = strtoul(end + 1, nullptr, 0);
+        } else if (!strcmp(argv[ix], "--clock") && (ix < argc - 1)) {
+            auto khz = strtod(argv[++ix], nullptr);
+            if (!system->setClockSpeed(khz)) {
+                std::cerr << "Frequency " << argv[ix] << " kHz out of bounds" << std::endl;
+                return 1;
+            }
+        } else {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+
+    if (!image.empty()) {
+        system->loadImage(image.size(), (const Obelix::JV80::CPU::byte*)image.data());
+    }
+    if (!loadStateFile.empty() && !system->loadState(loadStateFile)) {
+        std::cerr << "Could not restore state from " << loadStateFile << std::endl;
+        return 1;
+    }
+    if (!replayFile.empty() && !system->replayInput(replayFile)) {
+        std::cerr << "Could not replay " << replayFile << std::endl;
+        return 1;
+    }
+    if (!countersFile.empty() || !stepCountersFile.empty()) {
+        system->enableCounters();
+    }
+    if (profiler) {
+        system->profileTo(profiler.get());
+    }
+    if (calls || !system->breakpoints().empty()) {
+        system->enableCallStack();
+    }
+    if (!coverageFile.empty()) {
+        system->enableCoverage();
+    }
+    if (memoryProfile) {
+        system->enableMemoryProfile()->setStack(stackStart, stackSize);
+    }
+    if (trace) {
+        system->setEngine(Obelix::JV80::CPU::BackPlane::CycleAccurate);
+        system->traceTo(trace.get());
+    }
+    if (vcd) {
+        system->setEngine(Obelix::JV80::CPU::BackPlane::CycleAccurate);
+        vcd->setWindow(vcdFrom, vcdTo);
+        system->dumpTo(vcd.get());
+    }
+    system->run((loadStateFile.empty() && replayFile.empty()) ? 0x0000 : 0xFFFF);
+    if (auto log = system->inputLog(); log) {
+        if (log->diverged()) {
+            std::cout << "Replay diverged from the recording" << std::endl;
+        } else if (!log->finished()) {
+            std::cout << "Replay stopped before the end of the recording" << std::endl;
+        }
+    }
+    if (!saveStateFile.empty() && !system->saveState(saveStateFile)) {
+        std::cerr << "Could not save state to " << saveStateFile << std::endl;
+    }
+    if (system->callStack() && (system->atBreakpoint() || (system->error() != Obelix::JV80::CPU::NoError))) {
+        if (system->atBreakpoint()) {
+            std::cout << "Breakpoint reached" << std::endl;
+        }
+        system->callStack()->backtrace(std::cout, system->component(Obelix::JV80::CPU::PC)->getValue(), &symbols);
+    }
+    if (trace) {
+        system->traceTo(nullptr);
+        trace->close();
+    }
+    if (vcd) {
+        system->dumpTo(nullptr);
+        vcd->flush();
+    }
+    if (!countersFile.empty()) {
+        std::ofstream file(countersFile);
+        if (countersFile.ends_with(".json")) {
+            system->counters()->writeJSON(file);
+        } else {
+            system->counters()->writeCSV(file);
+        }
+    }
+    if (!stepCountersFile.empty()) {
+        std::ofstream file(stepCountersFile);
+        system->counters()->writeStepsCSV(file);
+    }
+    if (!coverageFile.empty()) {
+        std::ofstream file(coverageFile);
+        if (sourceMap.empty()) {
+            system->coverage()->writeRanges(file);
+        } else {
+            system->coverage()->writeLcov(file, sourceMap);
+        }
+    }
+
+    char buf[80];
+    snprintf(buf, 80, "%lu cycles in %.3f s (%.1f kHz)",
+        system->cycles(), system->elapsed(), system->achievedFrequency());
+    std::cout << buf << std::endl;
+    if (trace) {
+        snprintf(buf, 80, "%lu cycles traced in %lu bytes", trace->records(), trace->bytes());
+        std::cout << buf << std::endl;
+    }
+    if (profiler) {
+        system->profileTo(nullptr);
+        std::cout << std::endl;
+        profiler->flatProfile(std::cout, &symbols);
+        std::cout << std::endl;
+        profiler->hotRanges(std::cout, &symbols);
+    }
+    if (calls) {
+        std::cout << std::endl;
+        system->callStack()->writeProfile(std::cout, &symbols);
+    }
+    if (memoryProfile) {
+        std::cout << std::endl;
+        system->memoryProfile()->writeStack(std::cout);
+        if (!heatmapFile.empty()) {
+            std::ofstream file(heatmapFile);
+            system->memoryProfile()->writeCSV(file);
+            std::cout << std::endl;
+            system->memoryProfile()->writeHeatmap(std::cout);
+        }
+    }
     return 0;
 }
@@ -0,0 +1,113 @@
+/*
+ * Copyright (c) 2021, Jan de Visser <jan@finiandarcy.com>
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include <bit>
+
+#include <cpu/eventqueue.h>
+
+namespace Obelix::JV80::CPU {
+
+EventQueue::EventQueue(size_t capacity)
+    : m_ring(capacity)
+{
+    m_pending.reserve(64);
+}
+
+EventQueue::Slot* EventQueue::slot(Component const* component)
+{
+    for (auto& s : m_slots) {
+        if (s.component == component) {
+            return &s;
+        }
+    }
+    return nullptr;
+}
+
+/**
+ * Installs the queue as the listener of <component>. Events with their
+ * eventBit set in <mask> are delivered to <listener> by drain().
+ */
+void EventQueue::attach(Component* component, ComponentListener* listener, unsigned int mask)
+{
+    auto s = slot(component);
+    if (!s) {
+        s = slot(nullptr);
+    }
+    if (!s) {
+        return;
+    }
+    s->component = component;
+    s->listener = listener;
+    s->dropped = 0;
+    component->setListener(this, mask);
+}
+
+void EventQueue::detach(Component* component)
+{
+    if (auto s = slot(component); s) {
+        component->setListener(nullptr);
+        s->component = nullptr;
+        s->listener = nullptr;
+        s->dropped = 0;
+    }
+}
+
+/**
+ * Called on the thread running the system.
+ */
+void EventQueue::componentEvent(Component const* sender, int ev)
+{
+    if (!m_ring.push({ sender, ev })) {
+        if (auto s = slot(sender); s) {
+            s->dropped.fetch_or(Component::eventBit(ev), std::memory_order_relaxed);
+        }
+        m_overflows.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+/**
+ * Called on the consuming thread. Delivers the events queued since the
+ * previous call, each distinct (component, event) pair once, in the order
+ * in which they first occurred.
+ *
+ * @return The number of events delivered.
+ */
+size_t EventQueue::drain()
+{
+    m_pending.clear();
+    auto add = [this](Component const* sender, int ev) {
+        for (auto& e : m_pending) {
+            if ((e.sender == sender) && (e.ev == ev)) {
+                return;
+            }
+        }
+        m_pending.push_back({ sender, ev });
+    };
+
+    for (Event e; m_ring.pop(e);) {
+        add(e.sender, e.ev);
+    }
+
+    for (auto& s : m_slots) {
+        if (!s.component) {
+            continue;
+        }
+        auto dropped = s.dropped.exchange(0, std::memory_order_relaxed);
+        while (dropped) {
+            add(s.component, std::countr_zero(dropped));
+            dropped &= dropped - 1;
+        }
+    }
+
+    for (auto& e : m_pending) {
+        if (auto s = slot(e.sender); s && s->listener) {
+            s->listener->componentEvent(e.sender, e.ev);
+        }
+    }
+    return m_pending.size();
+}
+
+}
@@ -0,0 +1,66 @@
+/*
+ * Copyright (c) 2021, Jan de Visser <jan@finiandarcy.com>
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#pragma once
+
+#include <atomic>
+#include <vector>
+
+#include <cpu/component.h>
+#include <cpu/ringbuffer.h>
+
+namespace Obelix::JV80::CPU {
+
+/**
+ * Hands component events from the thread running the system to another
+ * thread, typically the GUI thread.
+ *
+ * The EventQueue is installed as the listener of the components it is
+ * attached to. Events are stored in a bounded single-producer,
+ * single-consumer ring buffer and the running system never blocks on it.
+ * The consumer calls drain() periodically, which delivers every distinct
+ * (component, event) pair seen since the previous drain once to the listener
+ * attached to the component. If the ring fills up, further events are
+ * recorded per component as a bit mask, so no distinct event is lost.
+ *
+ * Components must be attached and detached while the system is stopped.
+ */
+class EventQueue : public ComponentListener {
+public:
+    explicit EventQueue(size_t = DEFAULT_CAPACITY);
+    ~EventQueue() override = default;
+
+    void attach(Component*, ComponentListener*, unsigned int = Component::ALL_EVENTS);
+    void detach(Component*);
+
+    void componentEvent(Component const*, int) override;
+    size_t drain();
+    size_t overflows() const { return m_overflows.load(std::memory_order_relaxed); }
+
+    constexpr static size_t DEFAULT_CAPACITY = 4096;
+    constexpr static int MAX_COMPONENTS = 32;
+
+private:
+    struct Event {
+        Component const* sender = nullptr;
+        int ev = 0;
+    };
+
+    struct Slot {
+        Component* component = nullptr;
+        ComponentListener* listener = nullptr;
+        std::atomic<unsigned int> dropped = 0;
+    };
+
+    RingBuffer<Event> m_ring;
+    std::atomic<size_t> m_overflows = 0;
+    Slot m_slots[MAX_COMPONENTS];
+    std::vector<Event> m_pending;
+
+    Slot* slot(Component const*);
+};
+
+}
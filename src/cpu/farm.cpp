@@ -0,0 +1,272 @@
+/*
+ * Copyright (c) 2021, Jan de Visser <jan@finiandarcy.com>
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <map>
+#include <sstream>
+#include <thread>
+
+#include <cpu/farm.h>
+#include <cpu/iochannel.h>
+#include <cpu/profiler.h>
+
+namespace Obelix::JV80::CPU {
+
+namespace {
+
+std::shared_ptr<const std::vector<byte>> readFile(const std::string& path)
+{
+    std::ifstream file(path, std::ios::binary);
+    if (!file) {
+        return nullptr;
+    }
+    return std::make_shared<const std::vector<byte>>(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+}
+
+}
+
+const char* FarmResult::exitName() const
+{
+    switch (exit) {
+    case Halted:
+        return "halted";
+    case Stopped:
+        return "stopped";
+    case CycleLimit:
+        return "cycle-limit";
+    default:
+        return "failed";
+    }
+}
+
+/**
+ * Reads a manifest of jobs. Every line holds the name of a job followed by
+ * its settings:
+ *
+ *   image=<file>       Image to load, at address 0 unless load= is given
+ *   load=<address>     Address to load the image at
+ *   start=<address>    Address to start running at. Default 0
+ *   cycles=<count>     Stop after <count> cycles
+ *   input=<file>       Bytes to read from channel 0
+ *   replay=<file>      Input log to replay, see BackPlane::replayInput()
+ *   engine=<engine>    'functional' (the default) or 'cycle'
+ *
+ * Addresses are hexadecimal. Files are relative to the manifest. Blank
+ * lines and lines starting with '#' are skipped. Every file is read once,
+ * and shared by the jobs using it.
+ *
+ * @return false if the manifest or one of the files it mentions can't be
+ * read. <error> then describes the problem.
+ */
+bool loadManifest(const std::string& path, std::vector<FarmJob>& jobs, std::string& error)
+{
+    std::ifstream is(path);
+    if (!is) {
+        error = "Could not read manifest " + path;
+        return false;
+    }
+    auto dir = std::filesystem::path(path).parent_path();
+    std::map<std::string, std::shared_ptr<const std::vector<byte>>> files;
+    auto file = [&dir, &files](const std::string& name) {
+        auto p = (dir / name).string();
+        auto& ret = files[p];
+        if (!ret) {
+            ret = readFile(p);
+        }
+        return ret;
+    };
+
+    std::string line;
+    for (int lineNo = 1; std::getline(is, line); lineNo++) {
+        auto start = line.find_first_not_of(" \t\r");
+        if ((start == std::string::npos) || (line[start] == '#')) {
+            continue;
+        }
+        std::istringstream tokens(line);
+        FarmJob job;
+        tokens >> job.name;
+        std::string setting;
+        while (tokens >> setting) {
+            auto eq = setting.find('=');
+            auto key = setting.substr(0, eq);
+            auto value = (eq != std::string::npos) ? setting.substr(eq + 1) : std::string();
+            bool ok = !value.empty();
+            if (!ok) {
+            } else if (key == "image") {
+                ok = (job.image = file(value)) != nullptr;
+            } else if (key == "input") {
+                ok = (job.input = file(value)) != nullptr;
+            } else if (key == "replay") {
+                job.replay = (dir / value).string();
+            } else if (key == "load") {
+                ok = SymbolTable::parseAddress(value, job.load);
+            } else if (key == "start") {
+                ok = SymbolTable::parseAddress(value, job.start);
+            } else if (key == "cycles") {
+                char* end;
+                job.cycleLimit = strtoul(value.c_str(), &end, 0);
+                ok = !*end;
+            } else if ((key == "engine") && ((value == "functional") || (value == "cycle"))) {
+                job.engine = (value == "functional") ? BackPlane::Functional : BackPlane::CycleAccurate;
+            } else {
+                ok = false;
+            }
+            if (!ok) {
+                error = path + ":" + std::to_string(lineNo) + ": invalid setting '" + setting + "'";
+                return false;
+            }
+        }
+        jobs.push_back(std::move(job));
+    }
+    return true;
+}
+
+void writeResultsCSV(std::ostream& os, const std::vector<FarmResult>& results)
+{
+    os << "name,exit,error,pc,a,b,c,d,sp,si,di,flags,cycles,instructions,seconds,output" << std::endl;
+    for (auto& r : results) {
+        char buf[160];
+        snprintf(buf, sizeof(buf), "%s,%s,%d,%04x,%02x,%02x,%02x,%02x,%04x,%04x,%04x,%02x,%lu,%lu,%.6f,",
+            r.name.c_str(), r.exitName(), r.error, r.registers[PC], r.registers[GP_A], r.registers[GP_B],
+            r.registers[GP_C], r.registers[GP_D], r.registers[SP], r.registers[Si], r.registers[Di], r.flags,
+            r.cycles, r.instructions, r.seconds);
+        os << buf;
+        for (auto b : r.output) {
+            snprintf(buf, sizeof(buf), "%02x", b);
+            os << buf;
+        }
+        os << std::endl;
+    }
+}
+
+/**
+ * @param threads The number of threads to run jobs on. 0 means one for
+ * every core.
+ */
+Farm::Farm(unsigned threads)
+    : m_threads((threads) ? threads : std::max(std::thread::hardware_concurrency(), 1u))
+{
+}
+
+/**
+ * Runs <jobs> and waits for all of them to finish.
+ *
+ * @return The results, in the order of <jobs>.
+ */
+std::vector<FarmResult> Farm::run(const std::vector<FarmJob>& jobs)
+{
+    std::vector<FarmResult> results(jobs.size());
+    auto threads = std::min<size_t>(m_threads, jobs.size());
+    std::vector<Queue> queues(threads);
+    for (auto ix = 0u; ix < jobs.size(); ix++) {
+        queues[ix % threads].jobs.push_back(ix);
+    }
+
+    std::vector<std::thread> pool;
+    for (auto t = 0u; t < threads; t++) {
+        pool.emplace_back([&jobs, &results, &queues, t]() {
+            size_t job;
+            while (take(queues, t, job)) {
+                results[job] = execute(jobs[job]);
+            }
+        });
+    }
+    for (auto& thread : pool) {
+        thread.join();
+    }
+    return results;
+}
+
+/**
+ * Takes the next job of thread <t> from the front of its own queue, or
+ * steals one from the back of the queue of another thread.
+ *
+ * @return false if there are no jobs left.
+ */
+bool Farm::take(std::vector<Queue>& queues, unsigned t, size_t& job)
+{
+    {
+        std::lock_guard lock(queues[t].mutex);
+        if (!queues[t].jobs.empty()) {
+            job = queues[t].jobs.front();
+            queues[t].jobs.pop_front();
+            return true;
+        }
+    }
+    for (auto ix = 1u; ix < queues.size(); ix++) {
+        auto& victim = queues[(t + ix) % queues.size()];
+        std::lock_guard lock(victim.mutex);
+        if (!victim.jobs.empty()) {
+            job = victim.jobs.back();
+            victim.jobs.pop_back();
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * Runs <job> on a new machine, on the calling thread.
+ */
+FarmResult Farm::execute(const FarmJob& job)
+{
+    FarmResult ret;
+    ret.name = job.name;
+
+    BackPlane system;
+    system.defaultSetup();
+    system.setFreeRunning(true);
+    system.setEngine(job.engine);
+    size_t read = 0;
+    auto input = job.input;
+    auto keyboard = std::make_unique<IOChannel>(0x00, "KEY", [&read, input]() -> byte {
+        return (input && (read < input->size())) ? (*input)[read++] : 0xFF;
+    });
+    auto terminal = std::make_unique<IOChannel>(0x01, "OUT", [&ret](byte out) {
+        ret.output.push_back(out);
+    });
+    system.insertIO(keyboard.get());
+    system.insertIO(terminal.get());
+
+    if (job.image) {
+        if (job.image->empty() || (job.load + job.image->size() > 0xC000)) {
+            ret.message = "Image is empty or does not fit in RAM";
+            return ret;
+        }
+        system.loadImage(job.image->size(), job.image->data(), job.load);
+    }
+    if (!job.replay.empty() && !system.replayInput(job.replay)) {
+        ret.message = "Could not replay " + job.replay;
+        return ret;
+    }
+    system.setCycleLimit(job.cycleLimit);
+    system.run((job.replay.empty()) ? job.start : 0xFFFF);
+
+    ret.error = system.error();
+    if (ret.error != NoError) {
+        ret.exit = FarmResult::Failed;
+    } else if (!system.bus().halt()) {
+        ret.exit = FarmResult::Halted;
+    } else if (job.cycleLimit && (system.cycles() >= job.cycleLimit)) {
+        ret.exit = FarmResult::CycleLimit;
+    } else {
+        ret.exit = FarmResult::Stopped;
+    }
+    for (int ix = GP_A; ix <= TX; ix++) {
+        if (auto c = system.component(ix); c && (ix != MEM)) {
+            ret.registers[ix] = c->getValue();
+        }
+    }
+    ret.flags = system.bus().flags();
+    ret.cycles = system.cycles();
+    ret.instructions = system.instructions();
+    ret.seconds = system.elapsed();
+    return ret;
+}
+
+}
@@ -0,0 +1,89 @@
+/*
+ * Copyright (c) 2021, Jan de Visser <jan@finiandarcy.com>
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#pragma once
+
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include <cpu/backplane.h>
+
+namespace Obelix::JV80::CPU {
+
+/**
+ * A program to run on a machine of its own. Bytes of <input> are read from
+ * channel 0 one at a time, after which the channel reads 0xFF. Bytes written
+ * to channel 1 are collected in FarmResult::output.
+ *
+ * If <replay> is set, the machine is started from the state recorded in
+ * that input log, see BackPlane::replayInput(), instead of at <start>.
+ */
+struct FarmJob {
+    std::string name;
+    std::shared_ptr<const std::vector<byte>> image;
+    word load = 0x0000;
+    word start = 0x0000;
+    unsigned long cycleLimit = 0;
+    std::shared_ptr<const std::vector<byte>> input;
+    std::string replay;
+    BackPlane::Engine engine = BackPlane::Functional;
+};
+
+struct FarmResult {
+    enum Exit {
+        Halted,
+        Stopped,
+        CycleLimit,
+        Failed,
+    };
+
+    std::string name;
+    Exit exit = Failed;
+    SystemError error = NoError;
+    word registers[16] = {};
+    byte flags = 0;
+    unsigned long cycles = 0;
+    unsigned long instructions = 0;
+    double seconds = 0.0;
+    std::vector<byte> output;
+    std::string message;
+
+    const char* exitName() const;
+};
+
+bool loadManifest(const std::string&, std::vector<FarmJob>&, std::string&);
+void writeResultsCSV(std::ostream&, const std::vector<FarmResult>&);
+
+/**
+ * Runs batches of FarmJobs, every job on a BackPlane of its own, on a pool
+ * of threads. The jobs are dealt out to the threads up front; a thread
+ * which runs out of jobs steals from the back of the queue of another one,
+ * so a few long jobs don't leave the other threads idle.
+ */
+class Farm {
+public:
+    explicit Farm(unsigned = 0);
+
+    unsigned threads() const { return m_threads; }
+    std::vector<FarmResult> run(const std::vector<FarmJob>&);
+    static FarmResult execute(const FarmJob&);
+
+private:
+    struct Queue {
+        std::mutex mutex;
+        std::deque<size_t> jobs;
+    };
+
+    unsigned m_threads;
+
+    static bool take(std::vector<Queue>&, unsigned, size_t&);
+};
+
+}
@@ -0,0 +1,718 @@
+/*
+ * Copyright (c) 2021, Jan de Visser <jan@finiandarcy.com>
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include <chrono>
+#include <map>
+#include <mutex>
+#include <utility>
+
+#include <cpu/alu.h>
+#include <cpu/functionalengine.h>
+#include <cpu/opcodes.h>
+
+namespace Obelix::JV80::CPU {
+
+FunctionalEngine::FunctionalEngine(ComponentContainer& system)
+    : m_system(system)
+    , m_bus(system.bus())
+{
+    for (int ix = GP_A; ix <= IR; ix++) {
+        m_registers[ix] = dynamic_cast<Register*>(system.component(ix));
+        if (!m_registers[ix]) {
+            return;
+        }
+    }
+    for (int ix = PC; ix <= TX; ix++) {
+        m_addressRegisters[ix] = dynamic_cast<AddressRegister*>(system.component(ix));
+        if (!m_addressRegisters[ix]) {
+            return;
+        }
+    }
+    for (int ix = 0; ix < 16; ix++) {
+        m_channels[ix] = dynamic_cast<IOChannel*>(system.channel(ix));
+    }
+    m_memory = dynamic_cast<Memory*>(system.component(MEMADDR));
+    if (!m_memory) {
+        return;
+    }
+    auto controller = dynamic_cast<Controller*>(system.component(IR));
+    if (!controller) {
+        return;
+    }
+
+    m_microCode = controller->microCode();
+    m_table = &controller->microCodeTable();
+    m_controller = controller;
+
+    m_ops = decode(*m_table).data();
+    m_fetchAddress = decode({ MicroCode::XADDR, PC, MEMADDR, SystemBus::Inc });
+    m_fetchOpcode = decode({ MicroCode::XDATA, MEM, IR, SystemBus::None });
+}
+
+/**
+ * The engine can only take over from the Controller between instructions,
+ * i.e. when the Controller is fetching the next opcode or is about to
+ * dispatch it.
+ */
+bool FunctionalEngine::atInstructionBoundary() const
+{
+    return m_controller && (m_controller->getStep() <= 2);
+}
+
+void FunctionalEngine::load()
+{
+    for (int ix = GP_A; ix <= IR; ix++) {
+        m_byte[ix] = m_registers[ix]->getValue();
+    }
+    for (int ix = PC; ix <= TX; ix++) {
+        m_word[ix] = m_addressRegisters[ix]->getValue();
+    }
+    m_word[MEMADDR] = m_memory->getValue();
+    m_memoryProfile = m_memory->profile();
+    m_flags = m_bus.flags();
+    m_dataBus = m_bus.readDataBus();
+    m_addrBus = m_bus.readAddrBus();
+    m_scratch = m_controller->scratch();
+    m_interruptVector = m_controller->interruptVector();
+    m_servicingNMI = m_controller->servicingNMI();
+    m_step = m_controller->getStep();
+    m_halted = !m_bus.halt();
+
+    if (!m_bus.xdata()) {
+        issue(MicroCode::XDATA, m_bus.getID(), m_bus.putID(), m_bus.opflags());
+    } else if (!m_bus.xaddr()) {
+        issue(MicroCode::XADDR, m_bus.getID(), m_bus.putID(), m_bus.opflags());
+    } else if (!m_bus.io()) {
+        issue(MicroCode::IO, m_bus.getID(), m_bus.putID(), m_bus.opflags());
+    } else {
+        m_transfer = false;
+    }
+}
+
+void FunctionalEngine::store()
+{
+    for (int ix = GP_A; ix <= IR; ix++) {
+        m_registers[ix]->setValue(m_byte[ix]);
+    }
+    for (int ix = PC; ix <= TX; ix++) {
+        m_addressRegisters[ix]->setValue(m_word[ix]);
+    }
+    m_memory->setValue(m_word[MEMADDR]);
+    m_bus.setFlags(m_flags);
+    m_controller->setState(m_step, m_scratch, m_interruptVector, m_servicingNMI);
+    auto& pending = m_pending->step;
+    m_bus.initialize(!m_transfer || (pending.action != MicroCode::XDATA),
+        !m_transfer || (pending.action != MicroCode::XADDR),
+        !m_transfer || (pending.action != MicroCode::IO),
+        pending.src, pending.target, pending.opflags, m_dataBus, m_addrBus);
+    if (m_halted) {
+        m_bus.stop();
+    }
+}
+
+/**
+ * Fills <state> from the register file of the engine. The memory contents
+ * are left to SnapshotBuffer::publish.
+ */
+void FunctionalEngine::state(MachineState& state) const
+{
+    for (int ix = GP_A; ix <= IR; ix++) {
+        state.registers[ix] = m_byte[ix];
+    }
+    for (int ix = PC; ix <= TX; ix++) {
+        state.registers[ix] = m_word[ix];
+    }
+    state.registers[MEMADDR] = m_word[MEMADDR];
+    state.dataBus = m_dataBus;
+    state.addrBus = m_addrBus;
+    auto& pending = m_pending->step;
+    state.getID = pending.src;
+    state.putID = pending.target;
+    state.opflags = pending.opflags;
+    state.flags = m_flags;
+    state.xdata = !m_transfer || (pending.action != MicroCode::XDATA);
+    state.xaddr = !m_transfer || (pending.action != MicroCode::XADDR);
+    state.io = !m_transfer || (pending.action != MicroCode::IO);
+    state.halt = !m_halted;
+    state.sus = m_bus.sus();
+    state.nmi = m_bus.nmi();
+    state.step = m_step;
+    state.instruction = m_microCode[m_byte[IR]].instruction;
+}
+
+FunctionalEngine::Operand FunctionalEngine::operand(int id)
+{
+    switch (id) {
+    case GP_A:
+    case GP_B:
+    case GP_C:
+    case GP_D:
+    case LHS:
+    case IR:
+        return ByteRegister;
+    case PC:
+    case SP:
+    case Si:
+    case Di:
+    case TX:
+    case MEMADDR:
+        return WordRegister;
+    case MEM:
+        return MemoryCell;
+    case RHS:
+        return ALURegister;
+    case CONTROLLER:
+        return ControllerRegister;
+    default:
+        return NoOperand;
+    }
+}
+
+template<FunctionalEngine::Operand From>
+FunctionalEngine::Handler FunctionalEngine::dataHandler(Operand to)
+{
+    switch (to) {
+    case ByteRegister:
+        return &FunctionalEngine::moveData<From, ByteRegister>;
+    case WordRegister:
+        return &FunctionalEngine::moveData<From, WordRegister>;
+    case MemoryCell:
+        return &FunctionalEngine::moveData<From, MemoryCell>;
+    case ALURegister:
+        return &FunctionalEngine::moveData<From, ALURegister>;
+    case ControllerRegister:
+        return &FunctionalEngine::moveData<From, ControllerRegister>;
+    default:
+        return &FunctionalEngine::moveData<From, NoOperand>;
+    }
+}
+
+template<FunctionalEngine::Operand From>
+FunctionalEngine::Handler FunctionalEngine::addressHandler(Operand to)
+{
+    switch (to) {
+    case WordRegister:
+        return &FunctionalEngine::moveAddress<From, WordRegister>;
+    case MemoryCell:
+        return &FunctionalEngine::moveAddress<From, MemoryCell>;
+    case ALURegister:
+        return &FunctionalEngine::moveAddress<From, ALURegister>;
+    case ControllerRegister:
+        return &FunctionalEngine::moveAddress<From, ControllerRegister>;
+    default:
+        return &FunctionalEngine::moveAddress<From, NoOperand>;
+    }
+}
+
+/**
+ * Selects the handler for <step>, so that executing it does not have to
+ * look at the action and the registers involved again. MEMADDR can only be
+ * written, the ALU can only be read by address transfers, and the 8 bit
+ * registers take no part in address transfers.
+ */
+FunctionalEngine::Op FunctionalEngine::decode(const MicroCode::MicroCodeStep& step)
+{
+    Op ret = { &FunctionalEngine::ignore, step, (step.src == DEREFCONTROLLER) || (step.target == DEREFCONTROLLER) };
+    auto from = (step.src != MEMADDR) ? operand(step.src) : NoOperand;
+    auto to = operand(step.target);
+    switch (step.action) {
+    case MicroCode::XDATA:
+        switch (from) {
+        case ByteRegister:
+            ret.execute = dataHandler<ByteRegister>(to);
+            break;
+        case WordRegister:
+            ret.execute = dataHandler<WordRegister>(to);
+            break;
+        case MemoryCell:
+            ret.execute = dataHandler<MemoryCell>(to);
+            break;
+        case ControllerRegister:
+            ret.execute = dataHandler<ControllerRegister>(to);
+            break;
+        default:
+            ret.execute = dataHandler<NoOperand>(to);
+            break;
+        }
+        break;
+    case MicroCode::XADDR:
+        switch (from) {
+        case WordRegister:
+            ret.execute = addressHandler<WordRegister>(to);
+            break;
+        case MemoryCell:
+            ret.execute = addressHandler<MemoryCell>(to);
+            break;
+        case ALURegister:
+            ret.execute = addressHandler<ALURegister>(to);
+            break;
+        case ControllerRegister:
+            ret.execute = addressHandler<ControllerRegister>(to);
+            break;
+        default:
+            ret.execute = addressHandler<NoOperand>(to);
+            break;
+        }
+        break;
+    case MicroCode::IO:
+        ret.execute = &FunctionalEngine::transferIO;
+        break;
+    default:
+        break;
+    }
+    return ret;
+}
+
+/**
+ * Decodes all steps of <table>, in the order of MicroCodeTable::stepIndex.
+ * This is done once per table and shared by all engines.
+ */
+const std::vector<FunctionalEngine::Op>& FunctionalEngine::decode(const MicroCodeTable& table)
+{
+    static std::mutex mutex;
+    static std::map<const MicroCodeTable*, std::vector<Op>> programs;
+
+    std::lock_guard<std::mutex> lock(mutex);
+    auto& ops = programs[&table];
+    if (ops.empty()) {
+        ops.resize(table.stepCount());
+        for (int opcode = 0; opcode <= MicroCodeTable::NMI; opcode++) {
+            for (auto valid : { false, true }) {
+                auto& entry = table.entry(opcode, valid);
+                for (int ix = 0; ix < entry.size; ix++) {
+                    auto& s = entry.steps[ix];
+                    ops[table.stepIndex(entry, ix)] = decode({ s.action, s.src, s.target, (byte)(s.opflags & SystemBus::Mask) });
+                }
+            }
+        }
+    }
+    return ops;
+}
+
+void FunctionalEngine::issue(const Op& op)
+{
+    if (op.dynamic) {
+        issue(op.step.action,
+            (op.step.src != DEREFCONTROLLER) ? op.step.src : m_scratch,
+            (op.step.target != DEREFCONTROLLER) ? op.step.target : m_scratch,
+            op.step.opflags);
+        return;
+    }
+    m_pending = &op;
+    m_transfer = true;
+}
+
+void FunctionalEngine::issue(MicroCode::Action action, byte src, byte target, byte opflags)
+{
+    m_resolved = decode({ action, src, target, opflags });
+    m_pending = &m_resolved;
+    m_transfer = true;
+}
+
+SystemError FunctionalEngine::readMemory(byte& value)
+{
+    if (!m_memory->isMapped(m_word[MEMADDR])) {
+        return ProtectedMemory;
+    }
+    m_addrBus = 0x00;
+    value = std::as_const(*m_memory)[m_word[MEMADDR]];
+    if (m_memoryProfile) {
+        m_memoryProfile->read(m_word[MEMADDR]);
+    }
+    return NoError;
+}
+
+SystemError FunctionalEngine::writeMemory(byte value)
+{
+    if (!m_memory->inRAM(m_word[MEMADDR])) {
+        return ProtectedMemory;
+    }
+    if (m_history) {
+        m_history->write(m_word[MEMADDR], std::as_const(*m_memory)[m_word[MEMADDR]]);
+    }
+    (*m_memory)[m_word[MEMADDR]] = value;
+    m_memory->markDirty(m_word[MEMADDR]);
+    if (m_memoryProfile) {
+        m_memoryProfile->write(m_word[MEMADDR]);
+    }
+    return NoError;
+}
+
+/**
+ * Executes a data transfer, i.e. does what the components do in the rising
+ * edge and high phases of a clock cycle.
+ */
+template<FunctionalEngine::Operand From, FunctionalEngine::Operand To>
+SystemError FunctionalEngine::moveData(const Op& op)
+{
+    auto get = op.step.src;
+    auto put = op.step.target;
+
+    if constexpr (From == ByteRegister) {
+        m_dataBus = m_byte[get];
+    } else if constexpr (From == WordRegister) {
+        m_dataBus = (op.step.opflags & SystemBus::MSB) ? (m_word[get] >> 8) : (m_word[get] & 0x00FF);
+    } else if constexpr (From == MemoryCell) {
+        if (auto err = readMemory(m_dataBus); err != NoError) {
+            return err;
+        }
+    } else if constexpr (From == ControllerRegister) {
+        m_dataBus = m_scratch;
+    }
+
+    if constexpr (To == ByteRegister) {
+        m_byte[put] = m_dataBus;
+    } else if constexpr (To == WordRegister) {
+        if (op.step.opflags & SystemBus::MSB) {
+            m_word[put] = (m_word[put] & 0x00FF) | (((word)m_dataBus) << 8);
+        } else {
+            m_word[put] = (m_word[put] & 0xFF00) | m_dataBus;
+        }
+    } else if constexpr (To == MemoryCell) {
+        return writeMemory(m_dataBus);
+    } else if constexpr (To == ALURegister) {
+        m_byte[RHS] = m_dataBus;
+        byte flags = m_flags;
+        byte result;
+        if (ALU::operate(op.step.opflags, m_byte[LHS], m_byte[RHS], flags, result)) {
+            m_flags = flags;
+            m_byte[LHS] = result;
+        }
+    } else if constexpr (To == ControllerRegister) {
+        m_scratch = m_dataBus;
+    }
+    return NoError;
+}
+
+/**
+ * Executes an address transfer.
+ */
+template<FunctionalEngine::Operand From, FunctionalEngine::Operand To>
+SystemError FunctionalEngine::moveAddress(const Op& op)
+{
+    auto get = op.step.src;
+    auto put = op.step.target;
+    auto flags = op.step.opflags;
+
+    if constexpr (From == WordRegister) {
+        auto& value = m_word[get];
+        if (flags & SystemBus::Dec) {
+            value--;
+            if (flags & SystemBus::Flags) {
+                m_flags = (value == 0x0000) ? SystemBus::Z : SystemBus::Clear;
+            }
+        }
+        m_dataBus = value & 0x00FF;
+        m_addrBus = (value & 0xFF00) >> 8;
+        if (flags & SystemBus::Inc) {
+            value++;
+            if (flags & SystemBus::Flags) {
+                m_flags = (value == 0x0000) ? (SystemBus::Z | SystemBus::C) : SystemBus::Clear;
+            }
+        }
+    } else if constexpr (From == MemoryCell) {
+        if (auto err = readMemory(m_dataBus); err != NoError) {
+            return err;
+        }
+    } else if constexpr (From == ALURegister) {
+        m_addrBus = 0x00;
+        m_dataBus = m_flags;
+    } else if constexpr (From == ControllerRegister) {
+        m_dataBus = m_interruptVector & 0x00FF;
+        m_addrBus = (m_interruptVector & 0xFF00) >> 8;
+    }
+
+    if constexpr (To == WordRegister) {
+        m_word[put] = (((word)m_addrBus) << 8) | m_dataBus;
+        if (m_memoryProfile && (put == MEMADDR) && (get == SP)) {
+            m_memoryProfile->stack(m_word[MEMADDR]);
+        }
+    } else if constexpr (To == MemoryCell) {
+        return writeMemory(m_dataBus);
+    } else if constexpr (To == ALURegister) {
+        m_flags = m_dataBus;
+    } else if constexpr (To == ControllerRegister) {
+        m_interruptVector = (((word)m_addrBus) << 8) | m_dataBus;
+    }
+    return NoError;
+}
+
+/**
+ * Executes an IO transfer.
+ */
+SystemError FunctionalEngine::transferIO(const Op& op)
+{
+    auto get = op.step.src;
+    auto put = op.step.target;
+    auto flags = op.step.opflags;
+    auto err = NoError;
+
+    if (flags & SystemBus::IOOut) {
+        switch (get) {
+        case GP_A:
+        case GP_B:
+        case GP_C:
+        case GP_D:
+        case LHS:
+        case IR:
+            m_dataBus = m_byte[get];
+            break;
+        case MEM:
+            err = readMemory(m_dataBus);
+            break;
+        default:
+            break;
+        }
+        if (err != NoError) {
+            return err;
+        }
+    }
+    if ((flags & SystemBus::IOIn) && m_channels[put]) {
+        m_dataBus = m_channels[put]->getValue();
+    }
+    if (flags & SystemBus::IOIn) {
+        switch (get) {
+        case GP_A:
+        case GP_B:
+        case GP_C:
+        case GP_D:
+        case LHS:
+        case RHS:
+        case IR:
+            m_byte[get] = m_dataBus;
+            break;
+        case MEM:
+            err = writeMemory(m_dataBus);
+            break;
+        default:
+            break;
+        }
+        if (err != NoError) {
+            return err;
+        }
+    }
+    if ((flags & SystemBus::IOOut) && m_channels[put]) {
+        m_channels[put]->setValue(m_dataBus);
+    }
+    return NoError;
+}
+
+/**
+ * Executes clock cycles until the current instruction is complete or the
+ * processor halts. The low clock phase of every cycle mirrors
+ * Controller::onLowClock, including the NMI handling quirks, so that the
+ * number of cycles spent is identical. <Instrumented> is false when none of
+ * the per-cycle hooks are set, which drops their checks from the loop.
+ */
+template<bool Instrumented>
+SystemError FunctionalEngine::executeInstruction(unsigned long& cycles)
+{
+    while (true) {
+        if (m_transfer) {
+            auto err = (this->*m_pending->execute)(*m_pending);
+            if (err != NoError) {
+                return err;
+            }
+        }
+        cycles++;
+        if (Instrumented && m_counters) {
+            m_instructionCycles++;
+        }
+        if (Instrumented && m_callStack) {
+            m_callStack->tick();
+        }
+        if (Instrumented && m_inputLog) {
+            m_inputLog->clock(m_bus);
+        }
+
+        switch (m_step) {
+        case 0:
+            issue(m_fetchAddress);
+            break;
+        case 1:
+            issue(m_fetchOpcode);
+            break;
+        case 2: {
+            m_current = nullptr;
+            int opcode = MicroCodeTable::NMI;
+            if (!m_bus.nmi()) {
+                if ((m_interruptVector != 0xFFFF) && !m_servicingNMI) {
+                    m_current = &m_table->nmi(m_flags);
+                    m_servicingNMI = true;
+                }
+                m_bus.clearNmi();
+            }
+            if (!m_current) {
+                opcode = m_byte[IR];
+                auto mc = m_microCode + opcode;
+                if (mc->opcode && (mc->opcode != opcode)) {
+                    return InvalidMicroCode;
+                }
+                m_current = &m_table->instruction(opcode, m_flags);
+            }
+            m_currentOps = m_ops + m_table->stepIndex(*m_current, 0);
+            if (Instrumented && m_counters) {
+                m_counted = opcode;
+                m_counters->dispatch(*m_current, opcode);
+            }
+            if (Instrumented && m_callStack) {
+                m_callOpcode = opcode;
+                m_dispatchPC = m_word[PC];
+            }
+            if (Instrumented && m_coverage && (opcode != MicroCodeTable::NMI)) {
+                m_coverage->hit(m_word[PC] - 1, *m_current, opcode);
+            }
+        }
+            [[fallthrough]];
+        default:
+            if (m_step - 2 < m_current->size) {
+                auto& s = m_current->steps[m_step - 2];
+                if (Instrumented && m_counters) {
+                    m_counters->steps[m_table->stepIndex(*m_current, m_step - 2)]++;
+                }
+                switch (s.action) {
+                case MicroCode::XDATA:
+                case MicroCode::XADDR:
+                case MicroCode::IO:
+                    issue(m_currentOps[m_step - 2]);
+                    break;
+                case MicroCode::OTHER:
+                    if ((s.opflags & SystemBus::Mask) != SystemBus::Halt) {
+                        return InvalidMicroCode;
+                    }
+                    m_halted = true;
+                    if (Instrumented && m_counters) {
+                        m_counters->cycles[m_counted] += m_instructionCycles;
+                        m_instructionCycles = 0;
+                    }
+                    break;
+                default:
+                    return InvalidMicroCode;
+                }
+            } else {
+                if (m_byte[IR] == RTI) {
+                    m_servicingNMI = false;
+                }
+                if (Instrumented && m_counters) {
+                    m_counters->cycles[m_counted] += m_instructionCycles;
+                    m_instructionCycles = 0;
+                }
+                if (Instrumented && m_callStack) {
+                    m_callStack->completed(m_callOpcode, m_dispatchPC, m_word[PC]);
+                }
+                m_byte[IR] = 0;
+                if (!m_bus.nmi()) {
+                    m_step = 1;
+                } else {
+                    m_step = 0;
+                    issue(m_fetchAddress);
+                }
+                m_step++;
+                if (Instrumented && m_history) {
+                    recordHistory();
+                }
+                return NoError;
+            }
+            break;
+        }
+        m_step++;
+        if (m_halted) {
+            return NoError;
+        }
+    }
+}
+
+/**
+ * Mirrors Controller::recordHistory.
+ */
+void FunctionalEngine::recordHistory()
+{
+    HistoryRecord record;
+    for (int ix = GP_A; ix <= GP_D; ix++) {
+        record.gp[ix] = m_byte[ix];
+    }
+    record.lhs = m_byte[LHS];
+    record.rhs = m_byte[RHS];
+    record.ir = m_byte[IR];
+    record.pc = m_word[PC];
+    record.sp = m_word[SP];
+    record.si = m_word[Si];
+    record.di = m_word[Di];
+    record.tx = m_word[TX];
+    record.memAddr = m_word[MEMADDR];
+    record.flags = m_flags;
+    record.scratch = m_scratch;
+    record.interruptVector = m_interruptVector;
+    record.servicingNMI = m_servicingNMI;
+    record.nmi = m_bus.nmi();
+    record.step = m_step;
+    m_history->instruction(record);
+}
+
+/**
+ * Runs until the processor halts, an error occurs, stop() is called, the
+ * run mode is changed away from Continuous, or the cycle limit is reached
+ * at the end of an instruction. In the last two cases the bus is suspended
+ * like the Controller does when breaking at an instruction.
+ */
+SystemError FunctionalEngine::run()
+{
+    if (!atInstructionBoundary()) {
+        return GeneralError;
+    }
+    load();
+    m_stop = false;
+    m_instructionCycles = 0;
+    m_cycles.store(0, std::memory_order_relaxed);
+    m_instructions.store(0, std::memory_order_relaxed);
+    m_elapsed.store(0.0, std::memory_order_relaxed);
+
+    bool instrumented = m_counters || m_callStack || m_inputLog || m_coverage || m_history;
+    auto start = std::chrono::steady_clock::now();
+    unsigned long cycles = 0;
+    unsigned long instructions = 0;
+    auto err = NoError;
+    while (!m_halted && !m_stop) {
+        auto pc = m_word[PC];
+        auto before = cycles;
+        err = (instrumented) ? executeInstruction<true>(cycles) : executeInstruction<false>(cycles);
+        if (m_profiler) {
+            if (m_profiler->mode() == Profiler::Cycles) {
+                if (auto samples = m_profiler->due(cycles - before); samples) {
+                    m_profiler->sample(pc, samples);
+                }
+            } else if ((err == NoError) && !m_halted && m_profiler->due()) {
+                m_profiler->sample(m_word[PC]);
+            }
+        }
+        if ((err != NoError) || m_halted) {
+            break;
+        }
+        if ((++instructions % PUBLISH_INTERVAL) == 0) {
+            m_cycles.store(cycles, std::memory_order_relaxed);
+            m_instructions.store(instructions, std::memory_order_relaxed);
+            m_elapsed.store(std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count(),
+                std::memory_order_relaxed);
+            if (m_snapshots && ((instructions % SNAPSHOT_INTERVAL) == 0)) {
+                state(m_snapshots->back());
+                m_snapshots->publish(*m_memory);
+            }
+        }
+        if ((m_bus.runMode() != SystemBus::Continuous) || !m_bus.sus()
+            || (m_breakpoints && m_breakpoints->test(m_word[PC])) || (m_cycleLimit && (cycles >= m_cycleLimit))) {
+            m_bus.suspend();
+            break;
+        }
+    }
+    m_cycles.store(cycles, std::memory_order_relaxed);
+    m_instructions.store(instructions, std::memory_order_relaxed);
+    m_elapsed.store(std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count(),
+        std::memory_order_relaxed);
+    store();
+    return err;
+}
+
+}
@@ -0,0 +1,167 @@
+/*
+ * Copyright (c) 2021, Jan de Visser <jan@finiandarcy.com>
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#pragma once
+
+#include <atomic>
+#include <vector>
+
+#include <cpu/addressregister.h>
+#include <cpu/breakpoints.h>
+#include <cpu/callstack.h>
+#include <cpu/controller.h>
+#include <cpu/counters.h>
+#include <cpu/coverage.h>
+#include <cpu/history.h>
+#include <cpu/inputlog.h>
+#include <cpu/iochannel.h>
+#include <cpu/memory.h>
+#include <cpu/profiler.h>
+#include <cpu/register.h>
+#include <cpu/snapshot.h>
+#include <cpu/systembus.h>
+
+namespace Obelix::JV80::CPU {
+
+/**
+ * Instruction level execution engine. Instead of broadcasting the four clock
+ * phases to every component on the bus, the FunctionalEngine executes the
+ * microcode of whole instructions on a private copy of the registers.
+ *
+ * Every microcode step still costs one cycle, and the sequencing of the
+ * Controller, including the handling of NMIs, is replicated exactly. Cycle
+ * counts, flags, and memory contents therefore match the cycle-accurate
+ * BackPlane. The components are read when a run starts and updated when it
+ * ends; no component events are sent while the engine is running.
+ *
+ * The steps of the microcode table are decoded once into handlers for their
+ * transfers, so executing a step does not re-examine its action and
+ * registers.
+ */
+class FunctionalEngine {
+private:
+    /**
+     * What a register ID denotes as the source or target of a transfer.
+     */
+    enum Operand {
+        NoOperand,
+        ByteRegister,
+        WordRegister,
+        MemoryCell,
+        ALURegister,
+        ControllerRegister,
+    };
+
+    struct Op;
+    using Handler = SystemError (FunctionalEngine::*)(const Op&);
+
+    /**
+     * A microcode step decoded into the handler executing its transfer.
+     * Steps taking an operand from the scratch register of the Controller
+     * can only be decoded when they are issued.
+     */
+    struct Op {
+        Handler execute = nullptr;
+        MicroCode::MicroCodeStep step = {};
+        bool dynamic = false;
+    };
+
+    ComponentContainer& m_system;
+    SystemBus& m_bus;
+    Controller* m_controller = nullptr;
+    Memory* m_memory = nullptr;
+    Register* m_registers[IR + 1] = {};
+    AddressRegister* m_addressRegisters[TX + 1] = {};
+    IOChannel* m_channels[16] = {};
+    const MicroCode* m_microCode = nullptr;
+    const MicroCodeTable* m_table = nullptr;
+
+    byte m_byte[IR + 1] = {};
+    word m_word[MEMADDR + 1] = {};
+    byte m_flags = 0;
+    byte m_dataBus = 0;
+    byte m_addrBus = 0;
+    byte m_scratch = 0;
+    word m_interruptVector = 0xFFFF;
+    bool m_servicingNMI = false;
+    int m_step = 0;
+    const MicroCodeTable::Entry* m_current = nullptr;
+    const Op* m_currentOps = nullptr;
+    bool m_transfer = false;
+    Op m_resolved = {};
+    const Op* m_pending = &m_resolved;
+    const Op* m_ops = nullptr;
+    Op m_fetchAddress = {};
+    Op m_fetchOpcode = {};
+    bool m_halted = false;
+    SnapshotBuffer* m_snapshots = nullptr;
+    ExecutionCounters* m_counters = nullptr;
+    Profiler* m_profiler = nullptr;
+    CallStack* m_callStack = nullptr;
+    int m_callOpcode = 0;
+    word m_dispatchPC = 0;
+    const Breakpoints* m_breakpoints = nullptr;
+    Coverage* m_coverage = nullptr;
+    MemoryProfile* m_memoryProfile = nullptr;
+    History* m_history = nullptr;
+    InputLog* m_inputLog = nullptr;
+    unsigned long m_cycleLimit = 0;
+    int m_counted = 0;
+    unsigned long m_instructionCycles = 0;
+
+    std::atomic<bool> m_stop = false;
+    std::atomic<unsigned long> m_cycles = 0;
+    std::atomic<unsigned long> m_instructions = 0;
+    std::atomic<double> m_elapsed = 0.0;
+
+    void load();
+    void store();
+    static Operand operand(int);
+    static Op decode(const MicroCode::MicroCodeStep&);
+    static const std::vector<Op>& decode(const MicroCodeTable&);
+    template<Operand From>
+    static Handler dataHandler(Operand);
+    template<Operand From>
+    static Handler addressHandler(Operand);
+    void issue(const Op&);
+    void issue(MicroCode::Action, byte, byte, byte);
+    template<Operand From, Operand To>
+    SystemError moveData(const Op&);
+    template<Operand From, Operand To>
+    SystemError moveAddress(const Op&);
+    SystemError transferIO(const Op&);
+    SystemError ignore(const Op&) { return NoError; }
+    template<bool Instrumented>
+    SystemError executeInstruction(unsigned long&);
+    SystemError readMemory(byte&);
+    SystemError writeMemory(byte);
+    void recordHistory();
+
+public:
+    explicit FunctionalEngine(ComponentContainer&);
+    bool valid() const { return m_controller != nullptr; }
+    bool atInstructionBoundary() const;
+    SystemError run();
+    void stop() { m_stop = true; }
+    void setSnapshots(SnapshotBuffer* snapshots) { m_snapshots = snapshots; }
+    void setCounters(ExecutionCounters* counters) { m_counters = counters; }
+    void setProfiler(Profiler* profiler) { m_profiler = profiler; }
+    void setCallStack(CallStack* callStack) { m_callStack = callStack; }
+    void setBreakpoints(const Breakpoints* breakpoints) { m_breakpoints = breakpoints; }
+    void setCoverage(Coverage* coverage) { m_coverage = coverage; }
+    void setHistory(History* history) { m_history = history; }
+    void setInputLog(InputLog* inputLog) { m_inputLog = inputLog; }
+    void setCycleLimit(unsigned long limit) { m_cycleLimit = limit; }
+    void state(MachineState&) const;
+    unsigned long cycles() const { return m_cycles.load(std::memory_order_relaxed); }
+    unsigned long instructions() const { return m_instructions.load(std::memory_order_relaxed); }
+    double elapsed() const { return m_elapsed.load(std::memory_order_relaxed); }
+
+    constexpr static int PUBLISH_INTERVAL = 1024;
+    constexpr static int SNAPSHOT_INTERVAL = 16 * PUBLISH_INTERVAL;
+};
+
+}
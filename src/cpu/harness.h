@@ -68,44 +68,32 @@ public:
         return error();
     }
 
-    SystemError onClockEvent(const ComponentHandler& handler)
+    SystemError onClockEvent(ClockPhase phase)
     {
         if (error() != NoError) {
             return error();
         }
-        error(forAllComponents(handler));
-        if (error() == NoError) {
-            error(forAllChannels(handler));
-        }
-        return error();
+        return error(forAddressedComponents(phase));
     }
 
     SystemError onRisingClockEdge() override
     {
-        return onClockEvent([](Component* c) -> SystemError {
-            return c->onRisingClockEdge();
-        });
+        return onClockEvent(RisingClockEdge);
     }
 
     SystemError onHighClock() override
     {
-        return onClockEvent([](Component* c) -> SystemError {
-            return c->onHighClock();
-        });
+        return onClockEvent(HighClock);
     }
 
     SystemError onFallingClockEdge() override
     {
-        return onClockEvent([](Component* c) -> SystemError {
-            return c->onFallingClockEdge();
-        });
+        return onClockEvent(FallingClockEdge);
     }
 
     SystemError onLowClock() override
     {
-        return onClockEvent([](Component* c) -> SystemError {
-            return c->onLowClock();
-        });
+        return onClockEvent(LowClock);
     }
 
     SystemError cycle(int num)
@@ -0,0 +1,152 @@
+/*
+ * Copyright (c) 2021, Jan de Visser <jan@finiandarcy.com>
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include <algorithm>
+
+#include <cpu/history.h>
+
+namespace Obelix::JV80::CPU {
+
+History::History(Memory& memory, unsigned long interval, size_t checkpoints)
+    : m_memory(memory)
+    , m_interval((interval) ? interval : 1)
+    , m_maxCheckpoints((checkpoints) ? checkpoints : 1)
+{
+}
+
+/**
+ * Records the instruction boundary the machine is at. The memory contents
+ * at the boundary are taken as a checkpoint if the position is a multiple
+ * of the checkpoint interval. The first boundary recorded is always a
+ * checkpoint.
+ */
+void History::instruction(HistoryRecord& record)
+{
+    record.firstWrite = writes();
+    m_records.push_back(record);
+    if ((position() % m_interval) == 0) {
+        checkpoint();
+    }
+}
+
+void History::checkpoint()
+{
+    auto memory = std::make_unique<Memory>();
+    memory->fork(m_memory);
+    m_checkpoints.push_back({ position(), std::move(memory) });
+    if (m_checkpoints.size() > m_maxCheckpoints) {
+        m_checkpoints.pop_front();
+        trim();
+    }
+}
+
+/**
+ * Drops the records and writes preceding the oldest checkpoint.
+ */
+void History::trim()
+{
+    auto first = m_checkpoints.front().instruction;
+    auto firstWrite = record(first).firstWrite;
+    while (m_first < first) {
+        m_records.pop_front();
+        m_first++;
+    }
+    while (m_writeBase < firstWrite) {
+        m_writes.pop_front();
+        m_writeBase++;
+    }
+}
+
+/**
+ * Restores the memory contents at instruction boundary <instruction>, and
+ * returns the registers recorded there in <ret>. Everything recorded
+ * after the boundary is discarded.
+ *
+ * @return false if <instruction> is not in the history.
+ */
+bool History::seek(unsigned long instruction, HistoryRecord& ret)
+{
+    if (empty() || (instruction < m_first) || (instruction > position())) {
+        return false;
+    }
+    auto end = writes();
+    auto checkpoint = std::find_if(m_checkpoints.begin(), m_checkpoints.end(), [instruction](auto& c) {
+        return c.instruction >= instruction;
+    });
+    if (checkpoint != m_checkpoints.end()) {
+        m_memory.fork(*checkpoint->memory);
+        end = record(checkpoint->instruction).firstWrite;
+    }
+    ret = record(instruction);
+    for (auto ix = end; ix > ret.firstWrite; ix--) {
+        auto& w = m_writes[ix - 1 - m_writeBase];
+        m_memory[w.address] = w.value;
+    }
+
+    m_records.resize(instruction - m_first + 1);
+    m_writes.resize(ret.firstWrite - m_writeBase);
+    while (!m_checkpoints.empty() && (m_checkpoints.back().instruction > instruction)) {
+        m_checkpoints.pop_back();
+    }
+    return true;
+}
+
+/**
+ * Finds the last instruction boundary before the current position where
+ * the PC is a breakpoint.
+ *
+ * @return false if there is no such boundary in the history.
+ */
+bool History::findBreakpoint(const Breakpoints& breakpoints, unsigned long& instruction) const
+{
+    if (empty() || breakpoints.empty()) {
+        return false;
+    }
+    for (auto ix = position(); ix > m_first; ix--) {
+        if (breakpoints.test(record(ix - 1).pc)) {
+            instruction = ix - 1;
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * Finds the instruction which last wrote <address>. The instruction is
+ * identified by the boundary preceding it, so record(instruction).pc is
+ * its address.
+ *
+ * @return false if <address> wasn't written in the history.
+ */
+bool History::lastWrite(word address, unsigned long& instruction) const
+{
+    auto w = std::find_if(m_writes.rbegin(), m_writes.rend(), [address](auto& w) {
+        return w.address == address;
+    });
+    if (w == m_writes.rend()) {
+        return false;
+    }
+    uint64_t index = m_writeBase + (m_writes.rend() - w) - 1;
+    auto r = std::upper_bound(m_records.begin(), m_records.end(), index, [](uint64_t index, auto& r) {
+        return index < r.firstWrite;
+    });
+    if (r == m_records.begin()) {
+        return false;
+    }
+    instruction = m_first + (r - m_records.begin()) - 1;
+    return true;
+}
+
+void History::clear()
+{
+    m_records.clear();
+    m_writes.clear();
+    m_checkpoints.clear();
+    m_first = 0;
+    m_writeBase = 0;
+}
+
+}
@@ -0,0 +1,105 @@
+/*
+ * Copyright (c) 2021, Jan de Visser <jan@finiandarcy.com>
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <memory>
+
+#include <cpu/breakpoints.h>
+#include <cpu/memory.h>
+
+namespace Obelix::JV80::CPU {
+
+/**
+ * The state of the processor at an instruction boundary, i.e. after an
+ * instruction completed and before the next one is fetched.
+ */
+struct HistoryRecord {
+    uint64_t firstWrite = 0; // Number of the first write logged after the boundary
+    word pc = 0;
+    word sp = 0;
+    word si = 0;
+    word di = 0;
+    word tx = 0;
+    word memAddr = 0;
+    word interruptVector = 0xFFFF;
+    byte gp[4] = {};
+    byte lhs = 0;
+    byte rhs = 0;
+    byte ir = 0;
+    byte flags = 0;
+    byte scratch = 0;
+    byte step = 0; // Controller step, 1 if the fetch of the next instruction is pending
+    bool servicingNMI = false;
+    bool nmi = true;
+};
+
+/**
+ * Execution history allowing the machine to be stepped backwards, see
+ * BackPlane::enableHistory().
+ *
+ * The Controller and the FunctionalEngine record the registers at every
+ * instruction boundary, and the old contents of every byte written to
+ * memory. Every <interval> instructions, a copy-on-write fork of the memory
+ * is taken as a checkpoint. Going back to an instruction restores the first
+ * checkpoint after it and undoes the writes between the two, so no more
+ * than <interval> instructions worth of writes are ever undone.
+ *
+ * The history reaches back to the oldest checkpoint kept. When more than
+ * <checkpoints> checkpoints exist, the oldest is dropped together with the
+ * records and writes preceding the next one. Changes made to the machine
+ * between runs are not recorded.
+ */
+class History {
+public:
+    struct Write {
+        word address;
+        byte value; // The contents before the write
+    };
+
+    explicit History(Memory&, unsigned long = DEFAULT_INTERVAL, size_t = DEFAULT_CHECKPOINTS);
+
+    void instruction(HistoryRecord&);
+    void write(word address, byte value) { m_writes.push_back({ address, value }); }
+
+    unsigned long first() const { return m_first; }
+    unsigned long position() const { return m_first + m_records.size() - 1; }
+    bool empty() const { return m_records.empty(); }
+    const HistoryRecord& record(unsigned long instruction) const { return m_records[instruction - m_first]; }
+    size_t checkpoints() const { return m_checkpoints.size(); }
+    uint64_t writes() const { return m_writeBase + m_writes.size(); }
+    unsigned long interval() const { return m_interval; }
+
+    bool seek(unsigned long, HistoryRecord&);
+    bool findBreakpoint(const Breakpoints&, unsigned long&) const;
+    bool lastWrite(word, unsigned long&) const;
+    void clear();
+
+    constexpr static unsigned long DEFAULT_INTERVAL = 4096;
+    constexpr static size_t DEFAULT_CHECKPOINTS = 256;
+
+private:
+    struct Checkpoint {
+        unsigned long instruction;
+        std::unique_ptr<Memory> memory;
+    };
+
+    Memory& m_memory;
+    unsigned long m_interval;
+    size_t m_maxCheckpoints;
+    std::deque<HistoryRecord> m_records;
+    std::deque<Write> m_writes;
+    std::deque<Checkpoint> m_checkpoints;
+    unsigned long m_first = 0;
+    uint64_t m_writeBase = 0;
+
+    void checkpoint();
+    void trim();
+};
+
+}
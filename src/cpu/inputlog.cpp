@@ -0,0 +1,173 @@
+/*
+ * Copyright (c) 2021, Jan de Visser <jan@finiandarcy.com>
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+
+#include <cpu/inputlog.h>
+#include <cpu/varint.h>
+
+namespace Obelix::JV80::CPU {
+
+/**
+ * Starts a new recording. <state> is the state of the machine at the start,
+ * <nmi> is true if the NMI line is asserted already.
+ */
+void InputLog::record(std::vector<byte>&& state, bool nmi)
+{
+    m_state = std::move(state);
+    m_events.clear();
+    m_replaying = false;
+    m_cycle = 0;
+    m_next = 0;
+    m_diverged = false;
+    m_nmiAsserted = nmi;
+    m_nmiRequested = false;
+    std::fill(std::begin(m_values), std::end(m_values), -1);
+}
+
+/**
+ * Rewinds the log for replaying. The machine must be in the recorded start
+ * state, see state().
+ */
+void InputLog::replay()
+{
+    if (!m_replaying) {
+        m_end = m_cycle;
+    }
+    m_replaying = true;
+    m_cycle = 0;
+    m_next = 0;
+    m_diverged = false;
+    std::fill(std::begin(m_values), std::end(m_values), 0xFF);
+}
+
+void InputLog::input(int channel, byte value)
+{
+    if (m_values[channel] != value) {
+        m_events.push_back({ m_cycle, (byte)channel, value });
+        m_values[channel] = value;
+    }
+}
+
+/**
+ * @return The byte read from <channel> at the current cycle when recording.
+ */
+byte InputLog::replayInput(int channel)
+{
+    if ((m_next < m_events.size()) && (m_events[m_next].cycle == m_cycle) && (m_events[m_next].channel == channel)) {
+        m_values[channel] = m_events[m_next++].value;
+    }
+    return m_values[channel];
+}
+
+void InputLog::recordNmi(bool line)
+{
+    m_nmiAsserted = !line;
+    if (m_nmiAsserted) {
+        m_events.push_back({ m_cycle, NMI, 0 });
+    }
+}
+
+/**
+ * Asserts the NMI line if an NMI is due. Reads of the current cycle are
+ * still to come, but reads from earlier cycles have been missed.
+ */
+void InputLog::replayEvents(SystemBus& bus)
+{
+    if (m_cycle == m_end) {
+        bus.suspend();
+    }
+    while ((m_next < m_events.size()) && (m_events[m_next].cycle <= m_cycle)) {
+        auto& event = m_events[m_next];
+        if (event.channel == NMI) {
+            bus.setNmi();
+        } else if (event.cycle == m_cycle) {
+            break;
+        } else {
+            m_diverged = true;
+        }
+        m_next++;
+    }
+}
+
+bool InputLog::save(const std::string& path) const
+{
+    InputLogHeader header;
+    header.stateSize = m_state.size();
+    header.events = m_events.size();
+    header.cycles = (m_replaying) ? m_end : m_cycle;
+
+    std::vector<byte> buf;
+    uint64_t last = 0;
+    for (auto& event : m_events) {
+        putVarint(buf, event.cycle - last);
+        buf.push_back(event.channel);
+        if (event.channel != NMI) {
+            buf.push_back(event.value);
+        }
+        last = event.cycle;
+    }
+
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    file.write((const char*)&header, sizeof(header));
+    file.write((const char*)m_state.data(), (std::streamsize)m_state.size());
+    file.write((const char*)buf.data(), (std::streamsize)buf.size());
+    return file.good();
+}
+
+/**
+ * Reads a log written by save(), and rewinds it for replaying.
+ *
+ * @return false if the file can't be read or is malformed.
+ */
+bool InputLog::load(const std::string& path)
+{
+    std::ifstream file(path, std::ios::binary);
+    std::vector<byte> data(std::istreambuf_iterator<char>(file), {});
+    InputLogHeader header;
+    if (data.size() < sizeof(header)) {
+        return false;
+    }
+    memcpy(&header, data.data(), sizeof(header));
+    if (memcmp(header.magic, InputLogHeader().magic, sizeof(header.magic)) || (header.version != 1)
+        || (data.size() < sizeof(header) + header.stateSize)) {
+        return false;
+    }
+    const byte* p = data.data() + sizeof(header);
+    const byte* end = data.data() + data.size();
+    std::vector<byte> state(p, p + header.stateSize);
+    p += header.stateSize;
+
+    std::vector<Event> events;
+    uint64_t cycle = 0;
+    for (auto ix = 0ul; ix < header.events; ix++) {
+        uint64_t delta;
+        if (!getVarint(p, end, delta)) {
+            return false;
+        }
+        cycle += delta;
+        if ((p == end) || (*p > NMI) || ((*p != NMI) && (end - p < 2))) {
+            return false;
+        }
+        Event event { cycle, *p++, 0 };
+        if (event.channel != NMI) {
+            event.value = *p++;
+        }
+        events.push_back(event);
+    }
+
+    m_state = std::move(state);
+    m_events = std::move(events);
+    m_end = header.cycles;
+    m_replaying = true;
+    replay();
+    return true;
+}
+
+}
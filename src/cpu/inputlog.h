@@ -0,0 +1,117 @@
+/*
+ * Copyright (c) 2021, Jan de Visser <jan@finiandarcy.com>
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <cpu/systembus.h>
+
+namespace Obelix::JV80::CPU {
+
+/*
+ * Input log files hold the machine state at the start of a recording,
+ * followed by the input events. Layout, in host byte order:
+ *
+ *   InputLogHeader
+ *   state                   (as returned by BackPlane::saveState)
+ *   events                  (InputLogHeader::events of them)
+ *
+ * An event is the LEB128 number of cycles since the previous event,
+ * followed by a byte holding the channel the input was read from and the
+ * byte read, or InputLog::NMI.
+ */
+struct InputLogHeader {
+    char magic[8] = { 'J', 'V', '8', '0', 'I', 'N', 'P', '1' };
+    uint32_t version = 1;
+    uint32_t stateSize = 0;
+    uint64_t events = 0;
+    uint64_t cycles = 0;
+};
+
+/**
+ * Records the input the machine receives from outside, i.e. the bytes read
+ * from IO channels and the assertions of the NMI line, and replays it,
+ * see BackPlane::recordInput() and BackPlane::replayInput().
+ *
+ * Time is counted in microcode steps since the start of the recording,
+ * which are the same for both engines. Reads from a channel are only
+ * recorded when the byte read differs from the previous read of the
+ * channel, so polling an idle keyboard costs nothing.
+ *
+ * When replaying, bytes are read from the log instead of the channels, and
+ * the NMI line is asserted at the recorded cycles. The bus is suspended at
+ * the cycle the recording ended, which stops the machine there, or with
+ * the FunctionalEngine at the end of that instruction. The replay has
+ * diverged if the machine didn't read a channel at a cycle it did when
+ * recording.
+ */
+class InputLog {
+public:
+    struct Event {
+        uint64_t cycle;
+        byte channel;
+        byte value;
+    };
+
+    InputLog() = default;
+
+    bool load(const std::string&);
+    bool save(const std::string&) const;
+    void record(std::vector<byte>&&, bool);
+    void replay();
+
+    bool replaying() const { return m_replaying; }
+    const std::vector<byte>& state() const { return m_state; }
+    const std::vector<Event>& events() const { return m_events; }
+    uint64_t cycle() const { return m_cycle; }
+    uint64_t end() const { return m_end; }
+    bool finished() const { return m_next == m_events.size(); }
+    bool diverged() const { return m_diverged; }
+
+    void nmi() { m_nmiRequested.store(true, std::memory_order_release); }
+    void input(int, byte);
+    byte replayInput(int);
+
+    void clock(SystemBus& bus)
+    {
+        m_cycle++;
+        if (m_replaying) {
+            if (((m_next < m_events.size()) && (m_events[m_next].cycle <= m_cycle)) || (m_cycle == m_end)) {
+                replayEvents(bus);
+            }
+            return;
+        }
+        if (m_nmiRequested.load(std::memory_order_relaxed) && m_nmiRequested.exchange(false)) {
+            bus.setNmi();
+        }
+        if (bus.nmi() == m_nmiAsserted) {
+            recordNmi(bus.nmi());
+        }
+    }
+
+    constexpr static byte NMI = 0x10;
+
+private:
+    std::vector<byte> m_state;
+    std::vector<Event> m_events;
+    bool m_replaying = false;
+    uint64_t m_cycle = 0;
+    uint64_t m_end = 0;
+    size_t m_next = 0;
+    bool m_diverged = false;
+    bool m_nmiAsserted = false;
+    std::atomic<bool> m_nmiRequested = false;
+    int m_values[16] = {};
+
+    void recordNmi(bool);
+    void replayEvents(SystemBus&);
+};
+
+}
@@ -4,6 +4,7 @@
  * SPDX-License-Identifier: GPL-3.0-or-later
  */
 
+#include <cpu/inputlog.h>
 #include <cpu/iochannel.h>
 
 namespace Obelix::JV80::CPU {
@@ -44,7 +45,14 @@ int IOChannel::getValue() const
 {
     int ret = 0;
     if (m_input) {
-        ret = m_input();
+        if (m_inputLog && m_inputLog->replaying()) {
+            ret = m_inputLog->replayInput(id());
+        } else {
+            ret = m_input();
+            if (m_inputLog) {
+                m_inputLog->input(id(), ret);
+            }
+        }
         if (ret) {
             sendEvent(EV_INPUTREAD);
         }
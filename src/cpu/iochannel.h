@@ -10,6 +10,8 @@
 
 namespace Obelix::JV80::CPU {
 
+class InputLog;
+
 typedef std::function<byte()> Input;
 typedef std::function<void(byte)> Output;
 
@@ -21,6 +23,7 @@ private:
     Status m_status = nullptr;
     ClockEvent m_fallingEdge = nullptr;
     ClockEvent m_lowClock = nullptr;
+    InputLog* m_inputLog = nullptr;
 
 public:
     explicit IOChannel(int, std::string&&, Input&);
@@ -32,6 +35,7 @@ public:
     void setStatus(Status& status) { m_status = std::move(status); }
     void setFallingEdgeHandler(ClockEvent& handler) { m_fallingEdge = std::move(handler); }
     void setLowClockHandler(ClockEvent& handler) { m_lowClock = std::move(handler); }
+    void setInputLog(InputLog* inputLog) { m_inputLog = inputLog; }
 
     void setValue(byte val);
     int getValue() const override;
@@ -40,6 +44,7 @@ public:
     SystemError reset() override;
     SystemError onRisingClockEdge() override;
     SystemError onHighClock() override;
+    int clockPhases() const override { return OnRisingClockEdge | OnHighClock; }
     //  SystemError    onFallingClockEdge() override;
     //  SystemError    onLowClock() override;
 
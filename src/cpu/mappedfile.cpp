@@ -0,0 +1,49 @@
+/*
+ * Copyright (c) 2021, Jan de Visser <jan@finiandarcy.com>
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cpu/mappedfile.h>
+
+namespace Obelix::JV80::CPU {
+
+MappedFile::MappedFile(const std::string& path, size_t minimumSize)
+{
+    m_fd = open(path.c_str(), O_RDONLY);
+    if (m_fd < 0) {
+        m_error = "Could not open " + path + ": " + strerror(errno);
+        return;
+    }
+    struct stat st {};
+    if (fstat(m_fd, &st) || (st.st_size < (off_t)minimumSize) || !st.st_size) {
+        m_error = path + " is too short";
+        return;
+    }
+    auto data = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, m_fd, 0);
+    if (data == MAP_FAILED) {
+        m_error = "Could not map " + path + ": " + strerror(errno);
+        return;
+    }
+    m_data = (const byte*)data;
+    m_size = st.st_size;
+}
+
+MappedFile::~MappedFile()
+{
+    if (m_data) {
+        munmap((void*)m_data, m_size);
+    }
+    if (m_fd >= 0) {
+        ::close(m_fd);
+    }
+}
+
+}
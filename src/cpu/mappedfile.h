@@ -0,0 +1,38 @@
+/*
+ * Copyright (c) 2021, Jan de Visser <jan@finiandarcy.com>
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#pragma once
+
+#include <string>
+
+#include <cpu/component.h>
+
+namespace Obelix::JV80::CPU {
+
+/**
+ * Read-only mapping of a file into memory. Files shorter than the minimum
+ * size passed to the constructor are rejected.
+ */
+class MappedFile {
+public:
+    explicit MappedFile(const std::string&, size_t = 0);
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    ~MappedFile();
+
+    bool valid() const { return m_data != nullptr; }
+    const std::string& error() const { return m_error; }
+    const byte* data() const { return m_data; }
+    size_t size() const { return m_size; }
+
+private:
+    int m_fd = -1;
+    const byte* m_data = nullptr;
+    size_t m_size = 0;
+    std::string m_error;
+};
+
+}
@@ -5,10 +5,13 @@
  */
 
 #include <algorithm>
+#include <cpu/history.h>
 #include <cpu/memory.h>
+#include <cpu/registers.h>
 #include <cstring>
 #include <iostream>
 #include <memory>
+#include <utility>
 
 namespace Obelix::JV80::CPU {
 
@@ -255,6 +258,7 @@ bool Memory::disjointFromAll(size_t addr, size_t size) const
 
 void Memory::erase()
 {
+    detach();
     for (auto& bank : m_banks) {
         MemoryBank b(bank);
         b.erase();
@@ -263,11 +267,13 @@ void Memory::erase()
 
 bool Memory::add(word address, word size, bool writable, const byte* contents)
 {
+    detach();
     MemoryBank b = findBankForBlock(address, size);
     if (b.valid()) {
         b.copy(address, size, contents);
     } else if (disjointFromAll(address, size)) {
         m_banks.emplace(address, size, writable, contents);
+        mapPages();
         sendEvent(EV_CONFIGCHANGED);
     } else {
         return false;
@@ -283,11 +289,13 @@ bool Memory::add(MemoryBank&& bank)
     if (!bank.size()) {
         return true;
     }
+    detach();
     MemoryBank b = findBankForBlock(bank.start(), bank.size());
     if (b.valid()) {
         b.copy(bank);
     } else if (disjointFromAll(bank.start(), bank.size())) {
         m_banks.emplace(bank);
+        mapPages();
         sendEvent(EV_CONFIGCHANGED);
     } else {
         return false;
@@ -301,11 +309,13 @@ bool Memory::add(MemoryBank& bank)
     if (!bank.size()) {
         return true;
     }
+    detach();
     MemoryBank b = findBankForBlock(bank.start(), bank.size());
     if (b.valid()) {
         b.copy(bank);
     } else if (disjointFromAll(bank.start(), bank.size())) {
         m_banks.insert(std::move(bank));
+        mapPages();
         sendEvent(EV_CONFIGCHANGED);
     } else {
         return false;
@@ -319,14 +329,160 @@ bool Memory::remove(MemoryBank& bank)
     if (!bank.valid()) {
         return false;
     }
+    detach();
     m_banks.erase(bank);
+    mapPages();
     sendEvent(EV_CONFIGCHANGED);
     return true;
 }
 
+/**
+ * Makes this memory a copy-on-write copy of <parent>. Both memories share
+ * all pages until one of them writes a page, at which point the writer gets
+ * its own copy of that page. Forking costs a page table, whatever the
+ * size of the banks.
+ *
+ * Pages only partially covered by a bank can't be shared. If <parent> has
+ * any, this memory gets private copies of all banks instead.
+ */
+void Memory::fork(Memory& parent)
+{
+    m_banks = parent.m_banks;
+    auto mixed = false;
+    for (auto ix = 0; ix < 256; ix++) {
+        m_pages[ix] = parent.m_pages[ix];
+        m_copies[ix] = parent.m_copies[ix];
+        if (m_pages[ix].image) {
+            m_pages[ix].shared = parent.m_pages[ix].shared = true;
+        }
+        mixed |= m_pages[ix].type == MixedPage;
+    }
+    m_forked = parent.m_forked = true;
+    if (mixed) {
+        detach();
+    }
+    m_dirty.set();
+    sendEvent(EV_CONFIGCHANGED);
+    sendEvent(EV_IMAGELOADED);
+}
+
+/**
+ * @return The number of pages which were copied because they were written
+ * after a fork. Pages inherited from the parent count as well.
+ */
+int Memory::copiedPages() const
+{
+    return (int)std::count_if(std::begin(m_copies), std::end(m_copies), [](auto& copy) {
+        return copy != nullptr;
+    });
+}
+
+/**
+ * Gives the page <page> an image of its own, unless its current image
+ * already is a copy nobody else uses.
+ */
+void Memory::copyOnWrite(int page)
+{
+    auto& p = m_pages[page];
+    if (!m_copies[page] || (m_copies[page].use_count() > 1)) {
+        auto copy = std::shared_ptr<byte>(new byte[PAGE_SIZE], std::default_delete<byte[]>());
+        memcpy(copy.get(), p.image, PAGE_SIZE);
+        m_copies[page] = copy;
+        p.image = copy.get();
+    }
+    p.shared = false;
+}
+
+/**
+ * Replaces the banks by private copies holding the current contents, so
+ * they can be modified in place again. Called before the bank configuration
+ * changes, because that rebuilds the page table from the banks.
+ */
+void Memory::detach()
+{
+    if (!m_forked) {
+        return;
+    }
+    MemoryBanks banks;
+    for (auto& bank : m_banks) {
+        MemoryBank copy(bank.start(), bank.size(), bank.writable());
+        for (size_t ix = 0; ix < bank.size(); ix++) {
+            copy[bank.start() + ix] = std::as_const(*this)[bank.start() + ix];
+        }
+        banks.insert(std::move(copy));
+    }
+    m_banks = std::move(banks);
+    for (auto& copy : m_copies) {
+        copy.reset();
+    }
+    m_forked = false;
+    mapPages();
+}
+
+/**
+ * Copies <size> bytes starting at <address> to <dest>. Unmapped addresses
+ * read as 0xFF.
+ */
+void Memory::read(word address, size_t size, byte* dest) const
+{
+    for (size_t ix = 0; ix < size;) {
+        size_t addr = address + ix;
+        auto& page = m_pages[(addr >> 8) & 0xFF];
+        auto count = std::min(size - ix, PAGE_SIZE - (addr & 0xFF));
+        if ((addr <= 0xFFFF) && page.image) {
+            memcpy(dest + ix, page.image + (addr & 0xFF), count);
+        } else {
+            for (size_t i = 0; i < count; i++) {
+                dest[ix + i] = (isMapped(addr + i)) ? (*this)[addr + i] : 0xFF;
+            }
+        }
+        ix += count;
+    }
+}
+
+/**
+ * Copies <size> bytes from <contents> to memory, starting at <address>.
+ * Unlike writes through the bus, this also writes ROM. Pages shared with a
+ * fork are copied first.
+ */
+void Memory::write(word address, size_t size, const byte* contents)
+{
+    for (size_t ix = 0; ix < size;) {
+        size_t addr = address + ix;
+        auto& page = m_pages[(addr >> 8) & 0xFF];
+        auto count = std::min(size - ix, PAGE_SIZE - (addr & 0xFF));
+        if ((addr <= 0xFFFF) && page.image) {
+            if (page.shared) {
+                copyOnWrite(addr >> 8);
+            }
+            memcpy(page.image + (addr & 0xFF), contents + ix, count);
+        } else {
+            for (size_t i = 0; i < count; i++) {
+                (*this)[addr + i] = contents[ix + i];
+            }
+        }
+        ix += count;
+    }
+}
+
+/**
+ * To be called after the contents of memory were overwritten using write()
+ * or through the images of the banks.
+ */
+void Memory::imageRestored()
+{
+    m_dirty.set();
+    sendEvent(EV_IMAGELOADED);
+}
+
 bool Memory::initialize()
 {
     m_banks.clear();
+    for (auto& copy : m_copies) {
+        copy.reset();
+    }
+    m_forked = false;
+    mapPages();
     return true;
 }
 
@@ -346,38 +502,123 @@ bool Memory::initialize(MemoryBank&& bank)
     return initialize(bank);
 }
 
+/**
+ * Rebuilds the page table from the memory banks. A page gets a direct
+ * pointer into a bank image if the first bank mapping the start of the page
+ * maps the entire page. Pages only partially covered by banks are marked
+ * as mixed, and accesses to them are resolved by searching the banks.
+ */
+void Memory::mapPages()
+{
+    m_dirty.set();
+    for (auto ix = 0; ix < 256; ix++) {
+        auto& page = m_pages[ix];
+        size_t pageStart = ix * PAGE_SIZE;
+        size_t pageEnd = pageStart + PAGE_SIZE;
+        page = Page();
+        for (auto& bank : m_banks) {
+            if (bank.mapped(pageStart)) {
+                if (bank.end() >= pageEnd) {
+                    page.image = bank.image() + bank.offset(pageStart);
+                    page.type = (bank.writable()) ? RAMPage : ROMPage;
+                } else {
+                    page.type = MixedPage;
+                }
+                break;
+            }
+            if ((bank.start() > pageStart) && (bank.start() < pageEnd) && bank.valid()) {
+                page.type = MixedPage;
+                break;
+            }
+        }
+    }
+}
+
+/**
+ * @return The pages written since the previous call. Pages are marked when
+ * they are written through the bus or by the FunctionalEngine, and all pages
+ * are marked when the memory configuration changes.
+ */
+std::bitset<256> Memory::takeDirtyPages()
+{
+    auto ret = m_dirty;
+    m_dirty.reset();
+    return ret;
+}
+
+/**
+ * Copies page <page> to <dest>. Unmapped addresses read as 0xFF.
+ */
+void Memory::copyPage(int page, byte* dest) const
+{
+    if (m_pages[page].image) {
+        memcpy(dest, m_pages[page].image, PAGE_SIZE);
+        return;
+    }
+    for (auto ix = 0; ix < PAGE_SIZE; ix++) {
+        word addr = page * PAGE_SIZE + ix;
+        dest[ix] = (isMapped(addr)) ? (*this)[addr] : 0xFF;
+    }
+}
+
 bool Memory::inRAM(word addr) const
 {
-    MemoryBank bank = findBankForAddress(addr);
-    return bank.valid() && bank.writable();
+    switch (m_pages[addr >> 8].type) {
+    case MixedPage: {
+        MemoryBank bank = findBankForAddress(addr);
+        return bank.valid() && bank.writable();
+    }
+    default:
+        return m_pages[addr >> 8].type == RAMPage;
+    }
 }
 
 bool Memory::inROM(word addr) const
 {
-    MemoryBank bank = findBankForAddress(addr);
-    return bank.valid() && !bank.writable();
+    switch (m_pages[addr >> 8].type) {
+    case MixedPage: {
+        MemoryBank bank = findBankForAddress(addr);
+        return bank.valid() && !bank.writable();
+    }
+    default:
+        return m_pages[addr >> 8].type == ROMPage;
+    }
 }
 
 bool Memory::isMapped(word addr) const
 {
-    MemoryBank b(findBankForAddress(addr));
-    return b.valid();
+    switch (m_pages[addr >> 8].type) {
+    case MixedPage: {
+        MemoryBank b(findBankForAddress(addr));
+        return b.valid();
+    }
+    default:
+        return m_pages[addr >> 8].type != UnmappedPage;
+    }
 }
 
-byte& Memory::operator[](std::size_t addr)
+/**
+ * Slow path of the non-const operator[]. Because the returned reference can
+ * be written, a page shared with a fork is copied first.
+ */
+byte& Memory::writableLookup(std::size_t addr)
 {
-    static byte dummy = 0xFF;
-    MemoryBank bank(findBankForAddress(addr));
-    if (bank.valid()) {
-        return bank[addr];
-    } else {
-        return dummy;
+    if ((addr <= 0xFFFF) && m_pages[addr >> 8].shared) {
+        copyOnWrite(addr >> 8);
+        return m_pages[addr >> 8].image[addr & 0xFF];
     }
+    return lookup(addr);
 }
 
-const byte& Memory::operator[](std::size_t addr) const
+/**
+ * Slow path of operator[], used for addresses in pages not mapped in their
+ * entirety by a single bank.
+ */
+byte& Memory::lookup(std::size_t addr) const
 {
-    static byte dummy = 0xFF;
+    // Per thread, so machines running side by side don't share it:
+    static thread_local byte dummy;
+    dummy = 0xFF;
     MemoryBank bank(findBankForAddress(addr));
     if (bank.valid()) {
         return bank[addr];
@@ -390,7 +631,7 @@ std::ostream& Memory::status(std::ostream& os)
 {
     char buf[80];
     snprintf(buf, 80, "%1x. M  %04x   CONTENTS %1x. [%02x]", id(), getValue(),
-        MEM_ID, (isMapped(getValue()) ? (*this)[getValue()] : 0xFF));
+        MEM_ID, (isMapped(getValue()) ? std::as_const(*this)[getValue()] : 0xFF));
     os << buf << std::endl;
     return os;
 }
@@ -402,7 +643,10 @@ SystemError Memory::onRisingClockEdge()
             return error(ProtectedMemory);
         }
         bus()->putOnAddrBus(0x00);
-        bus()->putOnDataBus((*this)[getValue()]);
+        bus()->putOnDataBus(std::as_const(*this)[getValue()]);
+        if (m_profile) {
+            m_profile->read(getValue());
+        }
     }
     return NoError;
 }
@@ -413,11 +657,21 @@ SystemError Memory::onHighClock()
         if (!inRAM(getValue())) {
             return error(ProtectedMemory);
         }
+        if (m_history) {
+            m_history->write(getValue(), std::as_const(*this)[getValue()]);
+        }
         (*this)[getValue()] = bus()->readDataBus();
+        markDirty(getValue());
+        if (m_profile) {
+            m_profile->write(getValue());
+        }
         sendEvent(EV_CONTENTSCHANGED);
     } else if (bus()->putID() == ADDR_ID) {
         if (!(bus()->xaddr())) {
             setValue(((word)bus()->readAddrBus() << 8) | ((word)bus()->readDataBus()));
+            if (m_profile && (bus()->getID() == SP)) {
+                m_profile->stack(getValue());
+            }
         } else if (!(bus()->xdata())) {
             if (!(bus()->opflags() & SystemBus::MSB)) {
                 setValue((getValue() & 0xFF00) | bus()->readDataBus());
@@ -10,16 +10,20 @@
 
 #pragma once
 
+#include <bitset>
 #include <cstring>
 #include <memory>
 #include <set>
 #include <vector>
 
 #include <cpu/addressregister.h>
+#include <cpu/memoryprofile.h>
 #include <cpu/systembus.h>
 
 namespace Obelix::JV80::CPU {
 
+class History;
+
 class MemoryBank {
 private:
     word m_start = 0;
@@ -59,16 +63,41 @@ public:
     word size() const { return m_size; }
     word end() const { return m_start + m_size; }
     bool writable() const { return m_writable; }
+    byte* image() const { return m_image.get(); }
 };
 
 typedef std::set<MemoryBank> MemoryBanks;
 
 class Memory : public AddressRegister {
 private:
+    enum PageType : byte {
+        UnmappedPage = 0x00,
+        RAMPage = 0x01,
+        ROMPage = 0x02,
+        MixedPage = 0x03,
+    };
+
+    struct Page {
+        byte* image = nullptr;
+        PageType type = UnmappedPage;
+        bool shared = false; // The image may be in use by a fork
+    };
+
     MemoryBanks m_banks;
+    Page m_pages[256];
+    std::shared_ptr<byte> m_copies[256];
+    bool m_forked = false;
+    std::bitset<256> m_dirty;
+    MemoryProfile* m_profile = nullptr;
+    History* m_history = nullptr;
 
     MemoryBank findBankForAddress(size_t) const;
     MemoryBank findBankForBlock(size_t, size_t) const;
+    void mapPages();
+    byte& lookup(std::size_t) const;
+    byte& writableLookup(std::size_t);
+    void copyOnWrite(int);
+    void detach();
 
 public:
     Memory();
@@ -80,10 +109,23 @@ public:
     explicit Memory(MemoryBank&);
     ~Memory() override = default;
 
-    byte& operator[](std::size_t);
-    const byte& operator[](std::size_t) const;
+    byte& operator[](std::size_t addr)
+    {
+        auto page = (addr <= 0xFFFF) ? &m_pages[addr >> 8] : nullptr;
+        return (page && page->image && !page->shared) ? page->image[addr & 0xFF] : writableLookup(addr);
+    }
+
+    const byte& operator[](std::size_t addr) const
+    {
+        auto image = (addr <= 0xFFFF) ? m_pages[addr >> 8].image : nullptr;
+        return (image) ? image[addr & 0xFF] : lookup(addr);
+    }
 
     void erase();
+    void fork(Memory&);
+    int copiedPages() const;
+    void read(word, size_t, byte*) const;
+    void write(word, size_t, const byte*);
     bool add(word, word, bool = true, const byte* = nullptr);
     bool add(MemoryBank&&);
     bool add(MemoryBank&);
@@ -101,6 +143,17 @@ public:
     bool inROM(word) const;
     bool isMapped(word) const;
 
+    void markDirty(word addr) { m_dirty.set(addr >> 8); }
+    void imageRestored();
+    std::bitset<256> takeDirtyPages();
+    void copyPage(int, byte*) const;
+    void setProfile(MemoryProfile* profile) { m_profile = profile; }
+    MemoryProfile* profile() const { return m_profile; }
+    void setHistory(History* history) { m_history = history; }
+
+    constexpr static int PAGE_SIZE = 0x100;
+
+    int alias() const override { return MEM_ID; }
     std::ostream& status(std::ostream&) override;
     SystemError onRisingClockEdge() override;
     SystemError onHighClock() override;
@@ -0,0 +1,108 @@
+/*
+ * Copyright (c) 2021, Jan de Visser <jan@finiandarcy.com>
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include <algorithm>
+#include <cstdio>
+
+#include <cpu/memory.h>
+#include <cpu/memoryprofile.h>
+
+namespace Obelix::JV80::CPU {
+
+MemoryProfile::MemoryProfile()
+    : reads(0x10000, 0)
+    , writes(0x10000, 0)
+{
+}
+
+/**
+ * @return The statistics of the <size> bytes starting at <start>.
+ */
+MemoryProfile::Usage MemoryProfile::usage(word start, word size) const
+{
+    Usage ret;
+    for (size_t addr = start; (addr < start + (size_t)size) && (addr < 0x10000); addr++) {
+        if (!reads[addr] && !writes[addr]) {
+            continue;
+        }
+        if (!ret.touched) {
+            ret.lowest = addr;
+        }
+        ret.highest = addr;
+        ret.touched++;
+        ret.reads += reads[addr];
+        ret.writes += writes[addr];
+    }
+    return ret;
+}
+
+void MemoryProfile::setStack(word start, word size)
+{
+    stackStart = start;
+    stackSize = size;
+    stackUsed = false;
+    highWater = 0;
+    overflows = 0;
+    underflows = 0;
+}
+
+void MemoryProfile::clear()
+{
+    std::fill(reads.begin(), reads.end(), 0);
+    std::fill(writes.begin(), writes.end(), 0);
+    setStack(stackStart, stackSize);
+}
+
+/**
+ * Writes a line for every page accessed at least once.
+ */
+std::ostream& MemoryProfile::writeHeatmap(std::ostream& os) const
+{
+    char buf[80];
+    os << "Page        Reads      Writes  Touched" << std::endl;
+    for (auto page = 0; page < 0x100; page++) {
+        auto u = usage(page * Memory::PAGE_SIZE, Memory::PAGE_SIZE);
+        if (!u.touched) {
+            continue;
+        }
+        snprintf(buf, 80, "%02x00  %10lu  %10lu  %7lu", page, u.reads, u.writes, u.touched);
+        os << buf << std::endl;
+    }
+    return os;
+}
+
+/**
+ * Writes a line for every byte accessed at least once.
+ */
+std::ostream& MemoryProfile::writeCSV(std::ostream& os) const
+{
+    char buf[80];
+    os << "address,reads,writes" << std::endl;
+    for (auto addr = 0; addr < 0x10000; addr++) {
+        if (!reads[addr] && !writes[addr]) {
+            continue;
+        }
+        snprintf(buf, 80, "0x%04x,%lu,%lu", addr, reads[addr], writes[addr]);
+        os << buf << std::endl;
+    }
+    return os;
+}
+
+std::ostream& MemoryProfile::writeStack(std::ostream& os) const
+{
+    char buf[120];
+    if (!stackUsed) {
+        snprintf(buf, 120, "Stack %04x-%04x unused", stackStart, stackStart + stackSize - 1);
+    } else {
+        auto depth = (highWater >= stackStart) ? highWater - stackStart + 1 : 0;
+        snprintf(buf, 120, "Stack %04x-%04x high water %04x (%d of %d bytes), %lu overflows, %lu underflows",
+            stackStart, stackStart + stackSize - 1, highWater, depth, stackSize, overflows, underflows);
+    }
+    os << buf << std::endl;
+    return os;
+}
+
+}
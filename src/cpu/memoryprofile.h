@@ -0,0 +1,75 @@
+/*
+ * Copyright (c) 2021, Jan de Visser <jan@finiandarcy.com>
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#pragma once
+
+#include <ostream>
+#include <vector>
+
+#include <cpu/component.h>
+
+namespace Obelix::JV80::CPU {
+
+/**
+ * Memory access statistics, collected by Memory and the FunctionalEngine
+ * while installed with BackPlane::enableMemoryProfile().
+ *
+ * Reads and writes are counted per byte. Instruction fetches count as
+ * reads. Stack accesses are the memory accesses at addresses taken from
+ * SP. The stack grows upwards from the start of the stack region, so the
+ * high water mark is the highest such address, and accesses beyond the
+ * end or below the start of the region are counted as overflows and
+ * underflows.
+ */
+struct MemoryProfile {
+    MemoryProfile();
+
+    std::vector<unsigned long> reads;
+    std::vector<unsigned long> writes;
+    word stackStart = DEFAULT_STACK;
+    word stackSize = DEFAULT_STACK_SIZE;
+    bool stackUsed = false;
+    word highWater = 0;
+    unsigned long overflows = 0;
+    unsigned long underflows = 0;
+
+    void read(word address) { reads[address]++; }
+    void write(word address) { writes[address]++; }
+
+    void stack(word address)
+    {
+        if (address < stackStart) {
+            underflows++;
+        } else if (address - stackStart >= stackSize) {
+            overflows++;
+        }
+        if (!stackUsed || (address > highWater)) {
+            highWater = address;
+            stackUsed = true;
+        }
+    }
+
+    struct Usage {
+        unsigned long reads = 0;
+        unsigned long writes = 0;
+        unsigned long touched = 0; // Bytes read or written at least once
+        word lowest = 0;
+        word highest = 0;
+    };
+
+    Usage usage(word, word) const;
+    void setStack(word, word);
+    void clear();
+    std::ostream& writeHeatmap(std::ostream&) const;
+    std::ostream& writeCSV(std::ostream&) const;
+    std::ostream& writeStack(std::ostream&) const;
+
+    // The stack region set up by the ROM, see asm/rom/rom.asm.
+    constexpr static word DEFAULT_STACK = 0x8000;
+    constexpr static word DEFAULT_STACK_SIZE = 0x0400;
+};
+
+}
@@ -0,0 +1,241 @@
+/*
+ * Copyright (c) 2021, Jan de Visser <jan@finiandarcy.com>
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+
+#include <cpu/profiler.h>
+
+namespace Obelix::JV80::CPU {
+
+namespace {
+
+double percentage(unsigned long count, unsigned long total)
+{
+    return (total) ? (100.0 * (double)count) / (double)total : 0.0;
+}
+
+}
+
+/**
+ * Parses a hexadecimal address, with or without a 0x or $ prefix.
+ */
+bool SymbolTable::parseAddress(std::string s, word& address)
+{
+    if (s.starts_with("0x") || s.starts_with("0X")) {
+        s = s.substr(2);
+    } else if (s.starts_with("$")) {
+        s = s.substr(1);
+    }
+    if (s.empty() || (s.size() > 4)) {
+        return false;
+    }
+    unsigned long value = 0;
+    for (auto ch : s) {
+        if (!isxdigit(ch)) {
+            return false;
+        }
+        value = value * 16 + (isdigit(ch) ? ch - '0' : tolower(ch) - 'a' + 10);
+    }
+    address = (word)value;
+    return true;
+}
+
+bool SymbolTable::load(const std::string& path)
+{
+    std::ifstream is(path);
+    if (!is) {
+        return false;
+    }
+    return load(is);
+}
+
+/**
+ * @return false if a line could not be parsed. The symbols read up to that
+ * line are kept.
+ */
+bool SymbolTable::load(std::istream& is)
+{
+    std::string line;
+    while (std::getline(is, line)) {
+        auto start = line.find_first_not_of(" \t\r");
+        if ((start == std::string::npos) || (line[start] == '#') || (line[start] == ';')) {
+            continue;
+        }
+        bool nameFirst = false;
+        for (auto& ch : line) {
+            if ((ch == '=') || (ch == ':')) {
+                ch = ' ';
+                nameFirst = true;
+            }
+        }
+        std::istringstream tokens(line);
+        std::string first, second, extra;
+        if (!(tokens >> first >> second) || (tokens >> extra)) {
+            return false;
+        }
+        if (nameFirst) {
+            std::swap(first, second);
+        }
+        word address;
+        if (!parseAddress(first, address)) {
+            return false;
+        }
+        add(address, second);
+    }
+    return true;
+}
+
+void SymbolTable::add(word address, const std::string& name)
+{
+    auto it = std::upper_bound(m_symbols.begin(), m_symbols.end(), address,
+        [](word a, const Symbol& s) { return a < s.address; });
+    m_symbols.insert(it, { address, name });
+}
+
+/**
+ * @return The symbol at or closest below <address>, or nullptr if there is
+ * none.
+ */
+const SymbolTable::Symbol* SymbolTable::resolve(word address) const
+{
+    auto it = std::upper_bound(m_symbols.begin(), m_symbols.end(), address,
+        [](word a, const Symbol& s) { return a < s.address; });
+    if (it == m_symbols.begin()) {
+        return nullptr;
+    }
+    return &*(--it);
+}
+
+/**
+ * Formats <address> as 'symbol+offset', or as a hexadecimal number if it
+ * is below the first symbol.
+ */
+std::string SymbolTable::format(word address) const
+{
+    char buf[80];
+    auto sym = resolve(address);
+    if (!sym) {
+        snprintf(buf, 80, "%04x", address);
+    } else if (sym->address == address) {
+        return sym->name;
+    } else {
+        snprintf(buf, 80, "%s+%d", sym->name.c_str(), address - sym->address);
+    }
+    return buf;
+}
+
+Profiler::Profiler(Mode mode, unsigned long interval)
+    : m_mode(mode)
+    , m_interval((interval) ? interval : 1)
+    , m_countdown(m_interval)
+    , m_histogram(0x10000, 0)
+{
+}
+
+void Profiler::clear()
+{
+    std::fill(m_histogram.begin(), m_histogram.end(), 0);
+    m_samples = 0;
+    m_countdown = m_interval;
+}
+
+/**
+ * Lists the <count> symbols with the most samples. Without symbols every
+ * address is listed separately.
+ */
+std::ostream& Profiler::flatProfile(std::ostream& os, const SymbolTable* symbols, size_t count) const
+{
+    struct Line {
+        unsigned long samples;
+        std::string name;
+    };
+    std::vector<Line> lines;
+    if (symbols && !symbols->empty()) {
+        const SymbolTable::Symbol* current = nullptr;
+        for (auto pc = 0; pc < 0x10000; pc++) {
+            if (!m_histogram[pc]) {
+                continue;
+            }
+            auto sym = symbols->resolve(pc);
+            if (!sym) {
+                lines.push_back({ m_histogram[pc], symbols->format(pc) });
+                current = nullptr;
+                continue;
+            }
+            if (sym != current) {
+                lines.push_back({ 0, sym->name });
+                current = sym;
+            }
+            lines.back().samples += m_histogram[pc];
+        }
+    } else {
+        char buf[8];
+        for (auto pc = 0; pc < 0x10000; pc++) {
+            if (m_histogram[pc]) {
+                snprintf(buf, 8, "%04x", pc);
+                lines.push_back({ m_histogram[pc], buf });
+            }
+        }
+    }
+    std::stable_sort(lines.begin(), lines.end(), [](const Line& l1, const Line& l2) {
+        return l1.samples > l2.samples;
+    });
+
+    char buf[120];
+    snprintf(buf, 120, "%lu samples, one every %lu %s", m_samples, m_interval,
+        (m_mode == Cycles) ? "cycles" : "instructions");
+    os << buf << std::endl;
+    os << "   Samples       %  Location" << std::endl;
+    for (auto ix = 0u; (ix < lines.size()) && (ix < count); ix++) {
+        snprintf(buf, 120, "%10lu  %5.1f%%  %s", lines[ix].samples,
+            percentage(lines[ix].samples, m_samples), lines[ix].name.c_str());
+        os << buf << std::endl;
+    }
+    return os;
+}
+
+/**
+ * Lists the <count> address ranges with the most samples. Sampled
+ * addresses less than <gap> bytes apart are joined into one range.
+ */
+std::ostream& Profiler::hotRanges(std::ostream& os, const SymbolTable* symbols, size_t count, int gap) const
+{
+    struct Range {
+        word from;
+        word to;
+        unsigned long samples;
+    };
+    std::vector<Range> ranges;
+    for (auto pc = 0; pc < 0x10000; pc++) {
+        if (!m_histogram[pc]) {
+            continue;
+        }
+        if (!ranges.empty() && (pc - ranges.back().to < gap)) {
+            ranges.back().to = pc;
+            ranges.back().samples += m_histogram[pc];
+        } else {
+            ranges.push_back({ (word)pc, (word)pc, m_histogram[pc] });
+        }
+    }
+    std::stable_sort(ranges.begin(), ranges.end(), [](const Range& r1, const Range& r2) {
+        return r1.samples > r2.samples;
+    });
+
+    char buf[120];
+    os << "Range           Samples       %  Location" << std::endl;
+    for (auto ix = 0u; (ix < ranges.size()) && (ix < count); ix++) {
+        auto& r = ranges[ix];
+        snprintf(buf, 120, "%04x-%04x  %10lu  %5.1f%%  %s", r.from, r.to, r.samples,
+            percentage(r.samples, m_samples), (symbols && !symbols->empty()) ? symbols->format(r.from).c_str() : "");
+        os << buf << std::endl;
+    }
+    return os;
+}
+
+}
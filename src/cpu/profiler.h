@@ -0,0 +1,110 @@
+/*
+ * Copyright (c) 2021, Jan de Visser <jan@finiandarcy.com>
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#pragma once
+
+#include <istream>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include <cpu/component.h>
+
+namespace Obelix::JV80::CPU {
+
+/**
+ * Maps guest addresses to labels.
+ *
+ * Symbol files have one label per line, either as '<address> <name>' or as
+ * '<name> = <address>' or '<name>: <address>'. Addresses are hexadecimal,
+ * with or without a 0x or $ prefix. Empty lines and lines starting with
+ * '#' or ';' are ignored.
+ */
+class SymbolTable {
+public:
+    struct Symbol {
+        word address;
+        std::string name;
+    };
+
+    bool load(const std::string&);
+    bool load(std::istream&);
+    static bool parseAddress(std::string, word&);
+    void add(word, const std::string&);
+    void clear() { m_symbols.clear(); }
+    bool empty() const { return m_symbols.empty(); }
+    size_t size() const { return m_symbols.size(); }
+
+    const Symbol* resolve(word) const;
+    std::string format(word) const;
+
+private:
+    std::vector<Symbol> m_symbols; // Sorted by address
+};
+
+/**
+ * Histogram of the guest program counter.
+ *
+ * In Cycles mode the PC is sampled every <interval> system cycles, in
+ * Instructions mode every <interval> completed instructions. The
+ * cycle-accurate engine samples the PC as it is during the cycle, which is
+ * somewhere inside the instruction being executed. The FunctionalEngine
+ * attributes the cycles of an instruction to its address. After an
+ * instruction the PC holds the address of the next one, so Instructions
+ * mode counts how often every instruction started.
+ */
+class Profiler {
+public:
+    enum Mode {
+        Cycles,
+        Instructions,
+    };
+
+    explicit Profiler(Mode = Cycles, unsigned long interval = DEFAULT_INTERVAL);
+
+    Mode mode() const { return m_mode; }
+    unsigned long interval() const { return m_interval; }
+
+    /**
+     * Advances the profiler by <n> cycles or instructions.
+     *
+     * @return The number of samples due.
+     */
+    unsigned long due(unsigned long n = 1)
+    {
+        if (n < m_countdown) {
+            m_countdown -= n;
+            return 0;
+        }
+        n -= m_countdown;
+        m_countdown = m_interval - n % m_interval;
+        return 1 + n / m_interval;
+    }
+
+    void sample(word pc, unsigned long count = 1)
+    {
+        m_histogram[pc] += count;
+        m_samples += count;
+    }
+
+    unsigned long samples() const { return m_samples; }
+    unsigned long samples(word pc) const { return m_histogram[pc]; }
+    void clear();
+
+    std::ostream& flatProfile(std::ostream&, const SymbolTable* = nullptr, size_t = 20) const;
+    std::ostream& hotRanges(std::ostream&, const SymbolTable* = nullptr, size_t = 10, int = 4) const;
+
+    constexpr static unsigned long DEFAULT_INTERVAL = 97;
+
+private:
+    Mode m_mode;
+    unsigned long m_interval;
+    unsigned long m_countdown;
+    unsigned long m_samples = 0;
+    std::vector<unsigned long> m_histogram;
+};
+
+}
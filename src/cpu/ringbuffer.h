@@ -0,0 +1,65 @@
+/*
+ * Copyright (c) 2021, Jan de Visser <jan@finiandarcy.com>
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <vector>
+
+namespace Obelix::JV80::CPU {
+
+/**
+ * Bounded lock-free single-producer, single-consumer queue. push() may only
+ * be called from one thread and pop() from one other thread.
+ */
+template<typename T>
+class RingBuffer {
+public:
+    explicit RingBuffer(size_t capacity)
+        : m_ring(std::bit_ceil(std::max(capacity, (size_t)2)))
+        , m_mask(m_ring.size() - 1)
+    {
+    }
+
+    size_t capacity() const { return m_ring.size(); }
+
+    bool empty() const
+    {
+        return m_head.load(std::memory_order_acquire) == m_tail.load(std::memory_order_acquire);
+    }
+
+    bool push(const T& value)
+    {
+        auto head = m_head.load(std::memory_order_relaxed);
+        if (head - m_tail.load(std::memory_order_acquire) > m_mask) {
+            return false;
+        }
+        m_ring[head & m_mask] = value;
+        m_head.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool pop(T& value)
+    {
+        auto tail = m_tail.load(std::memory_order_relaxed);
+        if (tail == m_head.load(std::memory_order_acquire)) {
+            return false;
+        }
+        value = std::move(m_ring[tail & m_mask]);
+        m_tail.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+private:
+    std::vector<T> m_ring;
+    size_t m_mask;
+    alignas(64) std::atomic<size_t> m_head = 0;
+    alignas(64) std::atomic<size_t> m_tail = 0;
+};
+
+}
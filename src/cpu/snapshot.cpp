@@ -0,0 +1,64 @@
+/*
+ * Copyright (c) 2021, Jan de Visser <jan@finiandarcy.com>
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include <cpu/snapshot.h>
+
+namespace Obelix::JV80::CPU {
+
+SnapshotBuffer::SnapshotBuffer()
+{
+    invalidate();
+}
+
+/**
+ * Marks the memory in all buffers out of date. Called by the writer when
+ * memory may have been changed without being marked dirty, for example
+ * from the GUI while the system was stopped.
+ */
+void SnapshotBuffer::invalidate()
+{
+    for (auto& stale : m_stale) {
+        stale.set();
+    }
+}
+
+/**
+ * Brings the memory in the back buffer up to date and makes the back
+ * buffer the latest state.
+ */
+void SnapshotBuffer::publish(Memory& memory)
+{
+    auto dirty = memory.takeDirtyPages();
+    for (auto& stale : m_stale) {
+        stale |= dirty;
+    }
+    auto& state = m_buffers[m_back];
+    auto& stale = m_stale[m_back];
+    for (auto page = 0; page < 256; page++) {
+        if (stale[page]) {
+            memory.copyPage(page, state.memory + page * Memory::PAGE_SIZE);
+        }
+    }
+    stale.reset();
+    state.registers[MEM] = state.memory[state.registers[MEMADDR]];
+    state.sequence = ++m_sequence;
+    m_back = m_ready.exchange(m_back | FRESH, std::memory_order_acq_rel) & INDEX_MASK;
+}
+
+/**
+ * @return The most recently published state, or nullptr if nothing was
+ * published yet. The state remains valid until the next call.
+ */
+const MachineState* SnapshotBuffer::latest()
+{
+    if (m_ready.load(std::memory_order_relaxed) & FRESH) {
+        m_front = m_ready.exchange(m_front, std::memory_order_acq_rel) & INDEX_MASK;
+    }
+    auto& state = m_buffers[m_front];
+    return (state.sequence) ? &state : nullptr;
+}
+
+}
@@ -0,0 +1,77 @@
+/*
+ * Copyright (c) 2021, Jan de Visser <jan@finiandarcy.com>
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#pragma once
+
+#include <atomic>
+#include <bitset>
+
+#include <cpu/memory.h>
+#include <cpu/registers.h>
+
+namespace Obelix::JV80::CPU {
+
+/**
+ * A copy of the visible state of the machine, taken between two clock
+ * cycles.
+ */
+struct MachineState {
+    unsigned long sequence = 0;
+
+    // Indexed by register ID. The 8-bit registers only use the low byte.
+    // The MEM entry holds the memory contents at MEMADDR.
+    word registers[16] = {};
+
+    byte dataBus = 0;
+    byte addrBus = 0;
+    byte getID = 0;
+    byte putID = 0;
+    byte opflags = 0;
+    byte flags = 0;
+    bool xdata = true;
+    bool xaddr = true;
+    bool io = true;
+    bool halt = true;
+    bool sus = true;
+    bool nmi = true;
+
+    int step = 0;
+    const char* instruction = nullptr;
+
+    byte memory[0x10000] = {};
+};
+
+/**
+ * Triple buffer handing MachineStates from the thread running the system
+ * to a reader, for example the GUI thread.
+ *
+ * The writer fills back() and calls publish(); the reader calls latest().
+ * Neither side ever waits for the other, and the reader always gets a
+ * complete state. Memory pages are only copied into a buffer when they were
+ * written since that buffer was last published.
+ */
+class SnapshotBuffer {
+public:
+    SnapshotBuffer();
+
+    MachineState& back() { return m_buffers[m_back]; }
+    void invalidate();
+    void publish(Memory&);
+    const MachineState* latest();
+
+private:
+    constexpr static int INDEX_MASK = 0x03;
+    constexpr static int FRESH = 0x04;
+
+    MachineState m_buffers[3];
+    std::bitset<256> m_stale[3];
+    int m_back = 0;
+    int m_front = 1;
+    std::atomic<int> m_ready = 2;
+    unsigned long m_sequence = 0;
+};
+
+}
@@ -0,0 +1,32 @@
+/*
+ * Copyright (c) 2021, Jan de Visser <jan@finiandarcy.com>
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include <cstring>
+
+#include <cpu/statefile.h>
+
+namespace Obelix::JV80::CPU {
+
+/**
+ * FNV-1a over the image, taken eight bytes at a time. Used to recognize
+ * ROM images, not to protect against tampering.
+ */
+uint64_t imageHash(const byte* image, size_t size)
+{
+    uint64_t hash = 0xcbf29ce484222325ull;
+    size_t ix = 0;
+    for (; ix + 8 <= size; ix += 8) {
+        uint64_t chunk;
+        memcpy(&chunk, image + ix, 8);
+        hash = (hash ^ chunk) * 0x100000001b3ull;
+    }
+    for (; ix < size; ix++) {
+        hash = (hash ^ image[ix]) * 0x100000001b3ull;
+    }
+    return hash ^ size;
+}
+
+}
@@ -0,0 +1,89 @@
+/*
+ * Copyright (c) 2021, Jan de Visser <jan@finiandarcy.com>
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+#include <cpu/controller.h>
+#include <cpu/mappedfile.h>
+
+namespace Obelix::JV80::CPU {
+
+/*
+ * State files hold the complete state of a stopped machine, see
+ * BackPlane::saveState(). Layout, in host byte order:
+ *
+ *   StateFileHeader
+ *   StateBankInfo[]            (one for every memory bank)
+ *   RAM contents               (every bank starts on a STATE_ALIGNMENT boundary)
+ *
+ * The contents of ROM banks are not stored. They are identified by their
+ * hash, and have to be loaded in the machine the state is restored into.
+ * Because the RAM images are aligned, a mapped state file can be copied
+ * straight into memory.
+ */
+
+struct StateFileHeader {
+    enum Lines : uint8_t {
+        XData = 0x01,
+        XAddr = 0x02,
+        IO = 0x04,
+        Halt = 0x08,
+        Sus = 0x10,
+        NMI = 0x20,
+    };
+
+    char magic[8] = { 'J', 'V', '8', '0', 'S', 'T', 'A', '1' };
+    uint32_t version = 1;
+    uint32_t banks = 0;
+
+    // Indexed by register ID, like MachineState::registers. The MEM entry
+    // is not used.
+    uint16_t registers[16] = {};
+
+    uint8_t dataBus = 0;
+    uint8_t addrBus = 0;
+    uint8_t getID = 0;
+    uint8_t putID = 0;
+    uint8_t opflags = 0;
+    uint8_t flags = 0;
+    uint8_t lines = 0; // Bit set for every control line that is high
+    uint8_t phase = 0; // The BackPlane's clock phase
+    SequencerState sequencer;
+};
+
+static_assert(sizeof(StateFileHeader) == 72);
+
+struct StateBankInfo {
+    uint64_t offset = 0; // File offset of the contents. 0 for ROM banks
+    uint64_t hash = 0;
+    uint16_t start = 0;
+    uint16_t size = 0;
+    uint8_t writable = 0;
+    uint8_t reserved[3] = {};
+    uint32_t padding = 0;
+};
+
+static_assert(sizeof(StateBankInfo) == 32);
+
+constexpr static size_t STATE_ALIGNMENT = 4096;
+
+uint64_t imageHash(const byte*, size_t);
+
+/**
+ * Read-only mapping of a state file.
+ */
+class StateFile : public MappedFile {
+public:
+    explicit StateFile(const std::string& path)
+        : MappedFile(path, sizeof(StateFileHeader))
+    {
+    }
+};
+
+}
@@ -120,6 +120,18 @@ void SystemBus::suspend()
     sendEvent(EV_VALUECHANGED);
 }
 
+/**
+ * Sets the halt, suspend, and NMI lines to the given levels. Used when a
+ * saved machine state is restored.
+ */
+void SystemBus::restoreLines(bool halt, bool sus, bool nmi)
+{
+    _halt = halt;
+    _sus = sus;
+    _nmi = nmi;
+    sendEvent(EV_VALUECHANGED);
+}
+
 std::ostream& SystemBus::status(std::ostream& os)
 {
     os << "DATA ADDR  GET PUT OP ACT FLAG" << std::endl;
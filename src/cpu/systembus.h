@@ -6,6 +6,8 @@
 
 #pragma once
 
+#include <atomic>
+#include <bit>
 #include <cpu/component.h>
 #include <vector>
 
@@ -43,7 +45,9 @@ private:
     byte m_flags = 0x0;
 
     void _reset();
-    RunMode m_runMode = Continuous;
+
+    // Changed by other threads to interrupt a run, see Worker::pause():
+    std::atomic<RunMode> m_runMode = Continuous;
 
 public:
     enum ProcessorFlags {
@@ -90,6 +94,7 @@ public:
     void io(int, int, int);
     void stop();
     void suspend();
+    void restoreLines(bool, bool, bool);
     SystemError reset() override;
     std::ostream& status(std::ostream&) override;
 
@@ -101,8 +106,8 @@ public:
     bool isSet(ProcessorFlags) const;
     std::string flagsString() const;
 
-    RunMode runMode() const { return m_runMode; }
-    void setRunMode(RunMode runMode) { m_runMode = runMode; }
+    RunMode runMode() const { return m_runMode.load(std::memory_order_relaxed); }
+    void setRunMode(RunMode runMode) { m_runMode.store(runMode); }
 
     ComponentContainer& backplane()
     {
@@ -127,6 +132,9 @@ protected:
 public:
     virtual int id() const { return ident; }
     virtual int alias() const { return id(); }
+    // Components which act on clock phases in which they are not the source
+    // or target of the bus transfer must return true here.
+    virtual bool alwaysNotify() const { return false; }
     virtual std::string name() const { return componentName; }
     void bus(SystemBus* bus) { systemBus = bus; }
     SystemBus* bus() const { return systemBus; }
@@ -138,6 +146,20 @@ private:
     std::vector<ConnectedComponent*> m_components;
     std::vector<int> m_aliases;
     std::vector<ConnectedComponent*> m_io;
+    unsigned int m_notifyMask = 0;
+    unsigned int m_phaseMask[4] = {};
+    unsigned int m_ioPhaseMask[4] = {};
+
+    static void subscribe(unsigned int (&masks)[4], ConnectedComponent* component)
+    {
+        auto bit = 1u << component->id();
+        for (int phase = RisingClockEdge; phase <= LowClock; phase++) {
+            masks[phase] &= ~bit;
+            if (component->clockPhases() & (1 << phase)) {
+                masks[phase] |= bit;
+            }
+        }
+    }
 
 protected:
     SystemBus m_bus;
@@ -174,6 +196,11 @@ public:
         if (component->id() != component->alias()) {
             m_aliases[component->alias()] = component->id();
         }
+        m_notifyMask &= ~(1u << component->id());
+        if (component->alwaysNotify()) {
+            m_notifyMask |= 1u << component->id();
+        }
+        subscribe(m_phaseMask, component);
     }
 
     ConnectedComponent* component(int ix) const
@@ -185,6 +212,12 @@ public:
     {
         component->bus(&m_bus);
         m_io[component->id()] = component;
+        subscribe(m_ioPhaseMask, component);
+    }
+
+    ConnectedComponent* channel(int ix) const
+    {
+        return m_io[ix];
     }
 
     SystemBus& bus()
@@ -219,6 +252,48 @@ public:
         return NoError;
     }
 
+    /**
+     * Sends clock phase <phase> to the components which can act on the
+     * current bus transfer: the source and target of the transfer, the
+     * components which want to be notified of every phase, and the addressed
+     * IO channel. Components which do not implement <phase> are skipped. The
+     * components are called in the same order as forAllComponents and
+     * forAllChannels would call them, so the effect on the bus is the same as
+     * broadcasting the phase.
+     */
+    SystemError forAddressedComponents(ClockPhase phase)
+    {
+        constexpr static ClockHandler handlers[] = {
+            &Component::onRisingClockEdge,
+            &Component::onHighClock,
+            &Component::onFallingClockEdge,
+            &Component::onLowClock,
+        };
+        auto handler = handlers[phase];
+        auto mask = m_phaseMask[phase]
+            & (m_notifyMask
+                | (1u << m_aliases[m_bus.getID() & 0x0F])
+                | (1u << m_aliases[m_bus.putID() & 0x0F]));
+        while (mask) {
+            auto component = m_components[std::countr_zero(mask)];
+            mask &= mask - 1;
+            if (!component)
+                continue;
+            (component->*handler)();
+            error(component->error());
+            if (error() != NoError) {
+                return error();
+            }
+        }
+        if (!m_bus.io() && (m_ioPhaseMask[phase] & (1u << (m_bus.putID() & 0x0F)))) {
+            if (auto channel = m_io[m_bus.putID() & 0x0F]; channel) {
+                (channel->*handler)();
+                error(channel->error());
+            }
+        }
+        return error();
+    }
+
     SystemError forAllChannels(const ComponentHandler& handler)
     {
         for (auto& channel : m_io) {
@@ -0,0 +1,57 @@
+/*
+ * Copyright (c) 2021, Jan de Visser <jan@finiandarcy.com>
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include <algorithm>
+#include <bit>
+#include <cstdio>
+
+#include <cpu/trace.h>
+
+namespace Obelix::JV80::CPU {
+
+CycleTrace::CycleTrace(size_t capacity)
+    : m_ring(std::bit_ceil(std::max(capacity, (size_t)2)))
+    , m_mask(m_ring.size() - 1)
+{
+}
+
+/**
+ * Writes the last <count> records held in the trace, oldest first, one line
+ * per cycle. If <microCode> is given the mnemonic of the instruction in IR
+ * is included.
+ */
+std::ostream& CycleTrace::render(std::ostream& os, const MicroCode* microCode, size_t count) const
+{
+    auto sz = size();
+    count = std::min(count, sz);
+    os << "CYCLE    PC   IR INSTRUCTION     STEP DATA ADDR GET PUT OP ACT FLAG" << std::endl;
+    for (auto ix = sz - count; ix < sz; ix++) {
+        render(os, (*this)[ix], microCode);
+    }
+    return os;
+}
+
+std::ostream& CycleTrace::render(std::ostream& os, const CycleRecord& r, const MicroCode* microCode)
+{
+    const char* instruction = (microCode && microCode[r.ir].instruction) ? microCode[r.ir].instruction : "";
+    char flags[4] = {
+        (char)((r.flags & SystemBus::C) ? 'C' : '-'),
+        (char)((r.flags & SystemBus::Z) ? 'Z' : '-'),
+        (char)((r.flags & SystemBus::V) ? 'V' : '-'),
+        0,
+    };
+    char act = (r.lines & CycleRecord::XData) ? ((r.lines & CycleRecord::XAddr) ? '_' : 'A') : 'D';
+    if (!(r.lines & CycleRecord::IO)) {
+        act = 'I';
+    }
+    char buf[100];
+    snprintf(buf, 100, "%08lx %04x %02x %-15.15s %4d  %02x   %02x    %01x   %01x  %01x   %c  %s%s\n",
+        (unsigned long)r.cycle, r.pc, r.ir, instruction, r.step, r.dataBus, r.addrBus, r.getID, r.putID, r.opflags,
+        act, flags, (r.lines & CycleRecord::Halt) ? "" : " HLT");
+    return os << buf;
+}
+
+}
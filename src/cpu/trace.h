@@ -0,0 +1,83 @@
+/*
+ * Copyright (c) 2021, Jan de Visser <jan@finiandarcy.com>
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <ostream>
+#include <vector>
+
+#include <cpu/controller.h>
+#include <cpu/registers.h>
+
+namespace Obelix::JV80::CPU {
+
+/**
+ * The state of the machine during one system clock cycle, packed
+ * into 24 bytes.
+ */
+struct CycleRecord {
+    enum Lines {
+        XData = 0x01,
+        XAddr = 0x02,
+        IO = 0x04,
+        Halt = 0x08,
+        Sus = 0x10,
+        NMI = 0x20,
+    };
+
+    uint64_t cycle = 0;
+    word pc = 0;
+    byte dataBus = 0;
+    byte addrBus = 0;
+    byte getID = 0;
+    byte putID = 0;
+    byte opflags = 0;
+    byte flags = 0;
+    byte ir = 0;
+    byte step = 0;
+    byte lines = 0; // Lines bit set if the (active-low) line is inactive.
+};
+
+static_assert(sizeof(CycleRecord) == 24);
+
+/**
+ * Fixed-size ring of CycleRecords. Once the ring is full every new record
+ * overwrites the oldest one, so the trace always holds the most recent
+ * cycles and never grows. Records are only formatted as text by render().
+ *
+ * Not thread safe: the trace may only be read while the system is stopped.
+ */
+class CycleTrace {
+public:
+    explicit CycleTrace(size_t = DEFAULT_CAPACITY);
+
+    void record(const CycleRecord& r)
+    {
+        m_ring[m_total & m_mask] = r;
+        m_total++;
+    }
+
+    size_t capacity() const { return m_ring.size(); }
+    size_t size() const { return (m_total < m_ring.size()) ? m_total : m_ring.size(); }
+    unsigned long total() const { return m_total; }
+    void clear() { m_total = 0; }
+
+    // Index 0 is the oldest record still held.
+    const CycleRecord& operator[](size_t ix) const { return m_ring[(m_total - size() + ix) & m_mask]; }
+
+    std::ostream& render(std::ostream&, const MicroCode* = nullptr, size_t = ~(size_t)0) const;
+    static std::ostream& render(std::ostream&, const CycleRecord&, const MicroCode* = nullptr);
+
+    constexpr static size_t DEFAULT_CAPACITY = 65536;
+
+private:
+    std::vector<CycleRecord> m_ring;
+    size_t m_mask;
+    unsigned long m_total = 0;
+};
+
+}
@@ -0,0 +1,370 @@
+/*
+ * Copyright (c) 2021, Jan de Visser <jan@finiandarcy.com>
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include <algorithm>
+#include <cstring>
+
+#include <cpu/tracefile.h>
+#include <cpu/varint.h>
+
+namespace Obelix::JV80::CPU {
+
+namespace {
+
+enum ChangedField {
+    ChangedDataBus = 0x001,
+    ChangedAddrBus = 0x002,
+    ChangedNextPC = 0x004,
+    ChangedIR = 0x008,
+    ChangedStep = 0x010,
+    ChangedIDs = 0x020,
+    ChangedOpFlags = 0x040,
+    ChangedFlags = 0x080,
+    ChangedLines = 0x100,
+    ChangedPC = 0x200,
+    ChangedCycle = 0x400,
+};
+
+constexpr size_t REFERENCES = 256 * 32;
+
+size_t referenceIndex(const CycleRecord& r)
+{
+    return (r.ir << 5) | (r.step & 0x1F);
+}
+
+}
+
+TraceCodec::TraceCodec()
+    : m_references(REFERENCES)
+    , m_generations(REFERENCES, 0)
+{
+}
+
+/**
+ * Forgets everything seen before, so the records that follow can be
+ * decoded on their own.
+ */
+void TraceCodec::start(uint64_t firstCycle)
+{
+    m_previous = CycleRecord();
+    m_previous.cycle = firstCycle - 1;
+    m_generation++;
+}
+
+const CycleRecord& TraceCodec::reference(const CycleRecord& r) const
+{
+    auto ix = referenceIndex(r);
+    return (m_generations[ix] == m_generation) ? m_references[ix] : m_previous;
+}
+
+void TraceCodec::remember(const CycleRecord& r)
+{
+    auto ix = referenceIndex(r);
+    m_references[ix] = r;
+    m_generations[ix] = m_generation;
+    m_previous = r;
+}
+
+void TraceCodec::encode(const CycleRecord& r, std::vector<byte>& buf)
+{
+    auto& p = m_previous;
+    auto& ref = reference(r);
+    unsigned int mask = 0;
+    mask |= (r.ir != p.ir) ? ChangedIR : 0;
+    mask |= (r.step != (byte)(p.step + 1)) ? ChangedStep : 0;
+    if (r.pc == (word)(p.pc + 1)) {
+        mask |= ChangedNextPC;
+    } else if (r.pc != p.pc) {
+        mask |= ChangedPC;
+    }
+    mask |= (r.dataBus != ref.dataBus) ? ChangedDataBus : 0;
+    mask |= (r.addrBus != ref.addrBus) ? ChangedAddrBus : 0;
+    mask |= ((r.getID != ref.getID) || (r.putID != ref.putID)) ? ChangedIDs : 0;
+    mask |= (r.opflags != ref.opflags) ? ChangedOpFlags : 0;
+    mask |= (r.flags != p.flags) ? ChangedFlags : 0;
+    mask |= (r.lines != ref.lines) ? ChangedLines : 0;
+    mask |= (r.cycle != p.cycle + 1) ? ChangedCycle : 0;
+
+    putVarint(buf, mask);
+    if (mask & ChangedIR) {
+        buf.push_back(r.ir);
+    }
+    if (mask & ChangedStep) {
+        buf.push_back(r.step);
+    }
+    if (mask & ChangedPC) {
+        buf.push_back((byte)(r.pc & 0x00FF));
+        buf.push_back((byte)(r.pc >> 8));
+    }
+    if (mask & ChangedDataBus) {
+        buf.push_back(r.dataBus);
+    }
+    if (mask & ChangedAddrBus) {
+        buf.push_back(r.addrBus);
+    }
+    if (mask & ChangedIDs) {
+        buf.push_back((byte)((r.getID << 4) | (r.putID & 0x0F)));
+    }
+    if (mask & ChangedOpFlags) {
+        buf.push_back(r.opflags);
+    }
+    if (mask & ChangedFlags) {
+        buf.push_back(r.flags);
+    }
+    if (mask & ChangedLines) {
+        buf.push_back(r.lines);
+    }
+    if (mask & ChangedCycle) {
+        putVarint(buf, r.cycle - p.cycle - 1);
+    }
+    remember(r);
+}
+
+/**
+ * Decodes the record at <p> into <r> and advances <p> past it.
+ *
+ * @return false if the record runs past <end>.
+ */
+bool TraceCodec::decode(const byte*& p, const byte* end, CycleRecord& r)
+{
+    uint64_t mask;
+    if (!getVarint(p, end, mask)) {
+        return false;
+    }
+    auto next = [&p, end](byte& value) {
+        if (p >= end) {
+            return false;
+        }
+        value = *p++;
+        return true;
+    };
+
+    r.ir = m_previous.ir;
+    r.step = m_previous.step + 1;
+    r.pc = (mask & ChangedNextPC) ? m_previous.pc + 1 : m_previous.pc;
+    r.flags = m_previous.flags;
+    if ((mask & ChangedIR) && !next(r.ir)) {
+        return false;
+    }
+    if ((mask & ChangedStep) && !next(r.step)) {
+        return false;
+    }
+    if (mask & ChangedPC) {
+        byte lo, hi;
+        if (!next(lo) || !next(hi)) {
+            return false;
+        }
+        r.pc = lo | (hi << 8);
+    }
+
+    auto& ref = reference(r);
+    r.dataBus = ref.dataBus;
+    r.addrBus = ref.addrBus;
+    r.getID = ref.getID;
+    r.putID = ref.putID;
+    r.opflags = ref.opflags;
+    r.lines = ref.lines;
+    if ((mask & ChangedDataBus) && !next(r.dataBus)) {
+        return false;
+    }
+    if ((mask & ChangedAddrBus) && !next(r.addrBus)) {
+        return false;
+    }
+    if (mask & ChangedIDs) {
+        byte ids;
+        if (!next(ids)) {
+            return false;
+        }
+        r.getID = ids >> 4;
+        r.putID = ids & 0x0F;
+    }
+    if ((mask & ChangedOpFlags) && !next(r.opflags)) {
+        return false;
+    }
+    if ((mask & ChangedFlags) && !next(r.flags)) {
+        return false;
+    }
+    if ((mask & ChangedLines) && !next(r.lines)) {
+        return false;
+    }
+    uint64_t skipped = 0;
+    if ((mask & ChangedCycle) && !getVarint(p, end, skipped)) {
+        return false;
+    }
+    r.cycle = m_previous.cycle + 1 + skipped;
+    remember(r);
+    return true;
+}
+
+TraceWriter::TraceWriter(const std::string& path, size_t chunkRecords)
+    : m_file(path, std::ios::binary | std::ios::trunc)
+    , m_chunkRecords(chunkRecords)
+{
+    TraceFileHeader header;
+    header.chunkRecords = m_chunkRecords;
+    m_file.write((const char*)&header, sizeof(header));
+    m_bytes = sizeof(header);
+    m_buffer.reserve(m_chunkRecords * 4);
+}
+
+TraceWriter::~TraceWriter()
+{
+    close();
+}
+
+void TraceWriter::record(const CycleRecord& r)
+{
+    if (!m_chunk.count) {
+        m_chunk.firstCycle = r.cycle;
+        m_codec.start(r.cycle);
+    }
+    m_codec.encode(r, m_buffer);
+    m_chunk.count++;
+    m_chunk.minPC = std::min(m_chunk.minPC, r.pc);
+    m_chunk.maxPC = std::max(m_chunk.maxPC, r.pc);
+    m_chunk.components |= (1 << (r.getID & 0x0F)) | (1 << (r.putID & 0x0F));
+    m_chunk.opcodes[r.ir >> 3] |= 1 << (r.ir & 0x07);
+    m_records++;
+    if (m_chunk.count == m_chunkRecords) {
+        flush();
+    }
+}
+
+void TraceWriter::flush()
+{
+    if (!m_chunk.count || !m_file.is_open()) {
+        return;
+    }
+    m_chunk.offset = m_bytes + sizeof(TraceChunkInfo);
+    m_chunk.size = m_buffer.size();
+    m_file.write((const char*)&m_chunk, sizeof(m_chunk));
+    m_file.write((const char*)m_buffer.data(), (std::streamsize)m_buffer.size());
+    m_bytes += sizeof(m_chunk) + m_buffer.size();
+    m_index.push_back(m_chunk);
+    m_chunk = TraceChunkInfo();
+    m_buffer.clear();
+}
+
+/**
+ * Writes the last partial chunk and the index, and closes the file. Called
+ * by the destructor if it wasn't called before.
+ */
+void TraceWriter::close()
+{
+    if (!m_file.is_open()) {
+        return;
+    }
+    flush();
+    TraceFileFooter footer;
+    footer.indexOffset = m_bytes;
+    footer.chunks = m_index.size();
+    m_file.write((const char*)m_index.data(), (std::streamsize)(m_index.size() * sizeof(TraceChunkInfo)));
+    m_file.write((const char*)&footer, sizeof(footer));
+    m_bytes += m_index.size() * sizeof(TraceChunkInfo) + sizeof(footer);
+    m_file.close();
+}
+
+TraceReader::TraceReader(const std::string& path)
+    : m_map(path, sizeof(TraceFileHeader))
+{
+    if (!m_map.valid()) {
+        m_error = m_map.error();
+        return;
+    }
+    TraceFileHeader header;
+    TraceFileHeader expected;
+    memcpy(&header, m_map.data(), sizeof(header));
+    if (memcmp(header.magic, expected.magic, sizeof(header.magic)) || (header.version != expected.version)) {
+        m_error = path + " is not a trace file";
+        return;
+    }
+    m_valid = readIndex() || scanChunks();
+    if (!m_valid) {
+        m_error = path + " is corrupt";
+    }
+}
+
+bool TraceReader::readIndex()
+{
+    TraceFileFooter footer;
+    TraceFileFooter expected;
+    if (m_map.size() < sizeof(TraceFileHeader) + sizeof(footer)) {
+        return false;
+    }
+    memcpy(&footer, m_map.data() + m_map.size() - sizeof(footer), sizeof(footer));
+    auto indexEnd = m_map.size() - sizeof(footer);
+    if (memcmp(footer.magic, expected.magic, sizeof(footer.magic)) || (footer.indexOffset > indexEnd)
+        || (footer.chunks != (indexEnd - footer.indexOffset) / sizeof(TraceChunkInfo))
+        || ((indexEnd - footer.indexOffset) % sizeof(TraceChunkInfo))) {
+        return false;
+    }
+    m_chunks.resize(footer.chunks);
+    memcpy(m_chunks.data(), m_map.data() + footer.indexOffset, footer.chunks * sizeof(TraceChunkInfo));
+    for (auto& chunk : m_chunks) {
+        if ((chunk.offset > footer.indexOffset) || (chunk.size > footer.indexOffset - chunk.offset)) {
+            m_chunks.clear();
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * Rebuilds the index from the chunk headers if the file has no index,
+ * because the writer was never closed. A truncated last chunk is ignored.
+ *
+ * @return false if the file holds more than the header, but no chunks.
+ */
+bool TraceReader::scanChunks()
+{
+    size_t offset = sizeof(TraceFileHeader);
+    while (offset + sizeof(TraceChunkInfo) <= m_map.size()) {
+        TraceChunkInfo chunk;
+        memcpy(&chunk, m_map.data() + offset, sizeof(chunk));
+        if ((chunk.offset != offset + sizeof(chunk)) || (chunk.size > m_map.size() - chunk.offset)) {
+            break;
+        }
+        m_chunks.push_back(chunk);
+        offset = chunk.offset + chunk.size;
+    }
+    return !m_chunks.empty() || (offset == m_map.size());
+}
+
+unsigned long TraceReader::records() const
+{
+    unsigned long ret = 0;
+    for (auto& chunk : m_chunks) {
+        ret += chunk.count;
+    }
+    return ret;
+}
+
+/**
+ * Decodes the records in <chunk> into <records>, replacing its contents.
+ *
+ * @return false if the chunk is corrupt.
+ */
+bool TraceReader::decode(const TraceChunkInfo& chunk, std::vector<CycleRecord>& records)
+{
+    // Every record takes at least one byte:
+    if ((chunk.offset > m_map.size()) || (chunk.size > m_map.size() - chunk.offset) || (chunk.count > chunk.size)) {
+        records.clear();
+        return false;
+    }
+    records.resize(chunk.count);
+    const byte* p = m_map.data() + chunk.offset;
+    const byte* end = p + chunk.size;
+    m_codec.start(chunk.firstCycle);
+    for (auto& r : records) {
+        if (!m_codec.decode(p, end, r)) {
+            records.clear();
+            return false;
+        }
+    }
+    return true;
+}
+
+}
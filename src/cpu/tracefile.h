@@ -0,0 +1,155 @@
+/*
+ * Copyright (c) 2021, Jan de Visser <jan@finiandarcy.com>
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include <cpu/mappedfile.h>
+#include <cpu/trace.h>
+
+namespace Obelix::JV80::CPU {
+
+/*
+ * Trace files hold every CycleRecord of a run. The records are split into
+ * chunks of a fixed number of records, and every chunk can be decoded
+ * without looking at any other chunk.
+ *
+ * Layout, in host byte order:
+ *
+ *   TraceFileHeader
+ *   TraceChunkInfo, encoded records    (repeated for every chunk)
+ *   TraceChunkInfo[]                   (the index)
+ *   TraceFileFooter
+ *
+ * See TraceCodec for the encoding of the records.
+ */
+
+struct TraceFileHeader {
+    char magic[8] = { 'J', 'V', '8', '0', 'T', 'R', 'C', '1' };
+    uint32_t version = 2;
+    uint32_t chunkRecords = 0;
+};
+
+/**
+ * Describes one chunk. A copy precedes the chunk's records, so a file that
+ * was not closed properly can still be read, and all of them together form
+ * the index at the end of the file. Readers use the ranges to skip chunks
+ * which can't match a query.
+ */
+struct TraceChunkInfo {
+    uint64_t offset = 0; // File offset of the encoded records
+    uint64_t firstCycle = 0;
+    uint32_t size = 0; // Size of the encoded records in bytes
+    uint32_t count = 0;
+    uint16_t minPC = 0xFFFF;
+    uint16_t maxPC = 0;
+    uint16_t components = 0; // Bit set for every get and put ID
+    uint16_t reserved = 0;
+    uint8_t opcodes[32] = {}; // Bit set for every IR value
+
+    uint64_t lastCycle() const { return firstCycle + count - 1; }
+    bool hasOpcode(byte opcode) const { return opcodes[opcode >> 3] & (1 << (opcode & 0x07)); }
+};
+
+static_assert(sizeof(TraceChunkInfo) == 64);
+
+struct TraceFileFooter {
+    uint64_t indexOffset = 0;
+    uint32_t chunks = 0;
+    uint32_t padding = 0;
+    char magic[8] = { 'J', 'V', '8', '0', 'I', 'D', 'X', '1' };
+};
+
+/**
+ * Encodes and decodes the records of one chunk.
+ *
+ * Most of the bus state of a cycle is determined by the microcode step
+ * being executed, so every record is compared to the last record in the
+ * chunk with the same IR and step, or to the previous record if there is
+ * none. IR, step, PC, flags and the cycle number are predicted from the
+ * previous record instead.
+ *
+ * A record is encoded as a LEB128 mask with a bit for every field that
+ * doesn't match its prediction, followed by the values of those fields:
+ * IR, step, PC (two bytes), data bus, address bus, get and put ID (packed
+ * in one byte), opflags, flags, control lines, and the LEB128 number of
+ * skipped cycles. In the common case a record takes two or three bytes.
+ */
+class TraceCodec {
+public:
+    TraceCodec();
+
+    void start(uint64_t firstCycle);
+    void encode(const CycleRecord&, std::vector<byte>&);
+    bool decode(const byte*&, const byte*, CycleRecord&);
+
+private:
+    CycleRecord m_previous;
+    std::vector<CycleRecord> m_references;
+    std::vector<uint32_t> m_generations;
+    uint32_t m_generation = 0;
+
+    const CycleRecord& reference(const CycleRecord&) const;
+    void remember(const CycleRecord&);
+};
+
+class TraceWriter {
+public:
+    explicit TraceWriter(const std::string&, size_t = DEFAULT_CHUNK_RECORDS);
+    ~TraceWriter();
+
+    bool good() const { return m_file.good(); }
+    void record(const CycleRecord&);
+    void close();
+    unsigned long records() const { return m_records; }
+    unsigned long bytes() const { return m_bytes; }
+
+    constexpr static size_t DEFAULT_CHUNK_RECORDS = 4096;
+
+private:
+    std::ofstream m_file;
+    size_t m_chunkRecords;
+    std::vector<byte> m_buffer;
+    TraceChunkInfo m_chunk;
+    TraceCodec m_codec;
+    std::vector<TraceChunkInfo> m_index;
+    unsigned long m_records = 0;
+    unsigned long m_bytes = 0;
+
+    void flush();
+};
+
+/**
+ * Read-only view of a trace file. The file is mapped into memory and chunks
+ * are only decoded when asked for, all with the same TraceCodec, so a
+ * reader can only decode on one thread at a time.
+ */
+class TraceReader {
+public:
+    explicit TraceReader(const std::string&);
+
+    bool valid() const { return m_valid; }
+    const std::string& error() const { return m_error; }
+    const std::vector<TraceChunkInfo>& chunks() const { return m_chunks; }
+    unsigned long records() const;
+    bool decode(const TraceChunkInfo&, std::vector<CycleRecord>&);
+
+private:
+    MappedFile m_map;
+    TraceCodec m_codec;
+    bool m_valid = false;
+    std::string m_error;
+    std::vector<TraceChunkInfo> m_chunks;
+
+    bool readIndex();
+    bool scanChunks();
+};
+
+}
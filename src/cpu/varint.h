@@ -0,0 +1,49 @@
+/*
+ * Copyright (c) 2021, Jan de Visser <jan@finiandarcy.com>
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include <cpu/component.h>
+
+namespace Obelix::JV80::CPU {
+
+/*
+ * LEB128 encoding of unsigned numbers, as used in trace and input log
+ * files: seven bits per byte, least significant first, with the high bit
+ * set on all bytes but the last.
+ */
+
+inline void putVarint(std::vector<byte>& buf, uint64_t value)
+{
+    while (value >= 0x80) {
+        buf.push_back((byte)(value | 0x80));
+        value >>= 7;
+    }
+    buf.push_back((byte)value);
+}
+
+/**
+ * Decodes the number at <p>, and advances <p> past it.
+ *
+ * @return false if the number runs past <end> or doesn't fit in 64 bits.
+ */
+inline bool getVarint(const byte*& p, const byte* end, uint64_t& value)
+{
+    value = 0;
+    for (int shift = 0; (p < end) && (shift < 64); shift += 7) {
+        byte b = *p++;
+        value |= (uint64_t)(b & 0x7F) << shift;
+        if (!(b & 0x80)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+}
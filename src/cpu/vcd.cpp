@@ -0,0 +1,170 @@
+/*
+ * Copyright (c) 2021, Jan de Visser <jan@finiandarcy.com>
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include <cpu/vcd.h>
+
+namespace Obelix::JV80::CPU {
+
+namespace {
+
+struct SignalDefinition {
+    const char* id;
+    const char* name;
+    int width;
+};
+
+// Indexed by VcdWriter::Signal. Active-low lines have a leading underscore,
+// like in the SystemBus.
+const SignalDefinition signals[] = {
+    { "!", "clk", 1 },
+    { "\"", "io_clk", 1 },
+    { "#", "data_bus", 8 },
+    { "$", "addr_bus", 8 },
+    { "%", "get", 4 },
+    { "&", "put", 4 },
+    { "'", "op", 4 },
+    { "(", "flags", 3 },
+    { ")", "_xdata", 1 },
+    { "*", "_xaddr", 1 },
+    { "+", "_io", 1 },
+    { ",", "_halt", 1 },
+    { "-", "_sus", 1 },
+    { ".", "_nmi", 1 },
+};
+
+}
+
+VcdWriter::VcdWriter(std::ostream& os)
+    : m_os(os)
+{
+    m_buffer.reserve(BUFFER_SIZE + 256);
+    header();
+}
+
+VcdWriter::~VcdWriter()
+{
+    flush();
+}
+
+void VcdWriter::header()
+{
+    m_buffer += "$version JV80 emulator $end\n"
+                "$timescale 1ns $end\n"
+                "$scope module jv80 $end\n";
+    for (auto& s : signals) {
+        m_buffer += "$var wire ";
+        m_buffer += std::to_string(s.width);
+        m_buffer += ' ';
+        m_buffer += s.id;
+        m_buffer += ' ';
+        m_buffer += s.name;
+        if (s.width > 1) {
+            m_buffer += " [" + std::to_string(s.width - 1) + ":0]";
+        }
+        m_buffer += " $end\n";
+    }
+    m_buffer += "$upscope $end\n"
+                "$enddefinitions $end\n";
+}
+
+void VcdWriter::write(Signal signal, int value)
+{
+    auto& s = signals[signal];
+    if (s.width == 1) {
+        m_buffer += (value) ? '1' : '0';
+    } else {
+        m_buffer += 'b';
+        bool leading = true;
+        for (int bit = s.width - 1; bit >= 0; bit--) {
+            bool set = value & (1 << bit);
+            if (set || !leading || !bit) {
+                m_buffer += (set) ? '1' : '0';
+                leading = false;
+            }
+        }
+        m_buffer += ' ';
+    }
+    m_buffer += s.id;
+    m_buffer += '\n';
+    m_values[signal] = value;
+    m_changes++;
+}
+
+/**
+ * Records the state of the bus during one clock phase. <clock> is true for
+ * the rising edge and high phases, <ioClock> is true during IO cycles.
+ */
+void VcdWriter::sample(const SystemBus& bus, bool clock, bool ioClock)
+{
+    auto time = m_time++;
+    if (clock && !m_clock && !ioClock) {
+        m_cycle++;
+    }
+    m_clock = clock;
+    auto cycle = (m_cycle) ? m_cycle - 1 : 0;
+
+    if (!m_triggered) {
+        if (m_trigger && !m_trigger()) {
+            return;
+        }
+        m_triggered = true;
+        m_triggerCycle = cycle;
+    }
+    auto relative = cycle - m_triggerCycle;
+    if ((relative < m_from) || (relative > m_to)) {
+        return;
+    }
+
+    int values[SignalCount] = {
+        clock,
+        ioClock,
+        bus.readDataBus(),
+        bus.readAddrBus(),
+        bus.getID(),
+        bus.putID(),
+        bus.opflags(),
+        bus.flags(),
+        bus.xdata(),
+        bus.xaddr(),
+        bus.io(),
+        bus.halt(),
+        bus.sus(),
+        bus.nmi(),
+    };
+
+    if (!m_dumped) {
+        m_buffer += "#" + std::to_string(time) + "\n$dumpvars\n";
+        for (int ix = 0; ix < SignalCount; ix++) {
+            write((Signal)ix, values[ix]);
+        }
+        m_buffer += "$end\n";
+        m_dumped = true;
+    } else {
+        bool stamped = false;
+        for (int ix = 0; ix < SignalCount; ix++) {
+            if (values[ix] == m_values[ix]) {
+                continue;
+            }
+            if (!stamped) {
+                m_buffer += "#" + std::to_string(time) + "\n";
+                stamped = true;
+            }
+            write((Signal)ix, values[ix]);
+        }
+    }
+    if (m_buffer.size() >= BUFFER_SIZE) {
+        flush();
+    }
+}
+
+void VcdWriter::flush()
+{
+    m_os.write(m_buffer.data(), (std::streamsize)m_buffer.size());
+    m_os.flush();
+    m_buffer.clear();
+}
+
+}
@@ -0,0 +1,83 @@
+/*
+ * Copyright (c) 2021, Jan de Visser <jan@finiandarcy.com>
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#pragma once
+
+#include <functional>
+#include <ostream>
+#include <string>
+
+#include <cpu/systembus.h>
+
+namespace Obelix::JV80::CPU {
+
+/**
+ * Writes the signals of the SystemBus as a Value Change Dump, to be viewed
+ * in a waveform viewer like GTKWave.
+ *
+ * Once installed with BackPlane::dumpTo(), the BackPlane calls sample() for
+ * every clock phase. The FunctionalEngine doesn't. Every phase is one
+ * time unit, so a system cycle followed by an IO cycle takes 8 units. A
+ * signal is only written when its value changed. Output is collected in a
+ * buffer which is written to the stream when it fills up and by flush().
+ *
+ * Recording can be limited to a window of system cycles, counted from the
+ * first sample, and can be made to wait until a trigger condition holds.
+ * Once triggered, the window is counted from the triggering cycle.
+ */
+class VcdWriter {
+public:
+    explicit VcdWriter(std::ostream&);
+    ~VcdWriter();
+
+    void setWindow(unsigned long from, unsigned long to) { m_from = from; m_to = to; }
+    void setTrigger(std::function<bool()> trigger) { m_trigger = std::move(trigger); }
+    bool triggered() const { return m_triggered; }
+    unsigned long changes() const { return m_changes; }
+
+    void sample(const SystemBus&, bool clock, bool ioClock);
+    void flush();
+
+    constexpr static size_t BUFFER_SIZE = 64 * 1024;
+
+private:
+    enum Signal {
+        Clock,
+        IOClock,
+        DataBus,
+        AddrBus,
+        GetID,
+        PutID,
+        OpFlags,
+        Flags,
+        XData,
+        XAddr,
+        IO,
+        Halt,
+        Sus,
+        NMI,
+        SignalCount,
+    };
+
+    std::ostream& m_os;
+    std::string m_buffer;
+    unsigned long m_from = 0;
+    unsigned long m_to = ~0ul;
+    std::function<bool()> m_trigger;
+    bool m_triggered = false;
+    unsigned long m_triggerCycle = 0;
+    bool m_clock = false;
+    unsigned long m_cycle = 0;
+    unsigned long m_time = 0;
+    unsigned long m_changes = 0;
+    bool m_dumped = false;
+    int m_values[SignalCount] = {};
+
+    void header();
+    void write(Signal, int);
+};
+
+}
@@ -0,0 +1,152 @@
+/*
+ * Copyright (c) 2021, Jan de Visser <jan@finiandarcy.com>
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include <cpu/worker.h>
+
+namespace Obelix::JV80::CPU {
+
+Worker::Worker(BackPlane& system)
+    : m_system(system)
+    , m_commands(QUEUE_SIZE)
+    , m_replies(QUEUE_SIZE)
+{
+    m_thread = std::thread([this]() {
+        loop();
+    });
+}
+
+Worker::~Worker()
+{
+    pause();
+    while (!post(Quit)) {
+        Reply r;
+        reply(r);
+    }
+    m_thread.join();
+}
+
+/**
+ * Queues a command for the worker.
+ *
+ * @return false if the queue is full. Replies must be collected for the
+ * queue to drain.
+ */
+bool Worker::post(CommandType type, word address)
+{
+    if (m_pending.load(std::memory_order_acquire) >= (int)QUEUE_SIZE) {
+        return false;
+    }
+    if (!m_commands.push({ type, address })) {
+        return false;
+    }
+    m_pending.fetch_add(1, std::memory_order_acq_rel);
+    m_posted.fetch_add(1, std::memory_order_release);
+    m_posted.notify_one();
+    return true;
+}
+
+/**
+ * Makes a continuous run stop at the next instruction boundary. Unlike the
+ * other commands this takes effect immediately, because the worker is busy
+ * running the system. Run commands which are posted but not started yet
+ * stop after their first instruction.
+ */
+void Worker::pause()
+{
+    m_paused.store(m_posted.load());
+    m_system.setRunMode(SystemBus::BreakAtInstruction);
+}
+
+/**
+ * Takes the oldest reply from the worker.
+ *
+ * @return false if there is no reply.
+ */
+bool Worker::reply(Reply& r)
+{
+    if (!m_replies.pop(r)) {
+        return false;
+    }
+    m_pending.fetch_sub(1, std::memory_order_acq_rel);
+    return true;
+}
+
+void Worker::loop()
+{
+    while (true) {
+        auto seen = m_posted.load(std::memory_order_acquire);
+        Command cmd;
+        if (!m_commands.pop(cmd)) {
+            m_posted.wait(seen, std::memory_order_acquire);
+            continue;
+        }
+        if (cmd.type == Quit) {
+            return;
+        }
+        m_executed++;
+        execute(cmd);
+    }
+}
+
+void Worker::execute(const Command& cmd)
+{
+    Reply r;
+    r.command = cmd.type;
+    switch (cmd.type) {
+    case Reset:
+        m_system.reset();
+        break;
+    default:
+        if (m_system.bus().halt()) {
+            switch (cmd.type) {
+            case Run:
+            case Continue:
+                // Checked after setting the mode: a pause() racing with
+                // this is either seen here, or sets the mode after us.
+                m_system.setRunMode(SystemBus::Continuous);
+                if (m_paused.load() >= m_executed) {
+                    m_system.setRunMode(SystemBus::BreakAtInstruction);
+                }
+                break;
+            case Step:
+                m_system.setRunMode(SystemBus::BreakAtInstruction);
+                break;
+            default:
+                m_system.setRunMode(SystemBus::BreakAtClock);
+                break;
+            }
+            m_system.run((cmd.type == Run) ? cmd.address : 0xFFFF);
+            r.cycles = m_system.cycles();
+        }
+        break;
+    }
+
+    r.error = m_system.error();
+    r.halted = !m_system.bus().halt();
+    r.suspended = !m_system.bus().sus();
+    r.flags = m_system.bus().flags();
+    r.step = m_system.controller()->getStep();
+    for (int ix = GP_A; ix <= MEMADDR; ix++) {
+        if ((ix == MEM) || ((ix > TX) && (ix < MEMADDR))) {
+            continue;
+        }
+        word value = m_system.component(ix)->getValue();
+        if (value != m_registers[ix]) {
+            r.changed |= 1u << ix;
+            m_registers[ix] = value;
+        }
+        r.registers[ix] = value;
+    }
+
+    // post() never lets more commands be outstanding than fit in the reply
+    // queue, so this does not fail.
+    m_replies.push(r);
+    if (m_notifier) {
+        m_notifier();
+    }
+}
+
+}
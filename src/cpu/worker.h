@@ -0,0 +1,84 @@
+/*
+ * Copyright (c) 2021, Jan de Visser <jan@finiandarcy.com>
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#pragma once
+
+#include <atomic>
+#include <functional>
+#include <thread>
+
+#include <cpu/backplane.h>
+#include <cpu/ringbuffer.h>
+
+namespace Obelix::JV80::CPU {
+
+/**
+ * Long-lived thread running a BackPlane.
+ *
+ * Commands are posted to the worker through a lock-free queue, and the
+ * worker sleeps on an atomic while there is nothing to do, so a step costs
+ * a wake-up instead of a thread start. For every command the worker posts a
+ * Reply carrying the registers that changed since the previous reply.
+ *
+ * post(), pause() and reply() must all be called from the same thread. The
+ * system may only be accessed directly while the worker is idle.
+ */
+class Worker {
+public:
+    enum CommandType {
+        Run,
+        Continue,
+        Step,
+        Tick,
+        Reset,
+        Quit,
+    };
+
+    struct Command {
+        CommandType type = Continue;
+        word address = 0xFFFF;
+    };
+
+    struct Reply {
+        CommandType command = Continue;
+        SystemError error = NoError;
+        bool halted = false;
+        bool suspended = false;
+        unsigned long cycles = 0;
+        unsigned int changed = 0;
+        word registers[16] = {};
+        byte flags = 0;
+        int step = 0;
+    };
+
+    explicit Worker(BackPlane&);
+    ~Worker();
+
+    bool post(CommandType, word = 0xFFFF);
+    void pause();
+    bool reply(Reply&);
+    bool busy() const { return m_pending.load(std::memory_order_acquire) > 0; }
+    void setNotifier(std::function<void()> notifier) { m_notifier = std::move(notifier); }
+
+    constexpr static size_t QUEUE_SIZE = 64;
+
+private:
+    BackPlane& m_system;
+    RingBuffer<Command> m_commands;
+    RingBuffer<Reply> m_replies;
+    std::atomic<unsigned long> m_posted = 0;
+    std::atomic<unsigned long> m_paused = 0;
+    unsigned long m_executed = 0;
+    std::atomic<int> m_pending = 0;
+    std::function<void()> m_notifier;
+    word m_registers[16] = {};
+    std::thread m_thread;
+
+    void loop();
+    void execute(const Command&);
+};
+
+}
@@ -0,0 +1,92 @@
+/*
+ * Copyright (c) 2021, Jan de Visser <jan@finiandarcy.com>
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+#include <cpu/farm.h>
+
+using namespace Obelix::JV80::CPU;
+
+namespace {
+
+void usage(const char* prog)
+{
+    std::cerr << "Usage: " << prog << " [options] <manifest>" << std::endl
+              << "  --threads <n>    Run on <n> threads. Default one per core" << std::endl
+              << "  --csv <file>     Write the results to <file>" << std::endl;
+}
+
+}
+
+int main(int argc, char** argv)
+{
+    unsigned threads = 0;
+    const char* csv = nullptr;
+    const char* path = nullptr;
+
+    for (int ix = 1; ix < argc; ix++) {
+        bool ok = true;
+        if (!strcmp(argv[ix], "--threads") && (ix < argc - 1)) {
+            char* end;
+            threads = strtoul(argv[++ix], &end, 0);
+            ok = !*end && threads;
+        } else if (!strcmp(argv[ix], "--csv") && (ix < argc - 1)) {
+            csv = argv[++ix];
+        } else if ((argv[ix][0] != '-') && !path) {
+            path = argv[ix];
+        } else {
+            ok = false;
+        }
+        if (!ok) {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+    if (!path) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    std::vector<FarmJob> jobs;
+    std::string error;
+    if (!loadManifest(path, jobs, error)) {
+        std::cerr << error << std::endl;
+        return 1;
+    }
+
+    Farm farm(threads);
+    auto start = std::chrono::steady_clock::now();
+    auto results = farm.run(jobs);
+    std::chrono::duration<double> wall = std::chrono::steady_clock::now() - start;
+
+    unsigned long cycles = 0;
+    int failed = 0;
+    for (auto& r : results) {
+        printf("%-20s %-11s PC %04x A %02x cycles %10lu instructions %10lu output %zu bytes %s\n",
+            r.name.c_str(), r.exitName(), r.registers[PC], r.registers[GP_A], r.cycles, r.instructions,
+            r.output.size(), r.message.c_str());
+        cycles += r.cycles;
+        failed += (r.exit == FarmResult::Failed) ? 1 : 0;
+    }
+    printf("%zu jobs, %d failed, on %u threads: %lu cycles in %.3f s, %.0f kHz\n",
+        results.size(), failed, std::min<unsigned>(farm.threads(), results.size()), cycles, wall.count(),
+        (wall.count() > 0.0) ? cycles / (1000.0 * wall.count()) : 0.0);
+
+    if (csv) {
+        std::ofstream os(csv);
+        writeResultsCSV(os, results);
+        if (!os) {
+            std::cerr << "Could not write " << csv << std::endl;
+            return 1;
+        }
+    }
+    return (failed) ? 1 : 0;
+}
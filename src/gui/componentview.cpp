@@ -14,7 +14,6 @@ ComponentView::ComponentView(ConnectedComponent* comp, int width, QWidget* owner
     : StyledWidget(owner)
 {
     component = comp;
-    component->setListener(this);
     layout = new QHBoxLayout;
     setLayout(layout);
     name = new ImpactLabel(component->name().c_str());
@@ -30,11 +29,26 @@ ComponentView::ComponentView(ConnectedComponent* comp, int width, QWidget* owner
 
 void ComponentView::componentEvent(Component const* sender, int ev)
 {
-    if ((ev == Component::EV_VALUECHANGED) && (component->bus()->runMode() != SystemBus::Continuous)) {
+    if (ev == Component::EV_VALUECHANGED) {
         emit valueChanged();
     }
 }
 
+/**
+ * Stops the value change events of the component. Used while the CPU runs
+ * continuously, when the view is not updated anyway.
+ */
+void ComponentView::mute()
+{
+    component->setEventMask(quietEvents);
+}
+
+void ComponentView::unmute()
+{
+    component->setEventMask(events);
+    emit valueChanged();
+}
+
 void ComponentView::refresh()
 {
     if (updater) {
@@ -44,6 +58,15 @@ void ComponentView::refresh()
     }
 }
 
+/**
+ * Shows the value of the component in <state> instead of reading the
+ * component itself, which is not safe while the CPU runs.
+ */
+void ComponentView::display(const MachineState& state)
+{
+    value->setValue(state.registers[component->id()]);
+}
+
 // -----------------------------------------------------------------------
 
 InstructionRegisterView::InstructionRegisterView(Controller* reg, QWidget* parent)
@@ -52,6 +75,7 @@ InstructionRegisterView::InstructionRegisterView(Controller* reg, QWidget* paren
     step = new DSegLabel("0", 1);
     layout->addWidget(step, 0, Qt::AlignRight);
     value->erase();
+    events |= Component::eventBit(Controller::EV_STEPCHANGED);
 
     updater = [this]() {
         step->setValue(controller()->getStep());
@@ -61,9 +85,15 @@ InstructionRegisterView::InstructionRegisterView(Controller* reg, QWidget* paren
     connect(this, &InstructionRegisterView::stepChanged, this, &InstructionRegisterView::refresh);
 }
 
+void InstructionRegisterView::display(const MachineState& state)
+{
+    step->setValue(state.step);
+    value->setValue(QString("%1").arg((state.instruction) ? state.instruction : "----", 10, QLatin1Char(' ')));
+}
+
 void InstructionRegisterView::componentEvent(Component const* sender, int ev)
 {
-    if ((ev == Controller::EV_STEPCHANGED) && (component->bus()->runMode() != SystemBus::Continuous)) {
+    if (ev == Controller::EV_STEPCHANGED) {
         emit stepChanged();
     } else {
         ComponentView::componentEvent(sender, ev);
@@ -77,6 +107,8 @@ MemoryView::MemoryView(Memory* reg, QWidget* parent)
     contents = new DSegLabel("", 2);
     contents->setValue((*reg)[reg->getValue()]);
     layout->addWidget(contents, 0, Qt::AlignRight);
+    quietEvents = Component::eventBit(Memory::EV_IMAGELOADED) | Component::eventBit(Memory::EV_CONFIGCHANGED);
+    events |= quietEvents | Component::eventBit(Memory::EV_CONTENTSCHANGED);
 
     updater = [this]() {
         value->setValue(component->getValue());
@@ -92,9 +124,7 @@ void MemoryView::componentEvent(Component const* sender, int ev)
         emit imageLoaded();
         // Fall through
     case Memory::EV_CONTENTSCHANGED:
-        if (component->bus()->runMode() != SystemBus::Continuous) {
-            emit contentsChanged();
-        }
+        emit contentsChanged();
         break;
     case Memory::EV_CONFIGCHANGED:
         emit configurationChanged();
@@ -105,6 +135,18 @@ void MemoryView::componentEvent(Component const* sender, int ev)
     }
 }
 
+void MemoryView::display(const MachineState& state)
+{
+    value->setValue(state.registers[MEMADDR]);
+    contents->setValue(state.registers[MEM]);
+}
+
+void MemoryView::unmute()
+{
+    ComponentView::unmute();
+    emit contentsChanged();
+}
+
 // -----------------------------------------------------------------------
 
 }
@@ -18,6 +18,7 @@
 #include <cpu/controller.h>
 #include <cpu/memory.h>
 #include <cpu/register.h>
+#include <cpu/snapshot.h>
 
 #define LED_SIZE 16
 
@@ -189,7 +190,7 @@ public:
 typedef std::function<void()> ValueUpdater;
 
 class ComponentView : public StyledWidget
-    , ComponentListener {
+    , public ComponentListener {
     Q_OBJECT
 
 signals:
@@ -197,6 +198,11 @@ signals:
 
 public:
     void componentEvent(Component const* sender, int ev) override;
+    ConnectedComponent* viewed() const { return component; }
+    unsigned int subscribedEvents() const { return events; }
+    void mute();
+    virtual void unmute();
+    virtual void display(const MachineState&);
 
 protected:
     ConnectedComponent* component;
@@ -204,6 +210,8 @@ protected:
     DSegLabel* value;
     QHBoxLayout* layout;
     ValueUpdater updater = nullptr;
+    unsigned int events = Component::eventBit(Component::EV_VALUECHANGED);
+    unsigned int quietEvents = 0;
 
     explicit ComponentView(ConnectedComponent*, int = 4, QWidget* = nullptr);
 
@@ -240,6 +248,7 @@ signals:
 public:
     explicit InstructionRegisterView(Controller* reg, QWidget* parent = nullptr);
     void componentEvent(Component const*, int) override;
+    void display(const MachineState&) override;
 
 private:
     DSegLabel* step;
@@ -262,6 +271,8 @@ signals:
 public:
     explicit MemoryView(Memory* reg, QWidget* parent = nullptr);
     void componentEvent(Component const*, int) override;
+    void unmute() override;
+    void display(const MachineState&) override;
 
 protected:
     Memory* memory() const
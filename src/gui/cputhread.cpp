@@ -16,14 +16,14 @@ namespace Obelix::JV80::GUI {
 CPU::CPU(QObject* parent)
     : QObject(parent)
     , m_running(false)
-    , m_status()
     , m_pressedKeys()
     , m_queuedKeys()
     , m_kbdMutex()
 {
     m_system = new BackPlane();
     m_system->defaultSetup();
-    m_system->setOutputStream(m_status);
+    m_system->enableSnapshots();
+    m_system->enableTrace();
     m_keyboard = new IOChannel(0x00, "KEY", [this]() {
         byte ret = 0xFF;
         {
@@ -48,8 +48,10 @@ CPU::CPU(QObject* parent)
     m_system->insertIO(m_keyboard);
     m_system->insertIO(m_terminal);
 
-    m_thread = new Executor(m_system, this);
-    connect(m_thread, &QThread::finished, this, &CPU::finished);
+    m_worker = new Worker(*m_system);
+    m_worker->setNotifier([this]() {
+        QMetaObject::invokeMethod(this, &CPU::processReplies, Qt::QueuedConnection);
+    });
 
     QFile initial("./emu.bin");
     if (initial.exists()) {
@@ -57,62 +59,80 @@ CPU::CPU(QObject* parent)
     }
 }
 
+CPU::~CPU()
+{
+    delete m_worker;
+}
+
 void CPU::run(word addr)
 {
     reset();
-    m_thread->startAddress(addr);
-    continueExecution();
+    start(Worker::Run, SystemBus::Continuous, addr);
 }
 
 void CPU::continueExecution()
 {
-    start(SystemBus::Continuous);
+    start(Worker::Continue, SystemBus::Continuous);
 }
 
 void CPU::step(word addr)
 {
-    start(SystemBus::BreakAtInstruction);
+    start(Worker::Step, SystemBus::BreakAtInstruction);
 }
 
 void CPU::tick(word addr)
 {
-    start(SystemBus::BreakAtClock);
+    start(Worker::Tick, SystemBus::BreakAtClock);
 }
 
 void CPU::interrupt()
 {
     if (m_running) {
-        setRunMode(SystemBus::BreakAtInstruction);
+        m_worker->pause();
     }
 }
 
 void CPU::reset()
 {
     if (!m_running) {
-        m_system->reset();
+        m_worker->post(Worker::Reset);
     }
 }
 
-void CPU::start(SystemBus::RunMode runMode)
+void CPU::start(Worker::CommandType command, SystemBus::RunMode runMode, word addr)
 {
-    if (!m_running && m_system->bus().halt()) {
-        m_kbdMutex.lock();
-        m_pressedKeys.clear();
-        m_kbdMutex.unlock();
-        setRunMode(runMode);
-        emit executionStart();
-        m_thread->start();
-        m_running = true;
+    if (m_running) {
+        return;
     }
+    // A halted system only runs again after a reset. If the worker still has
+    // a reset queued the bus can't be inspected yet, and the worker itself
+    // skips the command if the system turns out to be halted.
+    if ((command != Worker::Run) && !m_worker->busy() && !m_system->bus().halt()) {
+        return;
+    }
+    m_kbdMutex.lock();
+    m_pressedKeys.clear();
+    m_kbdMutex.unlock();
+    setRunMode(runMode);
+    emit executionStart();
+    m_running = m_worker->post(command, addr);
 }
 
-void CPU::finished()
+void CPU::processReplies()
 {
-    m_running = false;
-    if (!m_system->bus().halt()) {
-        emit executionEnded(QString::fromStdString(m_status.str()));
-    } else {
-        emit executionInterrupted(QString::fromStdString(m_status.str()));
+    Worker::Reply reply;
+    while (m_worker->reply(reply)) {
+        if (reply.command == Worker::Reset) {
+            continue;
+        }
+        m_running = false;
+        auto status = QString::asprintf("%s at PC %04x after %lu cycles",
+            (reply.halted) ? "Halted" : "Stopped", reply.registers[PC], reply.cycles);
+        if (reply.halted) {
+            emit executionEnded(status);
+        } else {
+            emit executionInterrupted(status);
+        }
     }
 }
 
@@ -210,7 +230,14 @@ void CPU::keyPressed(QKeyEvent* key)
         if (k != -1) {
             std::lock_guard lg(m_kbdMutex);
             m_pressedKeys.emplace_back(k);
-            m_system->bus().setNmi();
+
+            // While recording, the NMI is raised by the input log at a
+            // cycle boundary. A replay takes its NMIs from the log.
+            if (auto log = m_system->inputLog(); !log) {
+                m_system->bus().setNmi();
+            } else if (!log->replaying()) {
+                log->nmi();
+            }
         }
     }
 }
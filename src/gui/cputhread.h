@@ -14,40 +14,22 @@
 #include <QThread>
 
 #include <cpu/backplane.h>
+#include <cpu/eventqueue.h>
 #include <cpu/iochannel.h>
+#include <cpu/worker.h>
 
 namespace Obelix::JV80::GUI {
 
 using namespace Obelix::JV80::CPU;
 
-class Executor : public QThread {
-    Q_OBJECT
-    BackPlane* m_system;
-    word m_address;
-
-public:
-    explicit Executor(BackPlane* system, QObject* parent = nullptr)
-        : QThread(parent)
-        , m_system(system)
-        , m_address(0xFFFF)
-    {
-    }
-    void startAddress(word address) { m_address = address; }
-
-protected:
-    void run() override
-    {
-        m_system->run(m_address);
-    }
-};
-
 class CPU : public QObject {
     Q_OBJECT
 
 public:
     explicit CPU(QObject* = nullptr);
-    ~CPU() override = default;
+    ~CPU() override;
     BackPlane* getSystem() { return m_system; }
+    EventQueue& events() { return m_events; }
     void setRunMode(SystemBus::RunMode) const;
     void openImage(const QString&, word addr = 0, bool writable = true);
     void openImage(QFile&, word addr = 0, bool writable = true);
@@ -73,20 +55,20 @@ signals:
     void terminalWrite(int);
 
 private:
-    Executor* m_thread;
+    Worker* m_worker;
     BackPlane* m_system;
     IOChannel* m_keyboard;
     IOChannel* m_terminal;
+    EventQueue m_events;
     bool m_running;
-    std::stringstream m_status {};
     std::list<int> m_pressedKeys;
     std::list<int> m_queuedKeys;
     std::mutex m_kbdMutex;
 
-    void start(SystemBus::RunMode);
+    void start(Worker::CommandType, SystemBus::RunMode, word = 0xFFFF);
 
 private slots:
-    void finished();
+    void processReplies();
 };
 
 }
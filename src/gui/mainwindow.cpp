@@ -5,6 +5,11 @@
  * SPDX-License-Identifier: GPL-3.0-or-later
  */
 
+#include <algorithm>
+#include <fstream>
+#include <numeric>
+#include <sstream>
+
 #include <QDialog>
 #include <QFileDialog>
 #include <QGridLayout>
@@ -14,11 +19,18 @@
 #include <QTabWidget>
 
 #include <cpu/addressregister.h>
+#include <cpu/callstack.h>
 #include <cpu/controller.h>
+#include <cpu/counters.h>
+#include <cpu/coverage.h>
+#include <cpu/history.h>
+#include <cpu/inputlog.h>
 #include <cpu/memory.h>
+#include <cpu/profiler.h>
 #include <cpu/register.h>
 #include <cpu/registers.h>
 #include <cpu/systembus.h>
+#include <cpu/trace.h>
 
 #include <gui/componentview.h>
 #include <gui/mainwindow.h>
@@ -32,6 +44,7 @@ MainWindow::MainWindow(QWidget* parent)
 {
     createMenu();
     m_cpu = new CPU(this);
+    connect(m_cpu, &CPU::executionStart, this, &MainWindow::cpuStarted);
     connect(m_cpu, &CPU::executionEnded, this, &MainWindow::cpuStopped);
     connect(m_cpu, &CPU::executionInterrupted, this, &MainWindow::cpuStopped);
     setStyleSheet("MainWindow { background-color: black; }");
@@ -61,28 +74,44 @@ MainWindow::MainWindow(QWidget* parent)
     connect(this, &MainWindow::keyPressed, m_cpu, &CPU::keyPressed);
     windowLayout->addWidget(m_terminal);
 
-    auto busView = new SystemBusView(system->bus());
-    layout->addWidget(busView, 0, 0, 1, 2);
+    m_busView = new SystemBusView(system->bus());
+    layout->addWidget(m_busView, 0, 0, 1, 2);
     for (int r = 0; r < 4; r++) {
         auto reg = system->component(r);
         auto regView = new RegisterView(dynamic_cast<Register*>(reg), widget);
         layout->addWidget(regView, r / 2 + 1, r % 2);
+        m_views.append(regView);
     }
 
     auto reg = system->component(IR);
     auto regView = new InstructionRegisterView(dynamic_cast<Controller*>(reg), widget);
     layout->addWidget(regView, 3, 0);
+    m_views.append(regView);
 
     for (int r = 0; r < 4; r++) {
         auto addr_reg = system->component(8 + r);
         auto addr_regView = new AddressRegisterView(dynamic_cast<AddressRegister*>(addr_reg), widget);
         layout->addWidget(addr_regView, r / 2 + 4, r % 2);
+        m_views.append(addr_regView);
     }
 
     int row = 6;
     auto mem = system->component(MEMADDR);
     auto memView = new MemoryView(dynamic_cast<Memory*>(mem), widget);
     layout->addWidget(memView, row++, 0);
+    m_views.append(memView);
+
+    // The components post their events to the CPU's event queue. The queue
+    // is drained on a frame timer, so the views are updated at most once per
+    // frame no matter how fast the CPU runs.
+    auto& events = m_cpu->events();
+    events.attach(&system->bus(), m_busView, Component::eventBit(Component::EV_VALUECHANGED));
+    for (auto view : m_views) {
+        events.attach(view->viewed(), view, view->subscribedEvents());
+    }
+    m_frameTimer = new QTimer(this);
+    connect(m_frameTimer, &QTimer::timeout, this, &MainWindow::drainEvents);
+    m_frameTimer->start(FRAME_INTERVAL);
     connect(memView, &ComponentView::valueChanged, m_memdump, &MemDump::focus);
     connect(memView, &MemoryView::imageLoaded, m_memdump, &MemDump::reload);
     connect(memView, &MemoryView::contentsChanged, m_memdump, &MemDump::reload);
@@ -148,14 +177,56 @@ void MainWindow::openFile()
     }
 }
 
+void MainWindow::cpuStarted()
+{
+    // The views are not updated while the CPU runs continuously, so don't
+    // have the components send value change events. The views are brought
+    // up to date when the CPU stops.
+    if (m_cpu->getSystem()->runMode() == SystemBus::Continuous) {
+        m_busView->mute();
+        for (auto view : m_views) {
+            view->mute();
+        }
+        m_muted = true;
+    }
+}
+
+void MainWindow::drainEvents()
+{
+    m_cpu->events().drain();
+    if (m_muted) {
+        if (auto state = m_cpu->getSystem()->snapshot(); state) {
+            m_busView->display(*state);
+            for (auto view : m_views) {
+                view->display(*state);
+            }
+        }
+    }
+}
+
 void MainWindow::cpuStopped(const QString& status)
 {
+    drainEvents();
+    if (m_muted) {
+        m_busView->unmute();
+        for (auto view : m_views) {
+            view->unmute();
+        }
+        m_muted = false;
+    }
     auto t = m_status->toPlainText();
     if (!t.isEmpty()) {
         t += "\n";
     }
     t += status;
     m_status->setPlainText(t);
+
+    auto system = m_cpu->getSystem();
+    if (system->callStack() && (system->atBreakpoint() || (system->error() != NoError))) {
+        std::stringstream ss;
+        system->callStack()->backtrace(ss, system->component(PC)->getValue(), &m_symbols);
+        m_status->append(QString::fromStdString(ss.str()));
+    }
 }
 
 CommandLineEdit* MainWindow::makeCommandLine()
@@ -270,7 +341,9 @@ CommandLineEdit* MainWindow::makeCommandLine()
             double speed;
             switch (cmd.numArgs()) {
             case 0:
-                cmd.setResult(QString("%1 kHz").arg(m_cpu->getSystem()->clockSpeed()));
+                cmd.setResult(QString("%1 kHz (achieved %2 kHz)")
+                                  .arg(m_cpu->getSystem()->clockSpeed())
+                                  .arg(m_cpu->getSystem()->achievedFrequency(), 0, 'f', 1));
                 break;
             case 1:
                 speed = cmd.arg(0).toDouble(&ok);
@@ -285,6 +358,20 @@ CommandLineEdit* MainWindow::makeCommandLine()
             }
         });
 
+    ret->addCommandDefinition(ret, "engine", 0, 1,
+        [this](Command& cmd) {
+            auto system = m_cpu->getSystem();
+            if (cmd.numArgs() == 0) {
+                cmd.setResult((system->engine() == BackPlane::Functional) ? "functional" : "cycle");
+            } else if (cmd.arg(0) == "functional") {
+                system->setEngine(BackPlane::Functional);
+            } else if (cmd.arg(0) == "cycle") {
+                system->setEngine(BackPlane::CycleAccurate);
+            } else {
+                cmd.setError(QString("Unknown engine '%1'. Use 'cycle' or 'functional'").arg(cmd.arg(0)));
+            }
+        });
+
     ret->addCommandDefinition(
         ret, "load", 1, 3,
         [this](Command& cmd) {
@@ -370,7 +457,467 @@ CommandLineEdit* MainWindow::makeCommandLine()
             }
         });
 
-    ret->addCommandDefinition(ret, "bank", 2, 4,
+    ret->addCommandDefinition(ret, "trace", 0, 1,
+        [this](Command& cmd) {
+            auto system = m_cpu->getSystem();
+            if (m_cpu->isRunning()) {
+                cmd.setError("CPU running");
+                return;
+            }
+            if (!system->trace()) {
+                cmd.setError("Tracing disabled");
+                return;
+            }
+            size_t count = 32;
+            if (cmd.numArgs() == 1) {
+                bool ok;
+                count = cmd.arg(0).toUInt(&ok, 0);
+                if (!ok) {
+                    cmd.setError(QString("Syntax error: unparsable count '%1").arg(cmd.arg(0)));
+                    return;
+                }
+            }
+            std::stringstream ss;
+            system->trace()->render(ss, system->controller()->microCode(), count);
+            m_status->append(QString::fromStdString(ss.str()));
+            cmd.setResult(QString("%1 of %2 cycles").arg(std::min(count, system->trace()->size())).arg(system->trace()->total()));
+        });
+
+    ret->addCommandDefinition(ret, "counters", 0, 2,
+        [this](Command& cmd) {
+            auto system = m_cpu->getSystem();
+            if (m_cpu->isRunning()) {
+                cmd.setError("CPU running");
+                return;
+            }
+            auto sub = (cmd.numArgs() > 0) ? cmd.arg(0) : QString();
+            if (sub == "on") {
+                system->enableCounters();
+                return;
+            }
+            if (sub == "off") {
+                system->disableCounters();
+                return;
+            }
+            auto counters = system->counters();
+            if (!counters) {
+                cmd.setError("Counters disabled. Use 'counters on'");
+                return;
+            }
+            if (sub == "clear") {
+                counters->clear();
+            } else if (((sub == "save") || (sub == "steps")) && (cmd.numArgs() == 2)) {
+                std::ofstream file(cmd.arg(1).toStdString());
+                if (!file.good()) {
+                    cmd.setError(QString("Could not open '%1'").arg(cmd.arg(1)));
+                    return;
+                }
+                if (sub == "steps") {
+                    counters->writeStepsCSV(file);
+                } else if (cmd.arg(1).endsWith(".json")) {
+                    counters->writeJSON(file);
+                } else {
+                    counters->writeCSV(file);
+                }
+            } else if (cmd.numArgs() == 0) {
+                std::vector<int> opcodes(MicroCodeTable::NMI + 1);
+                std::iota(opcodes.begin(), opcodes.end(), 0);
+                std::sort(opcodes.begin(), opcodes.end(), [counters](int a, int b) {
+                    return counters->cycles[a] > counters->cycles[b];
+                });
+                QString t = "OPCODE INSTRUCTION          EXECUTIONS       CYCLES";
+                for (int ix = 0; (ix < 10) && counters->executions[opcodes[ix]]; ix++) {
+                    auto opcode = opcodes[ix];
+                    auto mc = counters->table.entry(opcode, true).microCode;
+                    t += QString::asprintf("\n  %02x   %-20.20s %10lu %12lu", opcode, (mc) ? mc->instruction : "",
+                        counters->executions[opcode], counters->cycles[opcode]);
+                }
+                m_status->append(t);
+            } else {
+                cmd.setError("Syntax error: use 'counters [on|off|clear|save <file>|steps <file>]'");
+            }
+        });
+
+    ret->addCommandDefinition(ret, "profile", 0, 3,
+        [this](Command& cmd) {
+            auto system = m_cpu->getSystem();
+            if (m_cpu->isRunning()) {
+                cmd.setError("CPU running");
+                return;
+            }
+            auto sub = (cmd.numArgs() > 0) ? cmd.arg(0) : QString();
+            if (sub == "on") {
+                auto mode = Profiler::Cycles;
+                auto interval = Profiler::DEFAULT_INTERVAL;
+                if (cmd.numArgs() > 1) {
+                    if (cmd.arg(1) == "instructions") {
+                        mode = Profiler::Instructions;
+                        interval = 1;
+                    } else if (cmd.arg(1) != "cycles") {
+                        cmd.setError("Syntax error: use 'profile on [cycles|instructions] [interval]'");
+                        return;
+                    }
+                }
+                if (cmd.numArgs() > 2) {
+                    bool ok;
+                    interval = cmd.arg(2).toULong(&ok, 0);
+                    if (!ok || !interval) {
+                        cmd.setError(QString("Syntax error: unparsable interval '%1").arg(cmd.arg(2)));
+                        return;
+                    }
+                }
+                m_profiler = std::make_unique<Profiler>(mode, interval);
+                system->profileTo(m_profiler.get());
+                return;
+            }
+            if (sub == "off") {
+                system->profileTo(nullptr);
+                m_profiler.reset();
+                return;
+            }
+            if ((sub == "symbols") && (cmd.numArgs() == 2)) {
+                m_symbols.clear();
+                if (!m_symbols.load(cmd.arg(1).toStdString())) {
+                    cmd.setError(QString("Could not read symbols from '%1'").arg(cmd.arg(1)));
+                    return;
+                }
+                cmd.setResult(QString("%1 symbols").arg(m_symbols.size()));
+                return;
+            }
+            if (!m_profiler) {
+                cmd.setError("Profiler disabled. Use 'profile on'");
+                return;
+            }
+            std::stringstream ss;
+            if (sub == "clear") {
+                m_profiler->clear();
+                return;
+            } else if (sub == "hot") {
+                m_profiler->hotRanges(ss, &m_symbols);
+            } else if (cmd.numArgs() == 0) {
+                m_profiler->flatProfile(ss, &m_symbols, 10);
+            } else {
+                cmd.setError("Syntax error: use 'profile [on [cycles|instructions] [interval]|off|clear|hot|symbols <file>]'");
+                return;
+            }
+            m_status->append(QString::fromStdString(ss.str()));
+        });
+
+    ret->addCommandDefinition(ret, "break", 0, 2,
+        [this](Command& cmd) {
+            auto system = m_cpu->getSystem();
+            if (m_cpu->isRunning()) {
+                cmd.setError("CPU running");
+                return;
+            }
+            auto& breakpoints = system->breakpoints();
+            if (cmd.numArgs() == 0) {
+                QString t = "Breakpoints:";
+                for (auto addr : breakpoints.list()) {
+                    t += QString::asprintf("\n  %04x %s", addr, m_symbols.format(addr).c_str());
+                }
+                m_status->append(t);
+                return;
+            }
+            bool clear = cmd.arg(0) == "clear";
+            if (clear && (cmd.numArgs() == 1)) {
+                breakpoints.clear();
+                return;
+            }
+            if (!clear && (cmd.numArgs() != 1)) {
+                cmd.setError("Syntax error: use 'break [<address>|clear [<address>]]'");
+                return;
+            }
+            bool ok;
+            auto addr = (word)cmd.arg(cmd.numArgs() - 1).toUShort(&ok, 0);
+            if (!ok) {
+                cmd.setError(QString("Syntax error: unparsable address '%1").arg(cmd.arg(cmd.numArgs() - 1)));
+                return;
+            }
+            if (clear) {
+                breakpoints.clear(addr);
+            } else {
+                breakpoints.set(addr);
+                system->enableCallStack();
+            }
+        });
+
+    ret->addCommandDefinition(ret, "bt", 0, 0,
+        [this](Command& cmd) {
+            auto system = m_cpu->getSystem();
+            if (m_cpu->isRunning()) {
+                cmd.setError("CPU running");
+                return;
+            }
+            if (!system->callStack()) {
+                cmd.setError("Call tracking disabled. Use 'calls on'");
+                return;
+            }
+            std::stringstream ss;
+            system->callStack()->backtrace(ss, system->component(PC)->getValue(), &m_symbols);
+            m_status->append(QString::fromStdString(ss.str()));
+        });
+
+    ret->addCommandDefinition(ret, "calls", 0, 1,
+        [this](Command& cmd) {
+            auto system = m_cpu->getSystem();
+            if (m_cpu->isRunning()) {
+                cmd.setError("CPU running");
+                return;
+            }
+            auto sub = (cmd.numArgs() > 0) ? cmd.arg(0) : QString();
+            if (sub == "on") {
+                system->enableCallStack();
+                return;
+            }
+            if (sub == "off") {
+                system->disableCallStack();
+                return;
+            }
+            auto callStack = system->callStack();
+            if (!callStack) {
+                cmd.setError("Call tracking disabled. Use 'calls on'");
+                return;
+            }
+            if (sub == "clear") {
+                callStack->clear();
+            } else if (cmd.numArgs() == 0) {
+                std::stringstream ss;
+                callStack->writeProfile(ss, &m_symbols, 10);
+                m_status->append(QString::fromStdString(ss.str()));
+            } else {
+                cmd.setError("Syntax error: use 'calls [on|off|clear]'");
+            }
+        });
+
+    ret->addCommandDefinition(ret, "coverage", 0, 3,
+        [this](Command& cmd) {
+            auto system = m_cpu->getSystem();
+            if (m_cpu->isRunning()) {
+                cmd.setError("CPU running");
+                return;
+            }
+            auto sub = (cmd.numArgs() > 0) ? cmd.arg(0) : QString();
+            if (sub == "on") {
+                system->enableCoverage();
+                return;
+            }
+            if (sub == "off") {
+                system->disableCoverage();
+                return;
+            }
+            auto coverage = system->coverage();
+            if (!coverage) {
+                cmd.setError("Coverage disabled. Use 'coverage on'");
+                return;
+            }
+            if (sub == "clear") {
+                coverage->clear();
+            } else if ((sub == "save") && (cmd.numArgs() >= 2)) {
+                SourceMap sourceMap;
+                if ((cmd.numArgs() == 3) && !sourceMap.load(cmd.arg(2).toStdString())) {
+                    cmd.setError(QString("Could not read source map '%1'").arg(cmd.arg(2)));
+                    return;
+                }
+                std::ofstream file(cmd.arg(1).toStdString());
+                if (!file.good()) {
+                    cmd.setError(QString("Could not open '%1'").arg(cmd.arg(1)));
+                    return;
+                }
+                if (sourceMap.empty()) {
+                    coverage->writeRanges(file);
+                } else {
+                    coverage->writeLcov(file, sourceMap);
+                }
+            } else if (cmd.numArgs() == 0) {
+                cmd.setResult(QString("%1 bytes executed, %2 branches taken, %3 not taken")
+                                  .arg(coverage->executed.count())
+                                  .arg(coverage->taken.count())
+                                  .arg(coverage->notTaken.count()));
+            } else {
+                cmd.setError("Syntax error: use 'coverage [on|off|clear|save <file> [<source map>]]'");
+            }
+        });
+
+    ret->addCommandDefinition(ret, "save", 1, 1,
+        [this](Command& cmd) {
+            if (m_cpu->isRunning()) {
+                cmd.setError("CPU running");
+                return;
+            }
+            if (!m_cpu->getSystem()->saveState(cmd.arg(0).toStdString())) {
+                cmd.setError(QString("Could not save state to '%1'").arg(cmd.arg(0)));
+            }
+        });
+
+    ret->addCommandDefinition(ret, "restore", 1, 1,
+        [this](Command& cmd) {
+            if (m_cpu->isRunning()) {
+                cmd.setError("CPU running");
+                return;
+            }
+            if (!m_cpu->getSystem()->loadState(cmd.arg(0).toStdString())) {
+                cmd.setError(QString("Could not restore state from '%1'").arg(cmd.arg(0)));
+            }
+        });
+
+    ret->addCommandDefinition(ret, "history", 0, 1,
+        [this](Command& cmd) {
+            auto system = m_cpu->getSystem();
+            if (m_cpu->isRunning()) {
+                cmd.setError("CPU running");
+                return;
+            }
+            auto sub = (cmd.numArgs() > 0) ? cmd.arg(0) : QString();
+            if (sub == "off") {
+                system->disableHistory();
+                return;
+            }
+            if (cmd.numArgs() == 0) {
+                auto history = system->history();
+                if (!history) {
+                    cmd.setError("History disabled. Use 'history on'");
+                    return;
+                }
+                cmd.setResult(QString("Instructions %1-%2, %3 checkpoints, %4 writes")
+                                  .arg(history->first())
+                                  .arg(history->position())
+                                  .arg(history->checkpoints())
+                                  .arg(history->writes()));
+                return;
+            }
+            auto interval = History::DEFAULT_INTERVAL;
+            if (sub != "on") {
+                bool ok;
+                interval = sub.toULong(&ok, 0);
+                if (!ok || !interval) {
+                    cmd.setError("Syntax error: use 'history [on|off|<checkpoint interval>]'");
+                    return;
+                }
+            }
+            system->disableHistory();
+            system->enableHistory(interval);
+        });
+
+    ret->addCommandDefinition(ret, "back", 0, 1,
+        [this](Command& cmd) {
+            auto system = m_cpu->getSystem();
+            if (m_cpu->isRunning()) {
+                cmd.setError("CPU running");
+                return;
+            }
+            if (!system->history()) {
+                cmd.setError("History disabled. Use 'history on'");
+                return;
+            }
+            unsigned long n = 1;
+            if (cmd.numArgs() > 0) {
+                bool ok;
+                n = cmd.arg(0).toULong(&ok, 0);
+                if (!ok || !n) {
+                    cmd.setError(QString("Syntax error: unparsable count '%1'").arg(cmd.arg(0)));
+                    return;
+                }
+            }
+            if (!system->stepBack(n)) {
+                cmd.setError("Reached the start of the history");
+            }
+        });
+
+    ret->addCommandDefinition(ret, "rcontinue", 0, 0,
+        [this](Command& cmd) {
+            auto system = m_cpu->getSystem();
+            if (m_cpu->isRunning()) {
+                cmd.setError("CPU running");
+                return;
+            }
+            if (!system->history()) {
+                cmd.setError("History disabled. Use 'history on'");
+                return;
+            }
+            if (!system->reverseContinue()) {
+                cmd.setResult("Reached the start of the history");
+            }
+        });
+
+    ret->addCommandDefinition(ret, "lastwrite", 1, 1,
+        [this](Command& cmd) {
+            auto system = m_cpu->getSystem();
+            if (m_cpu->isRunning()) {
+                cmd.setError("CPU running");
+                return;
+            }
+            auto history = system->history();
+            if (!history) {
+                cmd.setError("History disabled. Use 'history on'");
+                return;
+            }
+            bool ok;
+            auto addr = (word)cmd.arg(0).toUShort(&ok, 0);
+            if (!ok) {
+                cmd.setError(QString("Syntax error: unparsable address '%1").arg(cmd.arg(0)));
+                return;
+            }
+            unsigned long instruction;
+            if (!history->lastWrite(addr, instruction)) {
+                cmd.setResult(QString::asprintf("%04x not written in the history", addr));
+                return;
+            }
+            auto pc = history->record(instruction).pc;
+            cmd.setResult(QString::asprintf("%04x written by instruction %lu at %04x %s", addr, instruction, pc,
+                m_symbols.format(pc).c_str()));
+        });
+
+    ret->addCommandDefinition(ret, "record", 0, 2,
+        [this](Command& cmd) {
+            auto system = m_cpu->getSystem();
+            if (m_cpu->isRunning()) {
+                cmd.setError("CPU running");
+                return;
+            }
+            auto sub = (cmd.numArgs() > 0) ? cmd.arg(0) : QString();
+            if ((sub == "on") && (cmd.numArgs() == 1)) {
+                system->recordInput();
+                return;
+            }
+            if ((sub == "off") && (cmd.numArgs() == 1)) {
+                system->disableInputLog();
+                return;
+            }
+            auto log = system->inputLog();
+            if (!log) {
+                cmd.setError("Not recording. Use 'record on'");
+                return;
+            }
+            if ((sub == "save") && (cmd.numArgs() == 2)) {
+                if (!log->save(cmd.arg(1).toStdString())) {
+                    cmd.setError(QString("Could not save recording to '%1'").arg(cmd.arg(1)));
+                }
+            } else if (cmd.numArgs() == 0) {
+                cmd.setResult(QString("%1, %2 events in %3 cycles%4")
+                                  .arg((log->replaying()) ? "Replaying" : "Recording")
+                                  .arg(log->events().size())
+                                  .arg(log->cycle())
+                                  .arg((log->diverged()) ? ", diverged" : ""));
+            } else {
+                cmd.setError("Syntax error: use 'record [on|off|save <file>]'");
+            }
+        });
+
+    ret->addCommandDefinition(ret, "replay", 1, 1,
+        [this](Command& cmd) {
+            if (m_cpu->isRunning()) {
+                cmd.setError("CPU running");
+                return;
+            }
+            if (!m_cpu->getSystem()->replayInput(cmd.arg(0).toStdString())) {
+                cmd.setError(QString("Could not replay '%1'").arg(cmd.arg(0)));
+                return;
+            }
+            cmd.setResult("Recorded state restored. Use 'continue' to replay");
+        });
+
+    ret->addCommandDefinition(ret, "bank", 1, 4,
         [this](Command& cmd) {
             BankCommand(this, cmd).execute();
         });
@@ -444,6 +991,14 @@ void BankCommand::execute()
         add();
     } else if (lwr == "del") {
         del();
+    } else if (lwr == "profile") {
+        profile();
+    } else if (lwr == "usage") {
+        usage();
+    } else if (lwr == "heat") {
+        heat();
+    } else if (lwr == "stack") {
+        stack();
     } else {
         cmd.setError(QString("Syntax error: invalid subcommand '%1").arg(cmd.arg(0)));
     }
@@ -535,6 +1090,88 @@ void BankCommand::del()
     }
 }
 
+void BankCommand::profile()
+{
+    auto system = window->cpu()->getSystem();
+    auto lwr = (cmd.numArgs() == 2) ? cmd.arg(1).toLower() : QString();
+    if (lwr == "on") {
+        system->enableMemoryProfile();
+    } else if (lwr == "off") {
+        system->disableMemoryProfile();
+    } else if ((lwr == "clear") && system->memoryProfile()) {
+        system->memoryProfile()->clear();
+    } else {
+        cmd.setError("Syntax error: use 'bank profile on|off|clear'");
+    }
+}
+
+void BankCommand::usage()
+{
+    auto system = window->cpu()->getSystem();
+    if (!system->memoryProfile()) {
+        cmd.setError("Memory profile disabled. Use 'bank profile on'");
+        return;
+    }
+    if (cmd.numArgs() != 2) {
+        cmd.setError("Syntax error: The 'usage' subcommand requires exactly one parameter");
+        return;
+    }
+    auto addr = parseWord(1, "Syntax error: unparsable address '%1'");
+    if (!cmd.success()) {
+        return;
+    }
+    auto bank = system->memory()->bank(addr);
+    if (!bank.valid()) {
+        cmd.setError(QString("Error: No memory bank has address '%1'").arg(cmd.arg(1)));
+        return;
+    }
+    auto u = system->memoryProfile()->usage(bank.start(), bank.size());
+    if (!u.touched) {
+        cmd.setResult(QString::asprintf("Bank %04x-%04x not accessed", bank.start(), bank.end() - 1));
+        return;
+    }
+    cmd.setResult(QString::asprintf("Bank %04x-%04x: %lu reads, %lu writes, %lu of %d bytes used in %04x-%04x",
+        bank.start(), bank.end() - 1, u.reads, u.writes, u.touched, bank.size(), u.lowest, u.highest));
+}
+
+void BankCommand::heat()
+{
+    auto system = window->cpu()->getSystem();
+    if (!system->memoryProfile()) {
+        cmd.setError("Memory profile disabled. Use 'bank profile on'");
+        return;
+    }
+    std::stringstream ss;
+    system->memoryProfile()->writeHeatmap(ss);
+    window->log(QString::fromStdString(ss.str()));
+}
+
+void BankCommand::stack()
+{
+    auto system = window->cpu()->getSystem();
+    if (!system->memoryProfile()) {
+        cmd.setError("Memory profile disabled. Use 'bank profile on'");
+        return;
+    }
+    if (cmd.numArgs() == 3) {
+        auto start = parseWord(1, "Syntax error: unparsable address '%1'");
+        if (!cmd.success()) {
+            return;
+        }
+        auto size = parseWord(2, "Syntax error: unparsable size '%1'");
+        if (!cmd.success()) {
+            return;
+        }
+        system->memoryProfile()->setStack(start, size);
+    } else if (cmd.numArgs() != 1) {
+        cmd.setError("Syntax error: use 'bank stack [<start> <size>]'");
+        return;
+    }
+    std::stringstream ss;
+    system->memoryProfile()->writeStack(ss);
+    cmd.setResult(QString::fromStdString(ss.str()).trimmed());
+}
+
 }
 
 //#include "mainwindow.moc"
@@ -17,6 +17,7 @@
 #include <QStyleOption>
 #include <QTextEdit>
 #include <QThread>
+#include <QTimer>
 
 #include <cpu/backplane.h>
 
@@ -27,11 +28,16 @@
 
 namespace Obelix::JV80::GUI {
 
+class ComponentView;
+class SystemBusView;
+
 class MainWindow : public QMainWindow {
     Q_OBJECT
 
 private slots:
+    void cpuStarted();
     void cpuStopped(const QString&);
+    void drainEvents();
     void openFile();
 
 public:
@@ -40,6 +46,7 @@ public:
     QString query(const QString&, const QString&);
     void focusOnAddress(word addr) { m_memdump->focusOnAddress(addr); }
     MemoryBank& currentBank() { return m_memdump->currentBank(); }
+    void log(const QString& text) { m_status->append(text); }
 
 private:
     CPU* m_cpu = nullptr;
@@ -52,6 +59,14 @@ private:
     MemDump* m_memdump = nullptr;
     QTextEdit* m_status = nullptr;
     Terminal* m_terminal = nullptr;
+    SystemBusView* m_busView = nullptr;
+    QVector<ComponentView*> m_views;
+    bool m_muted = false;
+    QTimer* m_frameTimer = nullptr;
+    std::unique_ptr<Profiler> m_profiler;
+    SymbolTable m_symbols;
+
+    constexpr static int FRAME_INTERVAL = 33;
 
     CommandLineEdit* makeCommandLine();
 
@@ -76,6 +91,10 @@ struct BankCommand {
     void execute();
     void add();
     void del();
+    void profile();
+    void usage();
+    void heat();
+    void stack();
 
     word parseWord(int, QString&&);
 };
@@ -14,7 +14,6 @@ SystemBusView::SystemBusView(SystemBus& bus, QWidget* parent)
     : QWidget(parent)
     , systemBus(bus)
 {
-    systemBus.setListener(this);
     auto grid = new QHBoxLayout;
     layout = grid;
     setLayout(layout);
@@ -101,29 +100,53 @@ SystemBusView::SystemBusView(SystemBus& bus, QWidget* parent)
 
 void SystemBusView::componentEvent(Component const* sender, int ev)
 {
-    if ((ev == Component::EV_VALUECHANGED) && (systemBus.runMode() != SystemBus::Continuous)) {
+    if (ev == Component::EV_VALUECHANGED) {
         emit valueChanged();
     }
 }
 
+void SystemBusView::mute()
+{
+    systemBus.setEventMask(0);
+}
+
+void SystemBusView::unmute()
+{
+    systemBus.setEventMask(Component::eventBit(Component::EV_VALUECHANGED));
+    emit valueChanged();
+}
+
 void SystemBusView::refresh()
 {
-    data->setValue(systemBus.readDataBus());
-    address->setValue(systemBus.readAddrBus());
+    show(systemBus.readDataBus(), systemBus.readAddrBus(), systemBus.getID(), systemBus.putID(),
+        systemBus.xdata(), systemBus.xaddr(), systemBus.io(), systemBus.opflags(), systemBus.flags());
+}
+
+void SystemBusView::display(const MachineState& state)
+{
+    show(state.dataBus, state.addrBus, state.getID, state.putID,
+        state.xdata, state.xaddr, state.io, state.opflags, state.flags);
+}
+
+void SystemBusView::show(byte dataBus, byte addrBus, byte getID, byte putID,
+    bool xdataLine, bool xaddrLine, bool ioLine, byte opflags, byte flags)
+{
+    data->setValue(dataBus);
+    address->setValue(addrBus);
 
-    get->setRegister(systemBus.getID());
-    if (systemBus.io()) {
-        put->setRegister(systemBus.putID());
+    get->setRegister(getID);
+    if (ioLine) {
+        put->setRegister(putID);
     } else {
         put->clear();
     }
 
-    xdata->setValue(!(systemBus.xdata()));
-    xaddr->setValue(!(systemBus.xaddr()));
-    op->setValue(systemBus.opflags());
+    xdata->setValue(!xdataLine);
+    xaddr->setValue(!xaddrLine);
+    op->setValue(opflags);
 
-    auto sheet = [this](SystemBus::ProcessorFlags flag) {
-        return QString("QLabel { color: %1; }").arg((systemBus.flags() & flag) ? "red" : "lightgrey");
+    auto sheet = [flags](SystemBus::ProcessorFlags flag) {
+        return QString("QLabel { color: %1; }").arg((flags & flag) ? "red" : "lightgrey");
     };
 
     z->setStyleSheet(sheet(SystemBus::Z));
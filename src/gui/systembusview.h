@@ -25,10 +25,16 @@ signals:
 public:
     explicit SystemBusView(SystemBus& bus, QWidget* parent = nullptr);
     void componentEvent(Component const* sender, int ev) override;
+    void mute();
+    void unmute();
+    void display(const MachineState&);
 
 private slots:
     void refresh();
 
+private:
+    void show(byte, byte, byte, byte, bool, bool, bool, byte, byte);
+
 private:
     SystemBus& systemBus;
     QLayout* layout;
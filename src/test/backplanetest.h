@@ -0,0 +1,75 @@
+/*
+ * Copyright (c) 2021, Jan de Visser <jan@finiandarcy.com>
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#ifndef EMU_BACKPLANETEST_H
+#define EMU_BACKPLANETEST_H
+
+#include <cstddef>
+#include <gtest/gtest.h>
+
+#include "cpu/addressregister.h"
+#include "cpu/backplane.h"
+#include "cpu/opcodes.h"
+
+constexpr word PROGRAM_START = 0x1000;
+
+/*
+ * Fixture for tests running a program on a free running default machine.
+ * The program passed to the constructor is loaded at PROGRAM_START before
+ * every test; fixtures which need more than one program leave it out and
+ * call load() themselves.
+ */
+class BackPlaneTest : public ::testing::Test {
+protected:
+  BackPlane* system = nullptr;
+
+  BackPlaneTest() = default;
+
+  template<size_t N>
+  explicit BackPlaneTest(const byte (&program)[N])
+    : m_program(program)
+    , m_size(N) {
+  }
+
+  void SetUp() override {
+    system = new BackPlane();
+    system->defaultSetup();
+    system->setFreeRunning(true);
+    if (m_program) {
+      load(*system, m_program, m_size);
+    }
+  }
+
+  void TearDown() override {
+    delete system;
+  }
+
+  static void load(BackPlane& s, const byte* program, size_t size, word addr = PROGRAM_START) {
+    auto mem = s.memory();
+    for (word ix = 0; ix < size; ix++) {
+      (*mem)[addr + ix] = program[ix];
+    }
+  }
+
+  template<size_t N>
+  void load(const byte (&program)[N], word addr = PROGRAM_START) {
+    load(*system, program, N, addr);
+  }
+
+  static void setPC(BackPlane& s, word pc) {
+    dynamic_cast<AddressRegister*>(s.component(PC))->setValue(pc);
+  }
+
+  void setPC(word pc) {
+    setPC(*system, pc);
+  }
+
+private:
+  const byte* m_program = nullptr;
+  size_t m_size = 0;
+};
+
+#endif //EMU_BACKPLANETEST_H
@@ -0,0 +1,189 @@
+/*
+ * Copyright (c) 2021, Jan de Visser <jan@finiandarcy.com>
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include <sstream>
+#include <utility>
+
+#include "backplanetest.h"
+#include "cpu/callstack.h"
+
+const byte callstack_program[] = {
+  /* 1000 */ MOV_SP_CONST, 0x00, 0x20,
+  /* 1003 */ CALL, 0x10, 0x10,
+  /* 1006 */ CALL, 0x10, 0x10,
+  /* 1009 */ HLT,
+  /* 100A */ NOP, NOP, NOP, NOP, NOP, NOP,
+  /* 1010 */ CALL, 0x20, 0x10,
+  /* 1013 */ RET,
+  /* 1014 */ NOP, NOP, NOP, NOP, NOP, NOP, NOP, NOP, NOP, NOP, NOP, NOP,
+  /* 1020 */ MOV_A_CONST, 0x05,
+  /* 1022 */ RET,
+};
+
+const byte nmi_program[] = {
+  /* 1100 */ MOV_SP_CONST, 0x00, 0x20,
+  /* 1103 */ NMIVEC, 0x40, 0x11,
+  /* 1106 */ MOV_SI_CONST, 0x10, 0x00,
+  /* 1109 */ DEC_SI,
+  /* 110A */ JNZ, 0x09, 0x11,
+  /* 110D */ HLT,
+  /* 110E */ NOP, NOP, NOP, NOP, NOP, NOP, NOP, NOP, NOP, NOP, NOP, NOP, NOP, NOP, NOP, NOP, NOP, NOP,
+  /* 1120 */ NOP, NOP, NOP, NOP, NOP, NOP, NOP, NOP, NOP, NOP, NOP, NOP, NOP, NOP, NOP, NOP,
+  /* 1130 */ NOP, NOP, NOP, NOP, NOP, NOP, NOP, NOP, NOP, NOP, NOP, NOP, NOP, NOP, NOP, NOP,
+  /* 1140 */ MOV_A_CONST, 0x55,
+  /* 1142 */ RTI,
+};
+
+class CallStackTest : public BackPlaneTest {
+protected:
+  CallStackTest()
+    : BackPlaneTest(callstack_program) {
+  }
+
+  CallStack* run(BackPlane::Engine engine) {
+    system->setEngine(engine);
+    auto callStack = system->enableCallStack();
+    system->run(PROGRAM_START);
+    EXPECT_EQ(system->error(), NoError);
+    return callStack;
+  }
+};
+
+TEST_F(CallStackTest, routines) {
+  auto callStack = run(BackPlane::CycleAccurate);
+  ASSERT_EQ(callStack->depth(), 0);
+  ASSERT_EQ(callStack->mismatches(), 0);
+  auto routines = callStack->routines();
+  ASSERT_EQ(routines.size(), 2);
+  auto& outer = routines[0x1010];
+  auto& inner = routines[0x1020];
+  ASSERT_EQ(outer.calls, 2);
+  ASSERT_EQ(inner.calls, 2);
+  ASSERT_EQ(inner.inclusive, inner.exclusive);
+  ASSERT_EQ(outer.inclusive, outer.exclusive + inner.inclusive);
+  ASSERT_LT(outer.inclusive, callStack->cycles());
+}
+
+TEST_F(CallStackTest, functionalMatchesCycleAccurate) {
+  auto expected = run(BackPlane::CycleAccurate)->routines();
+  system->disableCallStack();
+  system->reset();
+  auto routines = run(BackPlane::Functional)->routines();
+  ASSERT_EQ(routines.size(), expected.size());
+  for (auto& [target, stats] : expected) {
+    ASSERT_EQ(routines[target].calls, stats.calls) << "Routine " << target;
+    ASSERT_EQ(routines[target].inclusive, stats.inclusive) << "Routine " << target;
+    ASSERT_EQ(routines[target].exclusive, stats.exclusive) << "Routine " << target;
+  }
+}
+
+TEST_F(CallStackTest, breakpoint) {
+  for (auto engine : { BackPlane::CycleAccurate, BackPlane::Functional }) {
+    system->reset();
+    system->breakpoints().set(0x1022);
+    auto callStack = run(engine);
+    ASSERT_TRUE(system->atBreakpoint()) << "Engine " << engine;
+    ASSERT_EQ(system->component(PC)->getValue(), 0x1022);
+    ASSERT_EQ(callStack->depth(), 2);
+    auto& frames = callStack->frames();
+    ASSERT_EQ(frames[0].callSite, 0x1003);
+    ASSERT_EQ(frames[0].target, 0x1010);
+    ASSERT_EQ(frames[0].returnAddress, 0x1006);
+    ASSERT_EQ(frames[1].callSite, 0x1010);
+    ASSERT_EQ(frames[1].target, 0x1020);
+
+    system->run(0xFFFF);
+    ASSERT_TRUE(system->atBreakpoint()) << "Engine " << engine;
+    ASSERT_EQ(callStack->depth(), 2);
+    ASSERT_EQ(callStack->frames()[0].callSite, 0x1006);
+
+    system->run(0xFFFF);
+    ASSERT_FALSE(system->atBreakpoint()) << "Engine " << engine;
+    ASSERT_FALSE(system->bus().halt());
+    ASSERT_EQ(callStack->depth(), 0);
+    system->breakpoints().clear();
+    system->disableCallStack();
+  }
+}
+
+TEST_F(CallStackTest, backtrace) {
+  SymbolTable symbols;
+  symbols.add(0x1000, "main");
+  symbols.add(0x1010, "outer");
+  symbols.add(0x1020, "inner");
+  system->breakpoints().set(0x1022);
+  auto callStack = run(BackPlane::CycleAccurate);
+  std::stringstream ss;
+  callStack->backtrace(ss, 0x1022, &symbols);
+  std::string line;
+  std::getline(ss, line);
+  ASSERT_EQ(line, "#0  1022  inner+2");
+  std::getline(ss, line);
+  ASSERT_EQ(line, "#1  1010  outer");
+  std::getline(ss, line);
+  ASSERT_EQ(line, "#2  1003  main+3");
+  ASSERT_FALSE(std::getline(ss, line));
+}
+
+TEST_F(CallStackTest, interrupt) {
+  load(nmi_program, 0x1100);
+  for (auto engine : { BackPlane::CycleAccurate, BackPlane::Functional }) {
+    system->reset();
+    system->setEngine(engine);
+    auto callStack = system->enableCallStack();
+    system->breakpoints().set(0x1109);
+    system->run(0x1100);
+    ASSERT_TRUE(system->atBreakpoint()) << "Engine " << engine;
+
+    system->breakpoints().clear();
+    system->breakpoints().set(0x1140);
+    system->bus().setNmi();
+    system->run(0xFFFF);
+    ASSERT_TRUE(system->atBreakpoint()) << "Engine " << engine;
+    ASSERT_EQ(callStack->depth(), 1);
+    auto& frame = callStack->frames()[0];
+    ASSERT_TRUE(frame.interrupt);
+    ASSERT_EQ(frame.target, 0x1140);
+    ASSERT_EQ(frame.callSite, frame.returnAddress);
+    ASSERT_GE(frame.returnAddress, 0x1109);
+    ASSERT_LE(frame.returnAddress, 0x110A);
+
+    // The NMI pushed the flags and then the return address:
+    auto sp = system->component(SP)->getValue();
+    ASSERT_EQ(sp, 0x2003);
+    auto& mem = std::as_const(*system->memory());
+    ASSERT_EQ(mem[sp - 2] | (mem[sp - 1] << 8), frame.returnAddress);
+
+    system->breakpoints().clear();
+    system->run(0xFFFF);
+    ASSERT_EQ(system->error(), NoError);
+    ASSERT_FALSE(system->bus().halt());
+    ASSERT_EQ(system->component(GP_A)->getValue(), 0x55);
+    ASSERT_EQ(callStack->depth(), 0) << "Engine " << engine;
+    ASSERT_EQ(callStack->mismatches(), 0);
+    ASSERT_EQ(callStack->routines()[0x1140].calls, 1);
+    system->disableCallStack();
+  }
+}
+
+TEST_F(CallStackTest, unmatchedReturn) {
+  CallStack callStack;
+  callStack.call(0x1003, 0x1010, 0x1006, false);
+  callStack.tick();
+  callStack.call(0x1010, 0x1020, 0x1013, false);
+  callStack.tick();
+  callStack.ret(0x4000);
+  ASSERT_EQ(callStack.mismatches(), 1);
+  ASSERT_EQ(callStack.depth(), 2);
+
+  // Returning past a frame pops it as well:
+  callStack.ret(0x1006);
+  ASSERT_EQ(callStack.depth(), 0);
+  auto routines = callStack.routines();
+  ASSERT_EQ(routines[0x1010].inclusive, 2);
+  ASSERT_EQ(routines[0x1010].exclusive, 1);
+  ASSERT_EQ(routines[0x1020].inclusive, 1);
+}
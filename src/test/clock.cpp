@@ -105,3 +105,34 @@ TEST_F(ClockTest, ticksAreAccurate) {
   ASSERT_EQ(system->cycles, 1000);
   ASSERT_NEAR(std::chrono::duration_cast<std::chrono::milliseconds>(finish - start).count(), 1000, 500);
 }
+
+TEST_F(ClockTest, freeRunning) {
+  system->max_cycles = 100000;
+  system->clock.setFreeRunning(true);
+  ASSERT_TRUE(system->clock.freeRunning());
+  SystemError err = system->clock.start();
+  ASSERT_EQ(err, NoError);
+  ASSERT_EQ(system->cycles, 100000);
+  ASSERT_EQ(system->clock.cycles(), 100000);
+  ASSERT_LT(system->clock.elapsed(), 1.0);
+  ASSERT_GT(system->clock.achievedFrequency(), 100.0);
+}
+
+TEST_F(ClockTest, highFrequencyIsAccurate) {
+  ASSERT_TRUE(system->clock.setSpeed(1000));
+  system->max_cycles = 200000;
+  auto start = std::chrono::high_resolution_clock::now();
+  SystemError err = system->clock.start();
+  auto finish = std::chrono::high_resolution_clock::now();
+  ASSERT_EQ(err, NoError);
+  ASSERT_EQ(system->cycles, 200000);
+  ASSERT_NEAR(std::chrono::duration_cast<std::chrono::milliseconds>(finish - start).count(), 200, 50);
+  ASSERT_NEAR(system->clock.achievedFrequency(), 1000.0, 250.0);
+}
+
+TEST_F(ClockTest, speedIsBounded) {
+  ASSERT_TRUE(system->clock.setSpeed(Clock::MAX_FREQUENCY));
+  ASSERT_FALSE(system->clock.setSpeed(Clock::MAX_FREQUENCY * 2));
+  ASSERT_FALSE(system->clock.setSpeed(0));
+  ASSERT_EQ(system->clock.frequency(), Clock::MAX_FREQUENCY);
+}
@@ -704,3 +704,23 @@ TEST_F(TESTNAME, movConstToCDIndirect) {
   ASSERT_EQ(system -> bus().halt(), false);
   ASSERT_EQ((*mem)[0x2007], 0x42);
 }
+
+TEST_F(TESTNAME, microCodeTable) {
+  auto &table = MicroCodeTable::get(mc);
+  ASSERT_EQ(&table, &c -> microCodeTable());
+
+  // Opcodes without microcode don't have steps:
+  ASSERT_EQ(table.instruction(NOP, SystemBus::Clear).microCode, nullptr);
+  ASSERT_EQ(table.instruction(NOP, SystemBus::Clear).size, 0);
+
+  // A conditional jump only loads PC if the condition holds:
+  auto &taken = table.instruction(JNZ, SystemBus::Clear);
+  auto &notTaken = table.instruction(JNZ, SystemBus::Z);
+  ASSERT_EQ(taken.microCode -> opcode, JNZ);
+  ASSERT_EQ(taken.size, notTaken.size + 1);
+  ASSERT_EQ(taken.steps[taken.size - 1].target, PC);
+  ASSERT_NE(notTaken.steps[notTaken.size - 1].target, PC);
+
+  ASSERT_EQ(table.nmi(SystemBus::Clear).microCode, Controller::nmiMicroCode());
+  ASSERT_EQ(table.nmi(SystemBus::Clear).size, 7);
+}
@@ -0,0 +1,118 @@
+/*
+ * Copyright (c) 2021, Jan de Visser <jan@finiandarcy.com>
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include <sstream>
+
+#include "backplanetest.h"
+#include "cpu/counters.h"
+
+const byte counters_program[] = {
+  /* 1000 */ MOV_DI_CONST, 0x00, 0x20,
+  /* 1003 */ MOV_SI_CONST, 0x08, 0x00,
+  /* 1006 */ MOV_A_CONST, 0x5A,
+  /* 1008 */ MOV__DI_A,
+  /* 1009 */ DEC_SI,
+  /* 100A */ JNZ, 0x08, 0x10,
+  /* 100D */ HLT,
+};
+
+class CountersTest : public BackPlaneTest {
+protected:
+  CountersTest()
+    : BackPlaneTest(counters_program) {
+  }
+
+  ExecutionCounters* run(BackPlane::Engine engine) {
+    system->setEngine(engine);
+    auto counters = system->enableCounters();
+    system->run(PROGRAM_START);
+    EXPECT_EQ(system->error(), NoError);
+    return counters;
+  }
+};
+
+TEST_F(CountersTest, disabledByDefault) {
+  ASSERT_EQ(system->counters(), nullptr);
+  system->run(PROGRAM_START);
+  ASSERT_EQ(system->counters(), nullptr);
+}
+
+TEST_F(CountersTest, cycleAccurate) {
+  auto counters = run(BackPlane::CycleAccurate);
+  ASSERT_EQ(counters->executions[MOV_DI_CONST], 1);
+  ASSERT_EQ(counters->executions[MOV__DI_A], 8);
+  ASSERT_EQ(counters->executions[DEC_SI], 8);
+  ASSERT_EQ(counters->executions[JNZ], 8);
+  ASSERT_EQ(counters->taken[JNZ], 7);
+  ASSERT_EQ(counters->notTaken[JNZ], 1);
+  ASSERT_EQ(counters->taken[DEC_SI], 0);
+  ASSERT_EQ(counters->executions[HLT], 1);
+  ASSERT_EQ(counters->executions[MicroCodeTable::NMI], 0);
+
+  // Every instruction is charged the cycles between the completion of the
+  // previous instruction and its own, and HLT the cycles until it halts:
+  ASSERT_EQ(counters->cycles[MOV__DI_A] % 8, 0);
+  ASSERT_GT(counters->cycles[HLT], 0);
+  unsigned long cycles = 0;
+  for (auto c : counters->cycles) {
+    cycles += c;
+  }
+  ASSERT_EQ(cycles, (system->cycles() + 1) / 2);
+
+  // Steps of the instruction itself are counted once per execution:
+  auto& table = system->controller()->microCodeTable();
+  auto& movDiA = table.entry(MOV__DI_A, true);
+  for (int step = 0; step < movDiA.size; step++) {
+    ASSERT_EQ(counters->steps[table.stepIndex(movDiA, step)], 8);
+  }
+}
+
+TEST_F(CountersTest, functionalMatchesCycleAccurate) {
+  auto counters = run(BackPlane::CycleAccurate);
+  ExecutionCounters expected = *counters;
+  system->disableCounters();
+  system->reset();
+  counters = run(BackPlane::Functional);
+
+  for (int opcode = 0; opcode <= MicroCodeTable::NMI; opcode++) {
+    ASSERT_EQ(counters->executions[opcode], expected.executions[opcode]) << "Opcode " << opcode;
+    ASSERT_EQ(counters->cycles[opcode], expected.cycles[opcode]) << "Opcode " << opcode;
+    ASSERT_EQ(counters->taken[opcode], expected.taken[opcode]) << "Opcode " << opcode;
+    ASSERT_EQ(counters->notTaken[opcode], expected.notTaken[opcode]) << "Opcode " << opcode;
+  }
+  ASSERT_EQ(counters->steps, expected.steps);
+}
+
+TEST_F(CountersTest, csv) {
+  auto counters = run(BackPlane::CycleAccurate);
+  std::stringstream ss;
+  counters->writeCSV(ss);
+  std::string line;
+  std::getline(ss, line);
+  ASSERT_EQ(line, "opcode,instruction,executions,cycles,taken,not_taken");
+  int lines = 0;
+  bool seenJnz = false;
+  while (std::getline(ss, line)) {
+    lines++;
+    if (line.starts_with("0x28,")) {
+      ASSERT_NE(line.find(",8,"), std::string::npos);
+      ASSERT_TRUE(line.ends_with(",7,1"));
+      seenJnz = true;
+    }
+  }
+  ASSERT_EQ(lines, 7);
+  ASSERT_TRUE(seenJnz);
+}
+
+TEST_F(CountersTest, json) {
+  auto counters = run(BackPlane::CycleAccurate);
+  std::stringstream ss;
+  counters->writeJSON(ss);
+  auto json = ss.str();
+  ASSERT_NE(json.find("\"instruction\": \"jnz #%04x\", \"executions\": 8"), std::string::npos);
+  ASSERT_NE(json.find("\"taken\": 7, \"not_taken\": 1"), std::string::npos);
+  ASSERT_NE(json.find("\"steps_not_taken\""), std::string::npos);
+}
@@ -0,0 +1,111 @@
+/*
+ * Copyright (c) 2021, Jan de Visser <jan@finiandarcy.com>
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include <sstream>
+
+#include "backplanetest.h"
+#include "cpu/coverage.h"
+
+const byte coverage_program[] = {
+  /* 1000 */ MOV_SI_CONST, 0x03, 0x00,
+  /* 1003 */ DEC_SI,
+  /* 1004 */ JNZ, 0x03, 0x10,
+  /* 1007 */ JZ, 0x0B, 0x10,
+  /* 100A */ HLT,
+  /* 100B */ NOP,
+  /* 100C */ HLT,
+};
+
+const char* coverage_sources =
+  "# Listing of coverage_program\n"
+  "0x1000 loop.asm:1\n"
+  "0x1003 loop.asm:2\n"
+  "0x1004 loop.asm:3\n"
+  "0x1007 loop.asm:4\n"
+  "0x100A loop.asm:5\n"
+  "0x100B loop.asm:6\n"
+  "0x100C loop.asm:6\n";
+
+class CoverageTest : public BackPlaneTest {
+protected:
+  CoverageTest()
+    : BackPlaneTest(coverage_program) {
+  }
+
+  Coverage* run(BackPlane::Engine engine) {
+    system->setEngine(engine);
+    auto coverage = system->enableCoverage();
+    system->run(PROGRAM_START);
+    EXPECT_EQ(system->error(), NoError);
+    return coverage;
+  }
+};
+
+TEST_F(CoverageTest, executed) {
+  auto coverage = run(BackPlane::CycleAccurate);
+  ASSERT_EQ(coverage->executed.count(), 12);
+  for (word addr = 0x1000; addr < 0x100D; addr++) {
+    ASSERT_EQ(coverage->executed.test(addr), addr != 0x100A) << "Address " << addr;
+  }
+  ASSERT_TRUE(coverage->taken.test(0x1004));
+  ASSERT_TRUE(coverage->notTaken.test(0x1004));
+  ASSERT_TRUE(coverage->taken.test(0x1007));
+  ASSERT_FALSE(coverage->notTaken.test(0x1007));
+  ASSERT_FALSE(coverage->taken.test(0x1003));
+  ASSERT_FALSE(coverage->notTaken.test(0x1003));
+}
+
+TEST_F(CoverageTest, functionalMatchesCycleAccurate) {
+  auto coverage = run(BackPlane::CycleAccurate);
+  auto executed = coverage->executed;
+  auto taken = coverage->taken;
+  auto notTaken = coverage->notTaken;
+  system->disableCoverage();
+  system->reset();
+  coverage = run(BackPlane::Functional);
+  ASSERT_EQ(coverage->executed, executed);
+  ASSERT_EQ(coverage->taken, taken);
+  ASSERT_EQ(coverage->notTaken, notTaken);
+}
+
+TEST_F(CoverageTest, ranges) {
+  auto coverage = run(BackPlane::Functional);
+  std::stringstream ss;
+  coverage->writeRanges(ss);
+  ASSERT_EQ(ss.str(),
+    "12 bytes executed\n"
+    "1000-1009\n"
+    "100b-100c\n"
+    "1007 branch always taken\n");
+}
+
+TEST_F(CoverageTest, sourceMap) {
+  SourceMap sources;
+  std::istringstream is(coverage_sources);
+  ASSERT_TRUE(sources.load(is));
+  ASSERT_EQ(sources.locations().size(), 7);
+  ASSERT_EQ(sources.locations().at(0x1007).file, "loop.asm");
+  ASSERT_EQ(sources.locations().at(0x1007).line, 4);
+
+  std::istringstream bad("0x1000 loop.asm\n");
+  ASSERT_FALSE(sources.load(bad));
+}
+
+TEST_F(CoverageTest, lcov) {
+  SourceMap sources;
+  std::istringstream is(coverage_sources);
+  sources.load(is);
+  auto coverage = run(BackPlane::CycleAccurate);
+  std::stringstream ss;
+  coverage->writeLcov(ss, sources, "coverage");
+  auto lcov = ss.str();
+  ASSERT_TRUE(lcov.starts_with("TN:coverage\nSF:loop.asm\n"));
+  ASSERT_NE(lcov.find("BRDA:3,4100,0,1\nBRDA:3,4100,1,1\n"), std::string::npos);
+  ASSERT_NE(lcov.find("BRDA:4,4103,0,1\nBRDA:4,4103,1,0\n"), std::string::npos);
+  ASSERT_NE(lcov.find("BRF:4\nBRH:3\n"), std::string::npos);
+  ASSERT_NE(lcov.find("DA:4,1\nDA:5,0\nDA:6,1\n"), std::string::npos);
+  ASSERT_TRUE(lcov.ends_with("LF:6\nLH:5\nend_of_record\n"));
+}
@@ -0,0 +1,110 @@
+/*
+ * Copyright (c) 2021, Jan de Visser <jan@finiandarcy.com>
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include <gtest/gtest.h>
+#include <thread>
+#include <vector>
+
+#include "cpu/eventqueue.h"
+#include "cpu/register.h"
+
+class RecordingListener : public ComponentListener {
+public:
+  std::vector<std::pair<Component const*, int>> events;
+
+  void componentEvent(Component const* sender, int ev) override {
+    events.emplace_back(sender, ev);
+  }
+};
+
+TEST(EventQueue, deliversOnDrain) {
+  EventQueue queue;
+  Register reg(1);
+  RecordingListener listener;
+  queue.attach(&reg, &listener);
+  reg.setValue(0x42);
+  ASSERT_TRUE(listener.events.empty());
+  ASSERT_EQ(queue.drain(), 1u);
+  ASSERT_EQ(listener.events.size(), 1u);
+  ASSERT_EQ(listener.events[0].first, &reg);
+  ASSERT_EQ(listener.events[0].second, Component::EV_VALUECHANGED);
+  ASSERT_EQ(queue.drain(), 0u);
+}
+
+TEST(EventQueue, coalesces) {
+  EventQueue queue;
+  Register r1(1);
+  Register r2(2);
+  RecordingListener listener;
+  queue.attach(&r1, &listener);
+  queue.attach(&r2, &listener);
+  for (int ix = 0; ix < 100; ix++) {
+    r2.setValue(ix);
+    r1.setValue(ix);
+  }
+  ASSERT_EQ(queue.drain(), 2u);
+  ASSERT_EQ(listener.events.size(), 2u);
+  ASSERT_EQ(listener.events[0].first, &r2);
+  ASSERT_EQ(listener.events[1].first, &r1);
+}
+
+TEST(EventQueue, respectsMask) {
+  EventQueue queue;
+  Register reg(1);
+  RecordingListener listener;
+  queue.attach(&reg, &listener, 0);
+  reg.setValue(0x42);
+  ASSERT_EQ(queue.drain(), 0u);
+  reg.setEventMask(Component::ALL_EVENTS);
+  reg.setValue(0x43);
+  ASSERT_EQ(queue.drain(), 1u);
+  queue.detach(&reg);
+  reg.setValue(0x44);
+  ASSERT_EQ(queue.drain(), 0u);
+}
+
+TEST(EventQueue, overflowKeepsDistinctEvents) {
+  EventQueue queue(4);
+  Register r1(1);
+  Register r2(2);
+  RecordingListener listener;
+  queue.attach(&r1, &listener);
+  queue.attach(&r2, &listener);
+  for (int ix = 0; ix < 10; ix++) {
+    r1.setValue(ix);
+  }
+  r2.setValue(0x42);
+  ASSERT_GT(queue.overflows(), 0u);
+  ASSERT_EQ(queue.drain(), 2u);
+  ASSERT_EQ(listener.events.size(), 2u);
+  ASSERT_EQ(listener.events[1].first, &r2);
+}
+
+TEST(EventQueue, producerThread) {
+  EventQueue queue(64);
+  Register regs[] = { Register(1), Register(2), Register(3) };
+  RecordingListener listener;
+  for (auto& reg : regs) {
+    queue.attach(&reg, &listener);
+  }
+  std::atomic<bool> done = false;
+  std::thread producer([&regs, &done]() {
+    for (int ix = 0; ix < 100000; ix++) {
+      regs[ix % 3].setValue(ix);
+    }
+    done = true;
+  });
+  while (!done) {
+    queue.drain();
+  }
+  producer.join();
+  queue.drain();
+  for (auto& reg : regs) {
+    ASSERT_NE(std::find_if(listener.events.begin(), listener.events.end(), [&reg](auto& e) {
+      return e.first == &reg;
+    }), listener.events.end());
+  }
+}
@@ -0,0 +1,152 @@
+/*
+ * Copyright (c) 2021, Jan de Visser <jan@finiandarcy.com>
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include <cstdio>
+#include <fstream>
+#include <gtest/gtest.h>
+#include <sstream>
+
+#include "cpu/farm.h"
+#include "cpu/opcodes.h"
+
+const byte echo_program[] = {
+  /* 1000 */ IN_A, 0x00,
+  /* 1002 */ CMP_A_CONST, 0xFF,
+  /* 1004 */ JZ, 0x0C, 0x10,
+  /* 1007 */ OUT_A, 0x01,
+  /* 1009 */ JMP, 0x00, 0x10,
+  /* 100C */ HLT,
+};
+
+const byte loop_program[] = {
+  /* 1000 */ JMP, 0x00, 0x10,
+};
+
+class FarmTest : public ::testing::Test {
+protected:
+  std::string dir;
+
+  void SetUp() override {
+    dir = testing::TempDir() + "farm_" + testing::UnitTest::GetInstance()->current_test_info()->name() + "_";
+  }
+
+  static FarmJob job(const std::string& name, const byte* program, size_t size, const std::string& input = "") {
+    FarmJob ret;
+    ret.name = name;
+    ret.image = std::make_shared<const std::vector<byte>>(program, program + size);
+    ret.load = 0x1000;
+    ret.start = 0x1000;
+    ret.input = std::make_shared<const std::vector<byte>>(input.begin(), input.end());
+    return ret;
+  }
+
+  void write(const std::string& name, const std::string& contents) {
+    std::ofstream os(dir + name, std::ios::binary);
+    os << contents;
+  }
+};
+
+TEST_F(FarmTest, echo) {
+  for (auto engine : { BackPlane::CycleAccurate, BackPlane::Functional }) {
+    auto j = job("echo", echo_program, sizeof(echo_program), "Hello");
+    j.engine = engine;
+    auto result = Farm::execute(j);
+    ASSERT_EQ(result.exit, FarmResult::Halted);
+    ASSERT_EQ(result.error, NoError);
+    ASSERT_EQ(std::string(result.output.begin(), result.output.end()), "Hello");
+    ASSERT_EQ(result.registers[GP_A], 0xFF);
+    ASSERT_EQ(result.registers[PC], 0x100D);
+    ASSERT_GT(result.cycles, 0);
+  }
+}
+
+TEST_F(FarmTest, cycleLimit) {
+  auto j = job("loop", loop_program, sizeof(loop_program));
+  j.cycleLimit = 1000;
+  j.engine = BackPlane::CycleAccurate;
+  auto result = Farm::execute(j);
+  ASSERT_EQ(result.exit, FarmResult::CycleLimit);
+  ASSERT_EQ(result.cycles, 1000);
+
+  // The functional engine finishes the instruction it is executing:
+  j.engine = BackPlane::Functional;
+  result = Farm::execute(j);
+  ASSERT_EQ(result.exit, FarmResult::CycleLimit);
+  ASSERT_GE(result.cycles, 1000);
+  ASSERT_LT(result.cycles, 1020);
+}
+
+TEST_F(FarmTest, parallel) {
+  std::vector<FarmJob> jobs;
+  for (int ix = 0; ix < 12; ix++) {
+    if (ix % 4 == 3) {
+      jobs.push_back(job("loop" + std::to_string(ix), loop_program, sizeof(loop_program)));
+      jobs.back().cycleLimit = 500 * ix;
+    } else {
+      jobs.push_back(job("echo" + std::to_string(ix), echo_program, sizeof(echo_program), std::string(ix * 5, 'a' + ix)));
+    }
+    jobs.back().engine = (ix % 2) ? BackPlane::Functional : BackPlane::CycleAccurate;
+  }
+
+  Farm farm(3);
+  auto results = farm.run(jobs);
+  ASSERT_EQ(results.size(), jobs.size());
+  for (auto ix = 0u; ix < jobs.size(); ix++) {
+    auto expected = Farm::execute(jobs[ix]);
+    ASSERT_EQ(results[ix].name, jobs[ix].name);
+    ASSERT_EQ(results[ix].exit, expected.exit);
+    ASSERT_EQ(results[ix].output, expected.output);
+    ASSERT_EQ(results[ix].cycles, expected.cycles);
+    ASSERT_EQ(results[ix].instructions, expected.instructions);
+    ASSERT_TRUE(std::equal(std::begin(results[ix].registers), std::end(results[ix].registers), std::begin(expected.registers)));
+  }
+}
+
+TEST_F(FarmTest, manifest) {
+  write("echo.bin", std::string(echo_program, echo_program + sizeof(echo_program)));
+  write("loop.bin", std::string(loop_program, loop_program + sizeof(loop_program)));
+  write("input.txt", "xyz");
+  auto base = dir.substr(dir.find_last_of('/') + 1);
+  write("manifest.txt",
+    "# Jobs\n"
+    "\n"
+    "first image=" + base + "echo.bin load=1000 start=0x1000 input=" + base + "input.txt\n"
+    "  second image=" + base + "loop.bin load=1000 start=1000 cycles=200 engine=cycle\n"
+    "third image=" + base + "echo.bin\n");
+
+  std::vector<FarmJob> jobs;
+  std::string error;
+  ASSERT_TRUE(loadManifest(dir + "manifest.txt", jobs, error)) << error;
+  ASSERT_EQ(jobs.size(), 3);
+  ASSERT_EQ(jobs[0].name, "first");
+  ASSERT_EQ(jobs[0].load, 0x1000);
+  ASSERT_EQ(jobs[0].start, 0x1000);
+  ASSERT_EQ(jobs[0].engine, BackPlane::Functional);
+  ASSERT_EQ(jobs[1].cycleLimit, 200);
+  ASSERT_EQ(jobs[1].engine, BackPlane::CycleAccurate);
+  ASSERT_NE(jobs[0].image, jobs[1].image);
+  ASSERT_EQ(jobs[0].image, jobs[2].image);
+  ASSERT_EQ(jobs[2].load, 0x0000);
+
+  auto results = Farm(2).run(jobs);
+  ASSERT_EQ(std::string(results[0].output.begin(), results[0].output.end()), "xyz");
+  ASSERT_EQ(results[1].exit, FarmResult::CycleLimit);
+  ASSERT_EQ(results[1].cycles, 200);
+
+  std::ostringstream csv;
+  writeResultsCSV(csv, results);
+  ASSERT_NE(csv.str().find("first,halted,0,100d,ff,"), std::string::npos);
+  ASSERT_NE(csv.str().find(",78797a\n"), std::string::npos);
+
+  write("manifest.txt", "bad image=" + base + "missing.bin\n");
+  jobs.clear();
+  ASSERT_FALSE(loadManifest(dir + "manifest.txt", jobs, error));
+  ASSERT_NE(error.find("missing.bin"), std::string::npos);
+
+  for (auto name : { "echo.bin", "loop.bin", "input.txt", "manifest.txt" }) {
+    remove((dir + name).c_str());
+  }
+}
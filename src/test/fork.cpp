@@ -0,0 +1,96 @@
+/*
+ * Copyright (c) 2021, Jan de Visser <jan@finiandarcy.com>
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include <utility>
+
+#include "backplanetest.h"
+
+const byte fork_program[] = {
+  /* 1000 */ MOV_SP_CONST, 0x00, 0x80,
+  /* 1003 */ MOV_A_CONST, 0x42,
+  /* 1005 */ PUSH_A,
+  /* 1006 */ MOV_DI_CONST, 0x00, 0x20,
+  /* 1009 */ MOV__DI_A,
+  /* 100A */ POP_B,
+  /* 100B */ HLT,
+};
+
+class ForkTest : public BackPlaneTest {
+protected:
+  ForkTest()
+    : BackPlaneTest(fork_program) {
+  }
+
+  void SetUp() override {
+    BackPlaneTest::SetUp();
+    (*system->memory())[0x2000] = 0x17;
+    setPC(PROGRAM_START);
+  }
+
+  static void run(BackPlane* s) {
+    s->run(0xFFFF);
+    ASSERT_EQ(s->error(), NoError);
+    ASSERT_FALSE(s->bus().halt());
+    ASSERT_EQ(s->component(GP_B)->getValue(), 0x42);
+  }
+};
+
+TEST_F(ForkTest, copyOnWrite) {
+  auto child = system->fork();
+  ASSERT_EQ(child->memory()->banks().size(), system->memory()->banks().size());
+  ASSERT_EQ(child->component(PC)->getValue(), PROGRAM_START);
+  ASSERT_EQ(child->memory()->copiedPages(), 0);
+
+  run(child.get());
+  ASSERT_EQ((*child->memory())[0x2000], 0x42);
+  ASSERT_EQ(std::as_const(*system->memory())[0x2000], 0x17);
+  ASSERT_EQ(std::as_const(*system->memory())[0x7FFF], 0x00);
+
+  // Only the page at 0x2000 and the stack page were copied:
+  ASSERT_EQ(child->memory()->copiedPages(), 2);
+  ASSERT_EQ(system->memory()->copiedPages(), 0);
+
+  run(system);
+  ASSERT_EQ((*system->memory())[0x2000], 0x42);
+}
+
+TEST_F(ForkTest, parentWrites) {
+  auto child = system->fork();
+  (*system->memory())[PROGRAM_START + 4] = 0x55;
+  ASSERT_EQ(std::as_const(*child->memory())[PROGRAM_START + 4], 0x42);
+  system->run(0xFFFF);
+  ASSERT_EQ(system->component(GP_B)->getValue(), 0x55);
+  run(child.get());
+}
+
+TEST_F(ForkTest, nested) {
+  system->setEngine(BackPlane::Functional);
+  auto child = system->fork();
+  (*child->memory())[PROGRAM_START + 4] = 0x55;
+  auto grandchild = child->fork();
+  ASSERT_EQ(grandchild->engine(), BackPlane::Functional);
+  child.reset();
+
+  grandchild->run(0xFFFF);
+  ASSERT_EQ(grandchild->error(), NoError);
+  ASSERT_EQ(grandchild->component(GP_B)->getValue(), 0x55);
+  run(system);
+}
+
+TEST_F(ForkTest, reconfigure) {
+  auto child = system->fork();
+  (*child->memory())[0x2000] = 0x99;
+  const byte contents[] = { 0x98, 0x97 };
+  ASSERT_TRUE(child->memory()->add(0x2010, sizeof(contents), true, contents));
+  ASSERT_EQ(child->memory()->copiedPages(), 0);
+  ASSERT_EQ(std::as_const(*child->memory())[0x2000], 0x99);
+  ASSERT_EQ(std::as_const(*child->memory())[0x2011], 0x97);
+  ASSERT_EQ(std::as_const(*system->memory())[0x2000], 0x17);
+  ASSERT_EQ(std::as_const(*system->memory())[0x2011], 0x00);
+  child->memory()->erase();
+  ASSERT_EQ(std::as_const(*system->memory())[PROGRAM_START], MOV_SP_CONST);
+  run(system);
+}
@@ -0,0 +1,163 @@
+/*
+ * Copyright (c) 2021, Jan de Visser <jan@finiandarcy.com>
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include <algorithm>
+#include <gtest/gtest.h>
+#include <vector>
+
+#include "cpu/backplane.h"
+#include "cpu/iochannel.h"
+#include "cpu/opcodes.h"
+
+constexpr word PROGRAM_START = 0x1000;
+constexpr word DATA_START = 0x2000;
+constexpr word STACK_START = 0x8000;
+
+const byte asm_program[] = {
+  /* 1000 */ MOV_SP_CONST, 0x00, 0x80,
+  /* 1003 */ NMIVEC, 0x40, 0x10,
+  /* 1006 */ MOV_DI_CONST, 0x00, 0x20,
+  /* 1009 */ MOV_A_CONST, 0x01,
+  /* 100B */ MOV_B_CONST, 0x01,
+  /* 100D */ MOV_SI_CONST, 0x18, 0x00,
+  /* 1010 */ CALL, 0x30, 0x10,
+  /* 1013 */ DEC_SI,
+  /* 1014 */ JNZ, 0x10, 0x10,
+  /* 1017 */ OUT_A, 0x01,
+  /* 1019 */ OUT_B, 0x01,
+  /* 101B */ HLT,
+  /* 101C */ NOP, NOP, NOP, NOP, NOP, NOP, NOP, NOP, NOP, NOP,
+  /* 1026 */ NOP, NOP, NOP, NOP, NOP, NOP, NOP, NOP, NOP, NOP,
+  /* 1030 */ MOV_C_A,
+  /* 1031 */ ADD_A_B,
+  /* 1032 */ MOV_B_C,
+  /* 1033 */ MOV__DI_A,
+  /* 1034 */ INC_DI,
+  /* 1035 */ IN_D, 0x02,
+  /* 1037 */ XOR_C_D,
+  /* 1038 */ PUSH_C,
+  /* 1039 */ SHL_C,
+  /* 103A */ POP_C,
+  /* 103B */ RET,
+  /* 103C */ NOP, NOP, NOP, NOP,
+  /* 1040 */ PUSH_A,
+  /* 1041 */ MOV_A_CONST, 0x55,
+  /* 1043 */ OUT_A, 0x01,
+  /* 1045 */ CMP_A_CONST, 0x55,
+  /* 1047 */ POP_A,
+  /* 1048 */ RTI,
+};
+
+class Machine {
+public:
+  BackPlane system;
+  std::vector<byte> output;
+  int reads = 0;
+  int nmiAtRead = -1;
+
+  explicit Machine(BackPlane::Engine engine) {
+    system.defaultSetup();
+    system.setFreeRunning(true);
+    system.setEngine(engine);
+    system.insertIO(new IOChannel(0x1, "OUT", [this](byte value) {
+      output.push_back(value);
+    }));
+    system.insertIO(new IOChannel(0x2, "IN", [this]() -> byte {
+      if (++reads == nmiAtRead) {
+        system.bus().setNmi();
+      }
+      return (byte) (reads * 7);
+    }));
+    auto mem = system.memory();
+    for (word ix = 0; ix < sizeof(asm_program); ix++) {
+      (*mem)[PROGRAM_START + ix] = asm_program[ix];
+    }
+  }
+
+  int reg(int id) {
+    return system.component(id)->getValue();
+  }
+};
+
+class FunctionalTest : public ::testing::Test {
+protected:
+  Machine *cycleAccurate = nullptr;
+  Machine *functional = nullptr;
+
+  void SetUp() override {
+    cycleAccurate = new Machine(BackPlane::CycleAccurate);
+    functional = new Machine(BackPlane::Functional);
+  }
+
+  void TearDown() override {
+    delete cycleAccurate;
+    delete functional;
+  }
+
+  void compare() {
+    for (auto id : { GP_A, GP_B, GP_C, GP_D, PC, SP, Si, Di, TX, MEMADDR }) {
+      ASSERT_EQ(functional->reg(id), cycleAccurate->reg(id)) << "Register " << id;
+    }
+    ASSERT_EQ(functional->system.bus().flags(), cycleAccurate->system.bus().flags());
+    ASSERT_EQ(functional->system.bus().halt(), cycleAccurate->system.bus().halt());
+    ASSERT_EQ(functional->output, cycleAccurate->output);
+    ASSERT_EQ(functional->reads, cycleAccurate->reads);
+    auto m1 = functional->system.memory();
+    auto m2 = cycleAccurate->system.memory();
+    for (word addr = DATA_START; addr < DATA_START + 0x40; addr++) {
+      ASSERT_EQ((*m1)[addr], (*m2)[addr]) << "Address " << addr;
+    }
+    for (word addr = STACK_START; addr < STACK_START + 0x10; addr++) {
+      ASSERT_EQ((*m1)[addr], (*m2)[addr]) << "Address " << addr;
+    }
+  }
+};
+
+TEST_F(FunctionalTest, matchesCycleAccurate) {
+  cycleAccurate->system.run(PROGRAM_START);
+  functional->system.run(PROGRAM_START);
+  ASSERT_EQ(cycleAccurate->system.error(), NoError);
+  ASSERT_EQ(functional->system.error(), NoError);
+  ASSERT_EQ(functional->system.bus().halt(), false);
+  compare();
+  ASSERT_EQ(functional->system.cycles(), cycleAccurate->system.cycles());
+}
+
+TEST_F(FunctionalTest, defaultImage) {
+  cycleAccurate->system.run();
+  functional->system.run();
+  compare();
+  ASSERT_EQ(functional->system.cycles(), cycleAccurate->system.cycles());
+}
+
+TEST_F(FunctionalTest, nmi) {
+  cycleAccurate->nmiAtRead = 5;
+  functional->nmiAtRead = 5;
+  cycleAccurate->system.run(PROGRAM_START);
+  functional->system.run(PROGRAM_START);
+  ASSERT_EQ(cycleAccurate->system.error(), NoError);
+  ASSERT_EQ(functional->system.error(), NoError);
+  ASSERT_NE(std::find(functional->output.begin(), functional->output.end(), 0x55), functional->output.end());
+  compare();
+  ASSERT_EQ(functional->system.cycles(), cycleAccurate->system.cycles());
+}
+
+TEST_F(FunctionalTest, resumeAfterBreak) {
+  cycleAccurate->system.run(PROGRAM_START);
+
+  // Single-step into the middle of the CALL instruction and then let the
+  // functional engine take over:
+  functional->system.setRunMode(SystemBus::BreakAtClock);
+  functional->system.run(PROGRAM_START);
+  for (int ix = 0; ix < 26; ix++) {
+    functional->system.run(0xFFFF);
+  }
+  ASSERT_GT(functional->system.controller()->getStep(), 2);
+  functional->system.setRunMode(SystemBus::Continuous);
+  functional->system.run(0xFFFF);
+  ASSERT_EQ(functional->system.error(), NoError);
+  compare();
+}
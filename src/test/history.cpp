@@ -0,0 +1,182 @@
+/*
+ * Copyright (c) 2021, Jan de Visser <jan@finiandarcy.com>
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include <utility>
+
+#include "backplanetest.h"
+
+const byte history_program[] = {
+  /* 1000 */ MOV_SP_CONST, 0x00, 0x80,
+  /* 1003 */ MOV_DI_CONST, 0x00, 0x20,
+  /* 1006 */ MOV_A_CONST, 0x10,
+  /* 1008 */ MOV__DI_A,
+  /* 1009 */ PUSH_A,
+  /* 100A */ POP_B,
+  /* 100B */ DEC_A,
+  /* 100C */ JNZ, 0x08, 0x10,
+  /* 100F */ HLT,
+};
+
+class HistoryTest : public BackPlaneTest {
+protected:
+  HistoryTest()
+    : BackPlaneTest(history_program) {
+  }
+
+  void SetUp() override {
+    BackPlaneTest::SetUp();
+    setPC(PROGRAM_START);
+  }
+
+  static std::vector<int> state(BackPlane* s) {
+    std::vector<int> ret;
+    for (int ix : { GP_A, GP_B, GP_C, GP_D, PC, SP, Si, Di, TX }) {
+      ret.push_back(s->component(ix)->getValue());
+    }
+    ret.push_back(s->bus().flags());
+    ret.push_back(s->controller()->getStep());
+    for (word addr = 0x2000; addr < 0x2010; addr++) {
+      ret.push_back(std::as_const(*s->memory())[addr]);
+    }
+    ret.push_back(std::as_const(*s->memory())[0x8000]);
+    return ret;
+  }
+
+  // The state at every instruction boundary of a run single-stepped from
+  // the start:
+  static std::vector<std::vector<int>> reference() {
+    BackPlane s;
+    s.defaultSetup();
+    s.setFreeRunning(true);
+    load(s, history_program, sizeof(history_program));
+    setPC(s, PROGRAM_START);
+    s.setRunMode(SystemBus::BreakAtClock);
+    std::vector<std::vector<int>> ret;
+    ret.push_back(state(&s));
+    while (true) {
+      auto instructions = s.controller()->instructions();
+      s.run(0xFFFF);
+      EXPECT_EQ(s.error(), NoError);
+      if (!s.bus().halt() || (s.error() != NoError)) {
+        break;
+      }
+      if (s.controller()->instructions() != instructions) {
+        ret.push_back(state(&s));
+      }
+    }
+    return ret;
+  }
+
+  void runToEnd(BackPlane::Engine engine) {
+    system->setEngine(engine);
+    system->setRunMode(SystemBus::Continuous);
+    system->run(0xFFFF);
+    ASSERT_EQ(system->error(), NoError);
+    ASSERT_FALSE(system->bus().halt());
+    ASSERT_EQ(system->component(GP_B)->getValue(), 0x01);
+  }
+};
+
+TEST_F(HistoryTest, stepBack) {
+  auto expected = reference();
+  for (auto engine : { BackPlane::CycleAccurate, BackPlane::Functional }) {
+    system->enableHistory(4);
+    runToEnd(engine);
+    auto final = state(system);
+    ASSERT_EQ(system->history()->position(), expected.size() - 1);
+
+    for (auto ix = expected.size(); ix > 0; ix--) {
+      ASSERT_TRUE(system->stepBack());
+      ASSERT_EQ(state(system), expected[ix - 1]);
+    }
+    ASSERT_FALSE(system->stepBack());
+    ASSERT_EQ(state(system), expected[0]);
+
+    // The machine runs forward again from where it was put back:
+    runToEnd(engine);
+    ASSERT_EQ(state(system), final);
+    ASSERT_EQ(system->history()->position(), expected.size() - 1);
+    ASSERT_FALSE(system->stepBack(1000));
+    ASSERT_EQ(state(system), expected[0]);
+    system->disableHistory();
+  }
+}
+
+TEST_F(HistoryTest, stepBackPartway) {
+  auto expected = reference();
+  system->enableHistory(4);
+  runToEnd(BackPlane::Functional);
+  ASSERT_TRUE(system->stepBack(20));
+  ASSERT_EQ(state(system), expected[expected.size() - 20]);
+
+  // Single-step a few cycles into the next instruction. Stepping back one
+  // instruction returns to its start:
+  auto position = system->history()->position();
+  system->setRunMode(SystemBus::BreakAtClock);
+  for (int ix = 0; ix < 3; ix++) {
+    system->run(0xFFFF);
+  }
+  ASSERT_GT(system->controller()->getStep(), 2);
+  ASSERT_EQ(system->history()->position(), position);
+  ASSERT_TRUE(system->stepBack());
+  ASSERT_EQ(state(system), expected[expected.size() - 20]);
+  ASSERT_TRUE(system->stepBack(3));
+  ASSERT_EQ(state(system), expected[expected.size() - 23]);
+}
+
+TEST_F(HistoryTest, reverseContinue) {
+  system->enableHistory(8);
+  runToEnd(BackPlane::Functional);
+  ASSERT_EQ(std::as_const(*system->memory())[0x200F], 0x01);
+
+  system->breakpoints().set(PROGRAM_START + 8);
+  ASSERT_TRUE(system->reverseContinue());
+  ASSERT_EQ(system->component(PC)->getValue(), PROGRAM_START + 8);
+  ASSERT_EQ(system->component(Di)->getValue(), 0x200F);
+  ASSERT_EQ(system->component(GP_A)->getValue(), 0x01);
+  ASSERT_EQ(std::as_const(*system->memory())[0x200F], 0x00);
+  ASSERT_EQ(std::as_const(*system->memory())[0x200E], 0x02);
+
+  ASSERT_TRUE(system->reverseContinue());
+  ASSERT_EQ(system->component(Di)->getValue(), 0x200E);
+  ASSERT_EQ(std::as_const(*system->memory())[0x200E], 0x00);
+
+  system->breakpoints().clear(PROGRAM_START + 8);
+  ASSERT_FALSE(system->reverseContinue());
+  ASSERT_EQ(system->component(PC)->getValue(), PROGRAM_START);
+  ASSERT_EQ(std::as_const(*system->memory())[0x2000], 0x00);
+
+  runToEnd(BackPlane::CycleAccurate);
+  ASSERT_EQ(std::as_const(*system->memory())[0x200F], 0x01);
+}
+
+TEST_F(HistoryTest, lastWrite) {
+  auto history = system->enableHistory();
+  runToEnd(BackPlane::CycleAccurate);
+
+  unsigned long instruction;
+  ASSERT_TRUE(history->lastWrite(0x2005, instruction));
+  ASSERT_EQ(history->record(instruction).pc, PROGRAM_START + 8);
+  ASSERT_EQ(history->record(instruction).di, 0x2005);
+  ASSERT_TRUE(history->lastWrite(0x8000, instruction));
+  ASSERT_EQ(history->record(instruction).pc, PROGRAM_START + 9);
+  ASSERT_EQ(history->record(instruction).gp[GP_A], 0x01);
+  ASSERT_FALSE(history->lastWrite(0x3000, instruction));
+}
+
+TEST_F(HistoryTest, trim) {
+  auto expected = reference();
+  auto history = system->enableHistory(4, 2);
+  runToEnd(BackPlane::Functional);
+  ASSERT_EQ(history->checkpoints(), 2);
+  auto first = history->first();
+  ASSERT_GT(first, 0);
+  ASSERT_LE(history->position() - first, 8);
+
+  ASSERT_FALSE(system->stepBack(1000));
+  ASSERT_EQ(history->position(), first);
+  ASSERT_EQ(state(system), expected[first]);
+}
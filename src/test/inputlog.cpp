@@ -0,0 +1,188 @@
+/*
+ * Copyright (c) 2021, Jan de Visser <jan@finiandarcy.com>
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include <algorithm>
+#include <cstdio>
+#include <gtest/gtest.h>
+#include <vector>
+
+#include "cpu/backplane.h"
+#include "cpu/inputlog.h"
+#include "cpu/iochannel.h"
+#include "cpu/opcodes.h"
+
+constexpr word PROGRAM_START = 0x1000;
+constexpr word DATA_START = 0x2000;
+
+const byte input_program[] = {
+  /* 1000 */ MOV_SP_CONST, 0x00, 0x80,
+  /* 1003 */ NMIVEC, 0x40, 0x10,
+  /* 1006 */ MOV_DI_CONST, 0x00, 0x20,
+  /* 1009 */ MOV_SI_CONST, 0x10, 0x00,
+  /* 100C */ IN_A, 0x02,
+  /* 100E */ CMP_A_CONST, 0xFF,
+  /* 1010 */ JZ, 0x0C, 0x10,
+  /* 1013 */ MOV__DI_A,
+  /* 1014 */ DEC_SI,
+  /* 1015 */ JNZ, 0x0C, 0x10,
+  /* 1018 */ HLT,
+  /* 1019 */ NOP, NOP, NOP, NOP, NOP, NOP, NOP,
+  /* 1020 */ NOP, NOP, NOP, NOP, NOP, NOP, NOP, NOP,
+  /* 1028 */ NOP, NOP, NOP, NOP, NOP, NOP, NOP, NOP,
+  /* 1030 */ NOP, NOP, NOP, NOP, NOP, NOP, NOP, NOP,
+  /* 1038 */ NOP, NOP, NOP, NOP, NOP, NOP, NOP, NOP,
+  /* 1040 */ PUSH_A,
+  /* 1041 */ MOV_A_CONST, 0x55,
+  /* 1043 */ OUT_A, 0x01,
+  /* 1045 */ POP_A,
+  /* 1046 */ RTI,
+};
+
+class Machine {
+public:
+  BackPlane system;
+  std::vector<byte> output;
+  int reads = 0;
+
+  explicit Machine(BackPlane::Engine engine) {
+    system.defaultSetup();
+    system.setFreeRunning(true);
+    system.setEngine(engine);
+    system.insertIO(new IOChannel(0x1, "OUT", [this](byte value) {
+      output.push_back(value);
+    }));
+  }
+
+  // A keyboard which is mostly idle, and raises NMIs now and then:
+  void connectKeyboard() {
+    system.insertIO(new IOChannel(0x2, "IN", [this]() -> byte {
+      reads++;
+      if ((reads % 37) == 0) {
+        system.inputLog()->nmi();
+      }
+      if ((reads % 53) == 0) {
+        system.bus().setNmi();
+      }
+      return ((reads % 5) == 0) ? (byte)reads : 0xFF;
+    }));
+    auto mem = system.memory();
+    for (word ix = 0; ix < sizeof(input_program); ix++) {
+      (*mem)[PROGRAM_START + ix] = input_program[ix];
+    }
+    dynamic_cast<AddressRegister*>(system.component(PC))->setValue(PROGRAM_START);
+  }
+
+  std::vector<int> state() {
+    std::vector<int> ret;
+    for (int ix : { GP_A, GP_B, GP_C, GP_D, PC, SP, Si, Di }) {
+      ret.push_back(system.component(ix)->getValue());
+    }
+    ret.push_back(system.bus().flags());
+    ret.push_back(system.bus().halt());
+    for (word addr = DATA_START; addr < DATA_START + 0x10; addr++) {
+      ret.push_back(std::as_const(*system.memory())[addr]);
+    }
+    return ret;
+  }
+};
+
+class InputLogTest : public ::testing::Test {
+protected:
+  std::string path;
+
+  // Tests may run in parallel, so every test gets a file of its own:
+  void SetUp() override {
+    path = testing::TempDir() + "inputlog_" + testing::UnitTest::GetInstance()->current_test_info()->name() + ".jv80";
+  }
+
+  void TearDown() override {
+    remove(path.c_str());
+  }
+};
+
+TEST_F(InputLogTest, replay) {
+  for (auto recordEngine : { BackPlane::CycleAccurate, BackPlane::Functional }) {
+    Machine recorder(recordEngine);
+    recorder.connectKeyboard();
+    auto log = recorder.system.recordInput();
+    recorder.system.run(0xFFFF);
+    ASSERT_EQ(recorder.system.error(), NoError);
+    ASSERT_FALSE(recorder.system.bus().halt());
+    ASSERT_GT(recorder.reads, 53);
+    ASSERT_GE(std::count(recorder.output.begin(), recorder.output.end(), 0x55), 2);
+    ASSERT_TRUE(log->save(path));
+
+    // The program reads the idle keyboard most of the time, which is not
+    // logged:
+    ASSERT_LT(log->events().size(), recorder.reads / 2);
+
+    for (auto replayEngine : { BackPlane::CycleAccurate, BackPlane::Functional }) {
+      Machine replayer(replayEngine);
+      ASSERT_TRUE(replayer.system.replayInput(path));
+      ASSERT_EQ(replayer.system.component(PC)->getValue(), PROGRAM_START);
+      replayer.system.run(0xFFFF);
+      ASSERT_EQ(replayer.system.error(), NoError);
+      ASSERT_EQ(replayer.state(), recorder.state());
+      ASSERT_EQ(replayer.output, recorder.output);
+      ASSERT_TRUE(replayer.system.inputLog()->finished());
+      ASSERT_FALSE(replayer.system.inputLog()->diverged());
+    }
+  }
+}
+
+TEST_F(InputLogTest, stopsWhereRecordingStopped) {
+  Machine recorder(BackPlane::CycleAccurate);
+  recorder.connectKeyboard();
+  auto log = recorder.system.recordInput();
+  recorder.system.setRunMode(SystemBus::BreakAtClock);
+  for (int ix = 0; ix < 1000; ix++) {
+    recorder.system.run(0xFFFF);
+  }
+  ASSERT_TRUE(recorder.system.bus().halt());
+  ASSERT_EQ(log->cycle(), 1000);
+  ASSERT_TRUE(log->save(path));
+
+  Machine replayer(BackPlane::CycleAccurate);
+  ASSERT_TRUE(replayer.system.replayInput(path));
+  replayer.system.run(0xFFFF);
+  ASSERT_EQ(replayer.system.inputLog()->cycle(), 1000);
+  ASSERT_EQ(replayer.state(), recorder.state());
+  ASSERT_EQ(replayer.system.controller()->getStep(), recorder.system.controller()->getStep());
+
+  // After the end of the recording the machine runs on without input:
+  replayer.system.run(0xFFFF);
+  ASSERT_GT(replayer.system.inputLog()->cycle(), 1000);
+}
+
+TEST_F(InputLogTest, diverged) {
+  Machine recorder(BackPlane::Functional);
+  recorder.connectKeyboard();
+  auto log = recorder.system.recordInput();
+  recorder.system.run(0xFFFF);
+  ASSERT_TRUE(log->save(path));
+
+  Machine replayer(BackPlane::Functional);
+  ASSERT_TRUE(replayer.system.replayInput(path));
+
+  // Without an NMI vector the NMIs are dropped, so the program reads the
+  // keyboard at other cycles than it did when recording:
+  for (word addr = PROGRAM_START + 3; addr < PROGRAM_START + 6; addr++) {
+    (*replayer.system.memory())[addr] = NOP;
+  }
+  replayer.system.run(0xFFFF);
+  ASSERT_TRUE(replayer.system.inputLog()->diverged());
+  ASSERT_TRUE(replayer.output.empty());
+}
+
+TEST_F(InputLogTest, malformed) {
+  Machine machine(BackPlane::Functional);
+  ASSERT_FALSE(machine.system.replayInput(path));
+  FILE* f = fopen(path.c_str(), "w");
+  fputs("JV80INP1 but not much else", f);
+  fclose(f);
+  ASSERT_FALSE(machine.system.replayInput(path));
+  ASSERT_EQ(machine.system.inputLog(), nullptr);
+}
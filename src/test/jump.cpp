@@ -264,3 +264,25 @@ TEST_F(TESTNAME, nmi) {
   ASSERT_EQ(si -> getValue(), 0x3534);
   ASSERT_EQ(di -> getValue(), 0x3736);
 }
+
+const byte asm_nmi_no_vector[] = {
+  /* 8000 */ MOV_A_CONST, 0x30,        //  4 cycles
+  /* 8002 */ NOP,                      //  2 cycles
+             // NMI ignored            //  1 cycle
+  /* 8003 */ MOV_B_CONST, 0x31,        //  4 cycles
+  /* 8005 */ HLT,                      //  3 cycles
+};                                     // Total: 14
+
+TEST_F(TESTNAME, nmiWithoutVector) {
+  mem -> initialize(ROM_START, 6, asm_nmi_no_vector);
+  pc -> setValue(START_VECTOR);
+
+  // Without an NMI vector the NMI is dropped and execution continues:
+  nmiAt = 0x8002;
+  auto cycles = system -> run();
+  ASSERT_EQ(system -> error(), NoError);
+  ASSERT_EQ(cycles, 14);
+  ASSERT_EQ(system -> bus().halt(), false);
+  ASSERT_EQ(gp_a -> getValue(), 0x30);
+  ASSERT_EQ(gp_b -> getValue(), 0x31);
+}
@@ -98,3 +98,25 @@ TEST_F(MemoryTest, writeROM) {
   ASSERT_EQ(err, ProtectedMemory);
   ASSERT_EQ((*mem)[0x8001], 0x77);
 }
+
+TEST_F(MemoryTest, unalignedBank) {
+  byte init[0x20] = { 0x11, 0x22 };
+  ASSERT_TRUE(mem->add(0x3010, 0x20, true, init));
+  ASSERT_FALSE(mem->isMapped(0x300F));
+  ASSERT_TRUE(mem->inRAM(0x3010));
+  ASSERT_FALSE(mem->inROM(0x3010));
+  ASSERT_EQ((*mem)[0x3011], 0x22);
+  (*mem)[0x302F] = 0x33;
+  ASSERT_EQ((*mem)[0x302F], 0x33);
+  ASSERT_FALSE(mem->isMapped(0x3030));
+}
+
+TEST_F(MemoryTest, removeBank) {
+  ASSERT_TRUE(mem->inRAM(0x1000));
+  auto bank = mem->bank(0x1000);
+  ASSERT_TRUE(mem->remove(bank));
+  ASSERT_FALSE(mem->isMapped(0x0000));
+  ASSERT_FALSE(mem->isMapped(0x1000));
+  ASSERT_TRUE(mem->inROM(0x8000));
+  ASSERT_EQ((*mem)[0x8001], 0x77);
+}
@@ -0,0 +1,106 @@
+/*
+ * Copyright (c) 2021, Jan de Visser <jan@finiandarcy.com>
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include <sstream>
+
+#include "backplanetest.h"
+#include "cpu/memoryprofile.h"
+
+const byte memoryprofile_program[] = {
+  /* 1000 */ MOV_SP_CONST, 0x00, 0x80,
+  /* 1003 */ MOV_A_CONST, 0x42,
+  /* 1005 */ PUSH_A,
+  /* 1006 */ CALL, 0x10, 0x10,
+  /* 1009 */ POP_A,
+  /* 100A */ MOV_DI_CONST, 0x00, 0x20,
+  /* 100D */ MOV__DI_A,
+  /* 100E */ HLT,
+  /* 100F */ NOP,
+  /* 1010 */ RET,
+};
+
+class MemoryProfileTest : public BackPlaneTest {
+protected:
+  MemoryProfileTest()
+    : BackPlaneTest(memoryprofile_program) {
+  }
+
+  MemoryProfile* run(BackPlane::Engine engine) {
+    system->setEngine(engine);
+    auto profile = system->enableMemoryProfile();
+    system->run(PROGRAM_START);
+    EXPECT_EQ(system->error(), NoError);
+    return profile;
+  }
+};
+
+TEST_F(MemoryProfileTest, accesses) {
+  auto profile = run(BackPlane::CycleAccurate);
+  ASSERT_EQ(profile->reads[0x1000], 1);
+  ASSERT_EQ(profile->reads[0x1010], 1);
+  ASSERT_EQ(profile->writes[0x1000], 0);
+  ASSERT_EQ(profile->writes[0x2000], 1);
+  ASSERT_EQ(profile->writes[0x8000], 1);
+  ASSERT_EQ(profile->writes[0x8001], 1);
+  ASSERT_EQ(profile->writes[0x8002], 1);
+  ASSERT_EQ(profile->reads[0x8000], 1);
+  ASSERT_EQ(profile->reads[0x8002], 1);
+
+  auto code = profile->usage(0x1000, 0x100);
+  ASSERT_EQ(code.lowest, 0x1000);
+  ASSERT_EQ(code.highest, 0x1010);
+  ASSERT_EQ(code.writes, 0);
+  ASSERT_EQ(code.touched, sizeof(memoryprofile_program) - 1);
+}
+
+TEST_F(MemoryProfileTest, stack) {
+  auto profile = run(BackPlane::CycleAccurate);
+  ASSERT_TRUE(profile->stackUsed);
+  ASSERT_EQ(profile->highWater, 0x8002);
+  ASSERT_EQ(profile->overflows, 0);
+  ASSERT_EQ(profile->underflows, 0);
+
+  system->reset();
+  profile->setStack(0x8001, 2);
+  system->run(PROGRAM_START);
+  ASSERT_EQ(profile->highWater, 0x8002);
+  ASSERT_EQ(profile->overflows, 0);
+  ASSERT_EQ(profile->underflows, 2);
+
+  std::stringstream ss;
+  profile->writeStack(ss);
+  ASSERT_EQ(ss.str(), "Stack 8001-8002 high water 8002 (2 of 2 bytes), 0 overflows, 2 underflows\n");
+}
+
+TEST_F(MemoryProfileTest, functionalMatchesCycleAccurate) {
+  auto profile = run(BackPlane::CycleAccurate);
+  auto reads = profile->reads;
+  auto writes = profile->writes;
+  auto highWater = profile->highWater;
+  system->disableMemoryProfile();
+  system->reset();
+  profile = run(BackPlane::Functional);
+  ASSERT_EQ(profile->reads, reads);
+  ASSERT_EQ(profile->writes, writes);
+  ASSERT_EQ(profile->highWater, highWater);
+}
+
+TEST_F(MemoryProfileTest, heatmap) {
+  auto profile = run(BackPlane::CycleAccurate);
+  std::stringstream ss;
+  profile->writeHeatmap(ss);
+  std::string line;
+  std::getline(ss, line);
+  std::getline(ss, line);
+  ASSERT_TRUE(line.starts_with("1000")) << line;
+  std::getline(ss, line);
+  ASSERT_TRUE(line.starts_with("2000")) << line;
+  ASSERT_TRUE(line.ends_with("1")) << line;
+  std::getline(ss, line);
+  ASSERT_TRUE(line.starts_with("8000")) << line;
+  ASSERT_TRUE(line.ends_with("3")) << line;
+  ASSERT_FALSE(std::getline(ss, line));
+}
@@ -0,0 +1,147 @@
+/*
+ * Copyright (c) 2021, Jan de Visser <jan@finiandarcy.com>
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include <sstream>
+
+#include "backplanetest.h"
+#include "cpu/profiler.h"
+
+const byte profiler_program[] = {
+  /* 1000 */ MOV_DI_CONST, 0x00, 0x20,
+  /* 1003 */ MOV_SI_CONST, 0x08, 0x00,
+  /* 1006 */ MOV_A_CONST, 0x5A,
+  /* 1008 */ MOV__DI_A,
+  /* 1009 */ DEC_SI,
+  /* 100A */ JNZ, 0x08, 0x10,
+  /* 100D */ HLT,
+};
+
+const char* profiler_symbols =
+  "# Labels of profiler_program\n"
+  "0x1000 start\n"
+  "loop = 1008\n"
+  "\n"
+  "done: $100D\n";
+
+class ProfilerTest : public BackPlaneTest {
+protected:
+  ProfilerTest()
+    : BackPlaneTest(profiler_program) {
+  }
+
+  void run(BackPlane::Engine engine, Profiler& profiler) {
+    system->setEngine(engine);
+    system->profileTo(&profiler);
+    system->run(PROGRAM_START);
+    system->profileTo(nullptr);
+    EXPECT_EQ(system->error(), NoError);
+  }
+};
+
+TEST_F(ProfilerTest, interval) {
+  Profiler profiler(Profiler::Cycles, 10);
+  ASSERT_EQ(profiler.due(9), 0);
+  ASSERT_EQ(profiler.due(), 1);
+  ASSERT_EQ(profiler.due(25), 2);
+  ASSERT_EQ(profiler.due(5), 1);
+}
+
+TEST_F(ProfilerTest, instructions) {
+  Profiler profiler(Profiler::Instructions, 1);
+  run(BackPlane::CycleAccurate, profiler);
+
+  // After an instruction the PC points to the next one:
+  ASSERT_EQ(profiler.samples(0x1000), 0);
+  ASSERT_EQ(profiler.samples(0x1003), 1);
+  ASSERT_EQ(profiler.samples(0x1008), 8);
+  ASSERT_EQ(profiler.samples(0x1009), 8);
+  ASSERT_EQ(profiler.samples(0x100A), 8);
+  ASSERT_EQ(profiler.samples(0x100D), 1);
+  ASSERT_EQ(profiler.samples(), system->instructions());
+}
+
+TEST_F(ProfilerTest, functionalMatchesCycleAccurate) {
+  Profiler expected(Profiler::Instructions, 1);
+  run(BackPlane::CycleAccurate, expected);
+  system->reset();
+  Profiler profiler(Profiler::Instructions, 1);
+  run(BackPlane::Functional, profiler);
+
+  for (int pc = 0; pc < 0x10000; pc++) {
+    ASSERT_EQ(profiler.samples(pc), expected.samples(pc)) << "PC " << pc;
+  }
+}
+
+TEST_F(ProfilerTest, cycles) {
+  for (auto engine : { BackPlane::CycleAccurate, BackPlane::Functional }) {
+    system->reset();
+    Profiler profiler(Profiler::Cycles, 1);
+    run(engine, profiler);
+    ASSERT_EQ(profiler.samples(), (system->cycles() + 1) / 2) << "Engine " << engine;
+    unsigned long loop = 0;
+    for (word pc = 0x1008; pc < 0x100D; pc++) {
+      loop += profiler.samples(pc);
+    }
+    ASSERT_GT(2 * loop, profiler.samples()) << "Engine " << engine;
+  }
+}
+
+TEST_F(ProfilerTest, symbols) {
+  SymbolTable symbols;
+  std::istringstream is(profiler_symbols);
+  ASSERT_TRUE(symbols.load(is));
+  ASSERT_EQ(symbols.size(), 3);
+  ASSERT_EQ(symbols.resolve(0x0FFF), nullptr);
+  ASSERT_EQ(symbols.resolve(0x1009)->name, "loop");
+  ASSERT_EQ(symbols.format(0x1008), "loop");
+  ASSERT_EQ(symbols.format(0x100A), "loop+2");
+  ASSERT_EQ(symbols.format(0x2000), "done+4083");
+  ASSERT_EQ(symbols.format(0x0FFF), "0fff");
+
+  std::istringstream bad("start 0x1000 extra\n");
+  ASSERT_FALSE(symbols.load(bad));
+}
+
+TEST_F(ProfilerTest, report) {
+  SymbolTable symbols;
+  std::istringstream is(profiler_symbols);
+  symbols.load(is);
+  Profiler profiler(Profiler::Instructions, 1);
+  run(BackPlane::CycleAccurate, profiler);
+
+  std::stringstream flat;
+  profiler.flatProfile(flat, &symbols);
+  std::string line;
+  std::getline(flat, line);
+  std::getline(flat, line);
+  std::getline(flat, line);
+  ASSERT_TRUE(line.ends_with("loop")) << line;
+  ASSERT_NE(line.find(" 24 "), std::string::npos) << line;
+
+  std::stringstream hot;
+  profiler.hotRanges(hot, &symbols);
+  std::getline(hot, line);
+  std::getline(hot, line);
+  ASSERT_TRUE(line.starts_with("1003-100d")) << line;
+  ASSERT_TRUE(line.ends_with("start+3")) << line;
+}
+
+TEST_F(ProfilerTest, hotRangeGap) {
+  Profiler profiler(Profiler::Instructions, 1);
+  profiler.sample(0x1000, 3);
+  profiler.sample(0x1004, 2);
+  profiler.sample(0x1007, 2);
+
+  // Only samples less than <gap> bytes apart are joined:
+  std::stringstream hot;
+  profiler.hotRanges(hot, nullptr, 10, 4);
+  std::string line;
+  std::getline(hot, line);
+  std::getline(hot, line);
+  ASSERT_TRUE(line.starts_with("1004-1007           4")) << line;
+  std::getline(hot, line);
+  ASSERT_TRUE(line.starts_with("1000-1000           3")) << line;
+}
@@ -50,3 +50,86 @@ TEST_F(RegisterTest, dontGetWhenOtherRegAddressed) {
   system -> cycle(false, true, true, 2, 1, 0, 0x37);
   ASSERT_EQ(system->bus().readDataBus(), 0x37);
 }
+
+class PhaseCounter : public Register {
+public:
+  bool notify;
+  int rising = 0;
+  int low = 0;
+
+  PhaseCounter(int id, bool n) : Register(id), notify(n) {}
+  bool alwaysNotify() const override { return notify; }
+  int clockPhases() const override { return OnRisingClockEdge | OnHighClock | OnLowClock; }
+
+  SystemError onRisingClockEdge() override {
+    rising++;
+    return Register::onRisingClockEdge();
+  }
+
+  SystemError onLowClock() override {
+    low++;
+    return Register::onLowClock();
+  }
+};
+
+TEST(Dispatch, onlyAddressedComponentsNotified) {
+  auto src = new PhaseCounter(1, false);
+  auto target = new PhaseCounter(2, false);
+  auto other = new PhaseCounter(3, false);
+  auto always = new PhaseCounter(4, true);
+  Harness system;
+  for (auto c : { src, target, other, always }) {
+    system.insert(c);
+  }
+  src -> setValue(0x42);
+  system.cycle(false, true, true, 1, 2, 0);
+  ASSERT_EQ(target -> getValue(), 0x42);
+  ASSERT_EQ(src -> rising, 1);
+  ASSERT_EQ(target -> low, 1);
+  ASSERT_EQ(other -> rising, 0);
+  ASSERT_EQ(other -> low, 0);
+  ASSERT_EQ(always -> rising, 1);
+  ASSERT_EQ(always -> low, 1);
+}
+
+TEST(Dispatch, undeclaredPhasesSkipped) {
+  class HighOnly : public PhaseCounter {
+  public:
+    HighOnly() : PhaseCounter(2, true) {}
+    int clockPhases() const override { return OnHighClock; }
+  };
+  auto src = new Register(1);
+  auto target = new HighOnly();
+  Harness system;
+  system.insert(src);
+  system.insert(target);
+  src -> setValue(0x42);
+  system.cycle(false, true, true, 1, 2, 0);
+  ASSERT_EQ(target -> getValue(), 0x42);
+  ASSERT_EQ(target -> rising, 0);
+  ASSERT_EQ(target -> low, 0);
+}
+
+class EventCounter : public ComponentListener {
+public:
+  int count = 0;
+  void componentEvent(Component const*, int) override { count++; }
+};
+
+TEST(Events, eventMask) {
+  Register reg(1);
+  EventCounter listener;
+  reg.setListener(&listener, Component::eventBit(Component::EV_VALUECHANGED));
+  reg.setValue(2);
+  ASSERT_EQ(listener.count, 1);
+  reg.setEventMask(0);
+  reg.setValue(3);
+  ASSERT_EQ(listener.count, 1);
+  reg.setEventMask(Component::ALL_EVENTS);
+  reg.setValue(4);
+  ASSERT_EQ(listener.count, 2);
+  reg.setListener(nullptr);
+  ASSERT_EQ(reg.eventMask(), 0u);
+  reg.setValue(5);
+  ASSERT_EQ(listener.count, 2);
+}
@@ -0,0 +1,110 @@
+/*
+ * Copyright (c) 2021, Jan de Visser <jan@finiandarcy.com>
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include <thread>
+
+#include "backplanetest.h"
+#include "cpu/snapshot.h"
+
+const byte fill_program[] = {
+  /* 1000 */ MOV_DI_CONST, 0x00, 0x20,
+  /* 1003 */ MOV_SI_CONST, 0x00, 0x08,
+  /* 1006 */ MOV_A_CONST, 0x5A,
+  /* 1008 */ MOV__DI_A,
+  /* 1009 */ DEC_SI,
+  /* 100A */ JNZ, 0x08, 0x10,
+  /* 100D */ HLT,
+};
+
+class SnapshotTest : public BackPlaneTest {
+protected:
+  SnapshotTest()
+    : BackPlaneTest(fill_program) {
+  }
+
+  void SetUp() override {
+    BackPlaneTest::SetUp();
+    system->enableSnapshots();
+  }
+
+  void check(const MachineState* state) {
+    ASSERT_NE(state, nullptr);
+    for (auto id : { GP_A, GP_B, GP_C, GP_D, PC, SP, Si, Di, TX }) {
+      ASSERT_EQ(state->registers[id], system->component(id)->getValue()) << "Register " << id;
+    }
+    ASSERT_EQ(state->registers[MEMADDR], system->memory()->getValue());
+    ASSERT_EQ(state->flags, system->bus().flags());
+    ASSERT_EQ(state->halt, system->bus().halt());
+    auto mem = system->memory();
+    for (word addr = 0x2000; addr < 0x2900; addr++) {
+      ASSERT_EQ(state->memory[addr], (*mem)[addr]) << "Address " << addr;
+    }
+  }
+};
+
+TEST_F(SnapshotTest, disabledByDefault) {
+  BackPlane other;
+  other.defaultSetup();
+  ASSERT_EQ(other.snapshot(), nullptr);
+}
+
+TEST_F(SnapshotTest, cycleAccurate) {
+  system->run(PROGRAM_START);
+  ASSERT_EQ(system->error(), NoError);
+  auto state = system->snapshot();
+  check(state);
+  ASSERT_EQ(state->memory[0x27FF], 0x5A);
+  ASSERT_EQ(state->halt, false);
+}
+
+TEST_F(SnapshotTest, functional) {
+  system->setEngine(BackPlane::Functional);
+  system->run(PROGRAM_START);
+  ASSERT_EQ(system->error(), NoError);
+  check(system->snapshot());
+}
+
+TEST_F(SnapshotTest, pollWhileRunning) {
+  std::atomic<bool> done = false;
+  unsigned long last = 0;
+  int polls = 0;
+  std::thread reader([this, &done, &last, &polls]() {
+    while (!done) {
+      if (auto state = system->snapshot(); state) {
+        ASSERT_GE(state->sequence, last);
+        last = state->sequence;
+        polls++;
+      }
+    }
+  });
+  system->run(PROGRAM_START);
+  done = true;
+  reader.join();
+  ASSERT_GT(polls, 0);
+  auto state = system->snapshot();
+  ASSERT_GT(state->sequence, 2u);
+  check(state);
+}
+
+TEST(SnapshotBuffer, copiesDirtyPages) {
+  Memory memory(0x0000, 0x1000, 0x1000, 0x1000);
+  SnapshotBuffer buffer;
+  for (int ix = 0; ix < 3; ix++) {
+    buffer.publish(memory);
+  }
+  memory[0x0123] = 0x42;
+  memory.markDirty(0x0123);
+  memory[0x0456] = 0x37;
+  buffer.publish(memory);
+  auto state = buffer.latest();
+  ASSERT_NE(state, nullptr);
+  ASSERT_EQ(state->memory[0x0123], 0x42);
+  ASSERT_EQ(state->memory[0x0456], 0x00);
+  ASSERT_EQ(state->memory[0x3000], 0xFF);
+  buffer.invalidate();
+  buffer.publish(memory);
+  ASSERT_EQ(buffer.latest()->memory[0x0456], 0x37);
+}
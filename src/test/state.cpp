@@ -0,0 +1,221 @@
+/*
+ * Copyright (c) 2021, Jan de Visser <jan@finiandarcy.com>
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include <cstdio>
+#include <cstring>
+#include <utility>
+
+#include "backplanetest.h"
+#include "cpu/statefile.h"
+
+const byte state_program[] = {
+  /* 1000 */ MOV_SP_CONST, 0x00, 0x80,
+  /* 1003 */ CLR_A,
+  /* 1004 */ CLR_B,
+  /* 1005 */ MOV_C_CONST, 0x01,
+  /* 1007 */ CLR_D,
+  /* 1008 */ MOV_SI_CONST, 0x0A, 0x00,
+  /* 100B */ CALL, 0x20, 0x10,
+  /* 100E */ DEC_SI,
+  /* 100F */ JNZ, 0x0B, 0x10,
+  /* 1012 */ MOV_DI_CONST, 0x00, 0x20,
+  /* 1015 */ MOV__DI_A,
+  /* 1016 */ HLT,
+};
+
+const byte state_subroutine[] = {
+  /* 1020 */ ADD_AB_CD,
+  /* 1021 */ SWP_A_C,
+  /* 1022 */ SWP_B_D,
+  /* 1023 */ RET,
+};
+
+const byte state_rom[] = { 0x01, 0x02, 0x03, 0x04 };
+
+class StateTest : public BackPlaneTest {
+protected:
+  StateTest()
+    : BackPlaneTest(state_program) {
+  }
+
+  void SetUp() override {
+    BackPlaneTest::SetUp();
+    system->memory()->add(0xC000, sizeof(state_rom), false, state_rom);
+    load(state_subroutine, PROGRAM_START + 0x20);
+  }
+
+  // Single-steps into the middle of the CALL instruction in the second
+  // iteration of the loop:
+  void runPartway() {
+    system->setRunMode(SystemBus::BreakAtClock);
+    system->run(PROGRAM_START);
+    for (int ix = 0; ix < 120; ix++) {
+      system->run(0xFFFF);
+    }
+    ASSERT_EQ(system->error(), NoError);
+  }
+
+  static void finish(BackPlane* s, BackPlane::Engine engine) {
+    s->setEngine(engine);
+    s->setRunMode(SystemBus::Continuous);
+    s->run(0xFFFF);
+    ASSERT_EQ(s->error(), NoError);
+    ASSERT_FALSE(s->bus().halt());
+  }
+
+  static std::vector<word> result(BackPlane* s) {
+    std::vector<word> ret;
+    for (int ix : { GP_A, GP_B, GP_C, GP_D, PC, SP, Si, Di }) {
+      ret.push_back(s->component(ix)->getValue());
+    }
+    ret.push_back((*s->memory())[0x2000]);
+    ret.push_back((*s->memory())[0x8000]);
+    ret.push_back((*s->memory())[0x8001]);
+    return ret;
+  }
+};
+
+TEST_F(StateTest, resume) {
+  runPartway();
+  auto state = system->saveState();
+  auto step = system->controller()->getStep();
+  ASSERT_GT(step, 2);
+  finish(system, BackPlane::CycleAccurate);
+  auto expected = result(system);
+  ASSERT_EQ(expected[0], 55);
+
+  for (auto engine : { BackPlane::CycleAccurate, BackPlane::Functional }) {
+    ASSERT_TRUE(system->loadState(state.data(), state.size()));
+    ASSERT_EQ(system->controller()->getStep(), step);
+    ASSERT_TRUE(system->bus().halt());
+    finish(system, engine);
+    ASSERT_EQ(result(system), expected);
+  }
+}
+
+TEST_F(StateTest, rebuildMemory) {
+  runPartway();
+  auto state = system->saveState();
+  finish(system, BackPlane::CycleAccurate);
+  auto expected = result(system);
+
+  // A machine with the same ROM but a different RAM layout:
+  BackPlane other;
+  other.defaultSetup();
+  other.setFreeRunning(true);
+  other.memory()->initialize();
+  other.memory()->add(0x0000, 0x2000);
+  other.memory()->add(0xC000, sizeof(state_rom), false, state_rom);
+  ASSERT_TRUE(other.loadState(state.data(), state.size()));
+  ASSERT_EQ(other.memory()->banks(), system->memory()->banks());
+  ASSERT_EQ((*other.memory())[0xC002], 0x03);
+  finish(&other, BackPlane::Functional);
+  ASSERT_EQ(result(&other), expected);
+}
+
+TEST_F(StateTest, romMismatch) {
+  runPartway();
+  auto state = system->saveState();
+
+  BackPlane other;
+  other.defaultSetup();
+  ASSERT_FALSE(other.loadState(state.data(), state.size()));
+  const byte patched[] = { 0x01, 0x02, 0x03, 0x05 };
+  other.memory()->add(0xC000, sizeof(patched), false, patched);
+  ASSERT_FALSE(other.loadState(state.data(), state.size()));
+
+  state[0] = 'X';
+  ASSERT_FALSE(system->loadState(state.data(), state.size()));
+  ASSERT_FALSE(system->loadState(state.data(), sizeof(StateFileHeader) - 1));
+}
+
+TEST_F(StateTest, malformedSequencer) {
+  runPartway();
+  auto state = system->saveState();
+  auto memory = std::as_const(*system->memory())[0x8000];
+
+  auto patch = [&state](auto change) {
+    auto ret = state;
+    StateFileHeader header;
+    memcpy(&header, ret.data(), sizeof(header));
+    change(header);
+    memcpy(ret.data(), &header, sizeof(header));
+    return ret;
+  };
+  for (auto& bad : {
+         patch([](StateFileHeader& h) { h.sequencer.valid = 2; }),
+         patch([](StateFileHeader& h) { h.sequencer.step = 0xFF; }),
+         patch([](StateFileHeader& h) { h.sequencer.running = (SequencerState::Running)3; }),
+         patch([](StateFileHeader& h) { h.sequencer.complete = 2; }),
+         patch([](StateFileHeader& h) { h.phase = 7; }),
+       }) {
+    (*system->memory())[0x8000] = memory + 1;
+    ASSERT_FALSE(system->loadState(bad.data(), bad.size()));
+
+    // Nothing is restored from a rejected state:
+    ASSERT_EQ(std::as_const(*system->memory())[0x8000], memory + 1);
+  }
+  ASSERT_TRUE(system->loadState(state.data(), state.size()));
+  ASSERT_EQ(std::as_const(*system->memory())[0x8000], memory);
+}
+
+TEST_F(StateTest, malformedBanks) {
+  runPartway();
+  auto state = system->saveState();
+  auto banks = system->memory()->banks();
+  auto memory = std::as_const(*system->memory())[0x8000];
+  ASSERT_EQ(banks.size(), 2);
+  ASSERT_TRUE(banks.begin()->writable());
+
+  auto patch = [&state](auto change) {
+    auto ret = state;
+    StateBankInfo info;
+    memcpy(&info, ret.data() + sizeof(StateFileHeader), sizeof(info));
+    change(info);
+    memcpy(ret.data() + sizeof(StateFileHeader), &info, sizeof(info));
+    return ret;
+  };
+  for (auto& bad : {
+         // The offset wraps around when the size is added:
+         patch([](StateBankInfo& info) { info.offset = ~0ull - 0x10; }),
+         // Runs past the end of the address space:
+         patch([](StateBankInfo& info) { info.start = 0x4001; }),
+         // Overlaps the ROM bank, which is only found out when rebuilding:
+         patch([](StateBankInfo& info) { info.start = 0x0100; }),
+       }) {
+    (*system->memory())[0x8000] = memory + 1;
+    ASSERT_FALSE(system->loadState(bad.data(), bad.size()));
+    ASSERT_EQ(system->memory()->banks(), banks);
+    ASSERT_EQ(std::as_const(*system->memory())[0x8000], memory + 1);
+  }
+  ASSERT_TRUE(system->loadState(state.data(), state.size()));
+  ASSERT_EQ(std::as_const(*system->memory())[0x8000], memory);
+}
+
+TEST_F(StateTest, file) {
+  runPartway();
+  auto path = testing::TempDir() + "state_test.jv80";
+  ASSERT_TRUE(system->saveState(path));
+  finish(system, BackPlane::CycleAccurate);
+  auto expected = result(system);
+
+  {
+    StateFile file(path);
+    ASSERT_TRUE(file.valid());
+    StateFileHeader header;
+    memcpy(&header, file.data(), sizeof(header));
+    ASSERT_EQ(header.banks, system->memory()->banks().size());
+    auto info = (const StateBankInfo*)(file.data() + sizeof(header));
+    for (auto ix = 0u; ix < header.banks; ix++) {
+      ASSERT_EQ(info[ix].offset % STATE_ALIGNMENT, 0);
+    }
+  }
+
+  ASSERT_TRUE(system->loadState(path));
+  finish(system, BackPlane::Functional);
+  ASSERT_EQ(result(system), expected);
+  remove(path.c_str());
+}
@@ -0,0 +1,86 @@
+/*
+ * Copyright (c) 2021, Jan de Visser <jan@finiandarcy.com>
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include <sstream>
+
+#include "backplanetest.h"
+#include "cpu/trace.h"
+
+const byte trace_program[] = {
+  /* 1000 */ MOV_A_CONST, 0x42,
+  /* 1002 */ MOV_B_CONST, 0x37,
+  /* 1004 */ HLT,
+};
+
+class TraceTest : public BackPlaneTest {
+protected:
+  TraceTest()
+    : BackPlaneTest(trace_program) {
+  }
+};
+
+TEST_F(TraceTest, disabledByDefault) {
+  ASSERT_EQ(system->trace(), nullptr);
+  system->run(PROGRAM_START);
+  ASSERT_EQ(system->trace(), nullptr);
+}
+
+TEST_F(TraceTest, recordsEverySystemCycle) {
+  system->enableTrace();
+  system->run(PROGRAM_START);
+  ASSERT_EQ(system->error(), NoError);
+
+  auto trace = system->trace();
+  ASSERT_NE(trace, nullptr);
+  ASSERT_EQ(trace->total(), (system->cycles() + 1) / 2);
+  ASSERT_EQ(trace->size(), trace->total());
+
+  auto& first = (*trace)[0];
+  ASSERT_EQ(first.cycle, 0);
+  ASSERT_EQ(first.pc, PROGRAM_START);
+  ASSERT_EQ(first.step, 0);
+  ASSERT_TRUE(first.lines & CycleRecord::Halt);
+
+  auto& last = (*trace)[trace->size() - 1];
+  ASSERT_EQ(last.cycle, trace->total() - 1);
+  ASSERT_EQ(last.ir, HLT);
+
+  bool seenMovB = false;
+  for (size_t ix = 0; ix < trace->size(); ix++) {
+    auto& r = (*trace)[ix];
+    if ((r.ir == MOV_B_CONST) && (r.putID == GP_B)) {
+      ASSERT_EQ(r.dataBus, 0x37);
+      seenMovB = true;
+    }
+  }
+  ASSERT_TRUE(seenMovB);
+}
+
+TEST_F(TraceTest, keepsMostRecentCycles) {
+  system->enableTrace(8);
+  system->run(PROGRAM_START);
+  auto trace = system->trace();
+  ASSERT_EQ(trace->capacity(), 8);
+  ASSERT_GT(trace->total(), 8);
+  ASSERT_EQ(trace->size(), 8);
+  for (size_t ix = 0; ix < trace->size(); ix++) {
+    ASSERT_EQ((*trace)[ix].cycle, trace->total() - 8 + ix);
+  }
+}
+
+TEST_F(TraceTest, render) {
+  system->enableTrace();
+  system->run(PROGRAM_START);
+  std::stringstream ss;
+  system->trace()->render(ss, system->controller()->microCode(), 4);
+  std::string line;
+  int lines = 0;
+  while (std::getline(ss, line)) {
+    lines++;
+  }
+  ASSERT_EQ(lines, 5);
+  ASSERT_NE(ss.str().find("hlt"), std::string::npos);
+}
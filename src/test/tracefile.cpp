@@ -0,0 +1,237 @@
+/*
+ * Copyright (c) 2021, Jan de Visser <jan@finiandarcy.com>
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+
+#include "backplanetest.h"
+#include "cpu/tracefile.h"
+
+const byte tracefile_program[] = {
+  /* 1000 */ MOV_DI_CONST, 0x00, 0x20,
+  /* 1003 */ MOV_SI_CONST, 0x00, 0x01,
+  /* 1006 */ MOV_A_CONST, 0x5A,
+  /* 1008 */ MOV__DI_A,
+  /* 1009 */ DEC_SI,
+  /* 100A */ JNZ, 0x08, 0x10,
+  /* 100D */ HLT,
+};
+
+class TraceFileTest : public BackPlaneTest {
+protected:
+  std::string path;
+
+  TraceFileTest()
+    : BackPlaneTest(tracefile_program) {
+  }
+
+  void SetUp() override {
+    BackPlaneTest::SetUp();
+    path = (std::filesystem::temp_directory_path()
+        / (std::string("jv80-") + ::testing::UnitTest::GetInstance()->current_test_info()->name() + ".trace")).string();
+  }
+
+  void TearDown() override {
+    std::remove(path.c_str());
+    BackPlaneTest::TearDown();
+  }
+
+  void run(size_t chunkRecords) {
+    TraceWriter writer(path, chunkRecords);
+    ASSERT_TRUE(writer.good());
+    system->enableTrace(0x10000);
+    system->traceTo(&writer);
+    system->run(PROGRAM_START);
+    system->traceTo(nullptr);
+    ASSERT_EQ(system->error(), NoError);
+    ASSERT_EQ(writer.records(), system->trace()->total());
+    writer.close();
+  }
+
+  void compare(TraceReader& reader) {
+    ASSERT_TRUE(reader.valid()) << reader.error();
+    auto trace = system->trace();
+    ASSERT_EQ(reader.records(), trace->size());
+    std::vector<CycleRecord> records;
+    size_t ix = 0;
+    for (auto& chunk : reader.chunks()) {
+      ASSERT_TRUE(reader.decode(chunk, records));
+      ASSERT_EQ(records.size(), chunk.count);
+      for (auto& r : records) {
+        ASSERT_EQ(memcmp(&r, &(*trace)[ix], sizeof(CycleRecord)), 0) << "Cycle " << ix;
+        ix++;
+      }
+    }
+  }
+};
+
+TEST_F(TraceFileTest, roundTrip) {
+  run(TraceWriter::DEFAULT_CHUNK_RECORDS);
+  TraceReader reader(path);
+  compare(reader);
+  ASSERT_EQ(reader.chunks().size(), (reader.records() + TraceWriter::DEFAULT_CHUNK_RECORDS - 1) / TraceWriter::DEFAULT_CHUNK_RECORDS);
+
+  unsigned long bytes = 0;
+  for (auto& chunk : reader.chunks()) {
+    bytes += chunk.size;
+  }
+  ASSERT_LT(bytes, reader.records() * 4);
+}
+
+TEST_F(TraceFileTest, chunkIndex) {
+  run(64);
+  TraceReader reader(path);
+  compare(reader);
+  ASSERT_GT(reader.chunks().size(), 10);
+
+  std::vector<CycleRecord> records;
+  uint64_t next = 0;
+  for (auto& chunk : reader.chunks()) {
+    ASSERT_EQ(chunk.firstCycle, next);
+    next = chunk.lastCycle() + 1;
+    ASSERT_TRUE(reader.decode(chunk, records));
+    uint8_t opcodes[32] = {};
+    for (auto& r : records) {
+      ASSERT_GE(r.pc, chunk.minPC);
+      ASSERT_LE(r.pc, chunk.maxPC);
+      ASSERT_TRUE(chunk.components & (1 << r.getID));
+      ASSERT_TRUE(chunk.components & (1 << r.putID));
+      opcodes[r.ir >> 3] |= 1 << (r.ir & 0x07);
+    }
+    ASSERT_EQ(memcmp(opcodes, chunk.opcodes, sizeof(opcodes)), 0);
+  }
+  ASSERT_FALSE(reader.chunks().back().hasOpcode(MOV_DI_CONST));
+  ASSERT_TRUE(reader.chunks().back().hasOpcode(HLT));
+}
+
+TEST_F(TraceFileTest, wideCycles) {
+  // A trace started after 2^32 cycles, with a gap crossing 2^33:
+  std::vector<CycleRecord> expected;
+  uint64_t cycle = 0xFFFFFF00ull;
+  for (int ix = 0; ix < 300; ix++) {
+    CycleRecord r;
+    r.cycle = cycle;
+    r.pc = PROGRAM_START + ix / 4;
+    r.step = ix % 4;
+    expected.push_back(r);
+    cycle += (ix == 200) ? 0x100000000ull : 1;
+  }
+  {
+    TraceWriter writer(path, 64);
+    for (auto& r : expected) {
+      writer.record(r);
+    }
+  }
+
+  TraceReader reader(path);
+  ASSERT_TRUE(reader.valid()) << reader.error();
+  ASSERT_EQ(reader.chunks().front().firstCycle, 0xFFFFFF00ull);
+  ASSERT_EQ(reader.chunks().back().lastCycle(), expected.back().cycle);
+  std::vector<CycleRecord> records;
+  size_t ix = 0;
+  for (auto& chunk : reader.chunks()) {
+    ASSERT_TRUE(reader.decode(chunk, records));
+    for (auto& r : records) {
+      ASSERT_EQ(r.cycle, expected[ix++].cycle);
+    }
+  }
+  ASSERT_EQ(ix, expected.size());
+}
+
+TEST_F(TraceFileTest, recoverWithoutIndex) {
+  run(64);
+  auto size = std::filesystem::file_size(path);
+  size_t chunks;
+  {
+    TraceReader reader(path);
+    chunks = reader.chunks().size();
+  }
+  // Cut off the footer, the index and half of the last chunk:
+  std::filesystem::resize_file(path, size - sizeof(TraceFileFooter) - chunks * sizeof(TraceChunkInfo) - 4);
+  TraceReader reader(path);
+  ASSERT_TRUE(reader.valid());
+  ASSERT_EQ(reader.chunks().size(), chunks - 1);
+  std::vector<CycleRecord> records;
+  for (auto& chunk : reader.chunks()) {
+    ASSERT_TRUE(reader.decode(chunk, records));
+  }
+}
+
+TEST_F(TraceFileTest, corruptIndex) {
+  run(64);
+  size_t chunks;
+  {
+    TraceReader reader(path);
+    chunks = reader.chunks().size();
+  }
+
+  // An index offset which wraps around when the size of the index is
+  // added to it:
+  auto size = std::filesystem::file_size(path);
+  TraceFileFooter footer;
+  footer.chunks = 0xFFFFFFFF;
+  footer.indexOffset = size - sizeof(footer) - (uint64_t)footer.chunks * sizeof(TraceChunkInfo);
+  {
+    std::fstream f(path, std::ios::in | std::ios::out | std::ios::binary);
+    f.seekp((std::streamoff)(size - sizeof(footer)));
+    f.write((const char*)&footer, sizeof(footer));
+  }
+  TraceReader reader(path);
+  ASSERT_TRUE(reader.valid());
+  ASSERT_EQ(reader.chunks().size(), chunks);
+
+  // A record count the chunk can't hold:
+  std::vector<CycleRecord> records;
+  auto chunk = reader.chunks().front();
+  chunk.count = chunk.size + 1;
+  ASSERT_FALSE(reader.decode(chunk, records));
+  ASSERT_TRUE(records.empty());
+  chunk.count = 0xFFFFFFFF;
+  ASSERT_FALSE(reader.decode(chunk, records));
+}
+
+TEST_F(TraceFileTest, noChunks) {
+  {
+    TraceWriter writer(path);
+    ASSERT_TRUE(writer.good());
+  }
+  auto size = std::filesystem::file_size(path);
+  {
+    TraceReader reader(path);
+    ASSERT_TRUE(reader.valid());
+    ASSERT_EQ(reader.records(), 0);
+  }
+
+  // A writer that never got to close the file leaves just the header:
+  std::filesystem::resize_file(path, sizeof(TraceFileHeader));
+  {
+    TraceReader reader(path);
+    ASSERT_TRUE(reader.valid());
+    ASSERT_TRUE(reader.chunks().empty());
+  }
+
+  // A header followed by something that is neither a chunk nor an index:
+  std::filesystem::resize_file(path, size);
+  {
+    std::fstream f(path, std::ios::in | std::ios::out | std::ios::binary);
+    f.seekp((std::streamoff)(size - sizeof(TraceFileFooter)));
+    f << "Not a footer";
+  }
+  TraceReader reader(path);
+  ASSERT_FALSE(reader.valid());
+  ASSERT_FALSE(reader.error().empty());
+}
+
+TEST_F(TraceFileTest, notATraceFile) {
+  {
+    std::ofstream f(path);
+    f << "This is not a trace file, but it is long enough to have a header" << std::endl;
+  }
+  TraceReader reader(path);
+  ASSERT_FALSE(reader.valid());
+  ASSERT_FALSE(reader.error().empty());
+}
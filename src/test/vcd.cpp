@@ -0,0 +1,108 @@
+/*
+ * Copyright (c) 2021, Jan de Visser <jan@finiandarcy.com>
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include <sstream>
+
+#include "backplanetest.h"
+#include "cpu/vcd.h"
+
+const byte vcd_program[] = {
+  /* 1000 */ MOV_A_CONST, 0x42,
+  /* 1002 */ MOV_B_CONST, 0x37,
+  /* 1004 */ HLT,
+};
+
+class VcdTest : public BackPlaneTest {
+protected:
+  std::stringstream out;
+  std::vector<std::string> lines;
+
+  VcdTest()
+    : BackPlaneTest(vcd_program) {
+  }
+
+  void run(VcdWriter& vcd) {
+    system->dumpTo(&vcd);
+    system->run(PROGRAM_START);
+    system->dumpTo(nullptr);
+    ASSERT_EQ(system->error(), NoError);
+    vcd.flush();
+    std::string line;
+    while (std::getline(out, line)) {
+      lines.push_back(line);
+    }
+  }
+
+  // Returns the times at which <value> was written.
+  std::vector<unsigned long> timesOf(const std::string& value) {
+    std::vector<unsigned long> ret;
+    unsigned long time = 0;
+    for (auto& line : lines) {
+      if (line[0] == '#') {
+        time = std::stoul(line.substr(1));
+      } else if (line == value) {
+        ret.push_back(time);
+      }
+    }
+    return ret;
+  }
+};
+
+TEST_F(VcdTest, header) {
+  VcdWriter vcd(out);
+  run(vcd);
+  auto text = out.str();
+  ASSERT_NE(text.find("$var wire 8 # data_bus [7:0] $end"), std::string::npos);
+  ASSERT_NE(text.find("$var wire 1 , _halt $end"), std::string::npos);
+  ASSERT_NE(text.find("$enddefinitions $end\n#0\n$dumpvars\n"), std::string::npos);
+}
+
+TEST_F(VcdTest, onlyChangesWritten) {
+  VcdWriter vcd(out);
+  run(vcd);
+
+  // Every timestamp is followed by at least one value:
+  for (size_t ix = 0; ix < lines.size(); ix++) {
+    if (lines[ix][0] == '#') {
+      ASSERT_LT(ix + 1, lines.size());
+      ASSERT_NE(lines[ix + 1][0], '#') << "Empty timestamp " << lines[ix];
+    }
+  }
+
+  // The clock rises every four phases, in system and IO cycles:
+  auto rising = timesOf("1!");
+  ASSERT_EQ(rising.size(), system->cycles());
+  for (size_t ix = 1; ix < rising.size(); ix++) {
+    ASSERT_EQ(rising[ix] - rising[ix - 1], 4);
+  }
+
+  // The constants loaded appear on the data bus, and the machine halts:
+  ASSERT_FALSE(timesOf("b1000010 #").empty());
+  ASSERT_FALSE(timesOf("b110111 #").empty());
+  ASSERT_EQ(timesOf("0,").size(), 1);
+}
+
+TEST_F(VcdTest, window) {
+  VcdWriter vcd(out);
+  vcd.setWindow(2, 2);
+  run(vcd);
+  // Cycle 2 starts after two system and two IO cycles, and is followed by
+  // an IO cycle:
+  auto rising = timesOf("1!");
+  ASSERT_EQ(rising.size(), 2);
+  ASSERT_EQ(rising[0], 4 * 4);
+  ASSERT_EQ(rising[1], 5 * 4);
+  ASSERT_TRUE(timesOf("0,").empty());
+}
+
+TEST_F(VcdTest, trigger) {
+  VcdWriter vcd(out);
+  vcd.setTrigger([this]() { return system->bus().readDataBus() == 0x37; });
+  run(vcd);
+  ASSERT_TRUE(vcd.triggered());
+  ASSERT_TRUE(timesOf("b1000010 #").empty());
+  ASSERT_FALSE(timesOf("0,").empty());
+}
@@ -0,0 +1,149 @@
+/*
+ * Copyright (c) 2021, Jan de Visser <jan@finiandarcy.com>
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+#include "backplanetest.h"
+#include "cpu/worker.h"
+
+const byte worker_program[] = {
+  /* 1000 */ MOV_DI_CONST, 0x00, 0x20,
+  /* 1003 */ MOV_SI_CONST, 0x00, 0x08,
+  /* 1006 */ MOV_A_CONST, 0x5A,
+  /* 1008 */ MOV__DI_A,
+  /* 1009 */ DEC_SI,
+  /* 100A */ JNZ, 0x08, 0x10,
+  /* 100D */ HLT,
+};
+
+const byte endless_program[] = {
+  /* 1000 */ JMP, 0x00, 0x10,
+};
+
+class WorkerTest : public BackPlaneTest {
+protected:
+  Worker* worker = nullptr;
+
+  void TearDown() override {
+    delete worker;
+    BackPlaneTest::TearDown();
+  }
+
+  template<size_t N>
+  void start(const byte (&program)[N]) {
+    load(program);
+    worker = new Worker(*system);
+  }
+
+  bool wait(Worker::Reply& reply) {
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    while (!worker->reply(reply)) {
+      if (std::chrono::steady_clock::now() > deadline) {
+        return false;
+      }
+      std::this_thread::yield();
+    }
+    return true;
+  }
+};
+
+TEST_F(WorkerTest, stepReportsChangedRegisters) {
+  start(worker_program);
+  setPC(PROGRAM_START);
+  Worker::Reply reply;
+
+  ASSERT_TRUE(worker->post(Worker::Step));
+  ASSERT_TRUE(wait(reply));
+  ASSERT_EQ(reply.command, Worker::Step);
+  ASSERT_EQ(reply.error, NoError);
+  ASSERT_FALSE(reply.halted);
+  ASSERT_EQ(reply.registers[Di], 0x2000);
+  ASSERT_EQ(reply.registers[PC], PROGRAM_START + 3);
+  ASSERT_TRUE(reply.changed & (1u << Di));
+  ASSERT_TRUE(reply.changed & (1u << PC));
+
+  ASSERT_TRUE(worker->post(Worker::Step));
+  ASSERT_TRUE(wait(reply));
+  ASSERT_EQ(reply.registers[Si], 0x0800);
+  ASSERT_TRUE(reply.changed & (1u << Si));
+  ASSERT_FALSE(reply.changed & (1u << Di));
+  ASSERT_FALSE(worker->busy());
+}
+
+TEST_F(WorkerTest, runToHalt) {
+  start(worker_program);
+  Worker::Reply reply;
+
+  ASSERT_TRUE(worker->post(Worker::Run, PROGRAM_START));
+  ASSERT_TRUE(wait(reply));
+  ASSERT_EQ(reply.command, Worker::Run);
+  ASSERT_EQ(reply.error, NoError);
+  ASSERT_TRUE(reply.halted);
+  ASSERT_EQ(reply.registers[Si], 0);
+  ASSERT_GT(reply.cycles, 0);
+  auto mem = system->memory();
+  for (word addr = 0x2000; addr < 0x2800; addr++) {
+    ASSERT_EQ((*mem)[addr], 0x5A) << "Address " << addr;
+  }
+
+  // A halted system ignores run commands until it is reset:
+  ASSERT_TRUE(worker->post(Worker::Continue));
+  ASSERT_TRUE(wait(reply));
+  ASSERT_TRUE(reply.halted);
+  ASSERT_EQ(reply.cycles, 0);
+
+  ASSERT_TRUE(worker->post(Worker::Reset));
+  ASSERT_TRUE(wait(reply));
+  ASSERT_EQ(reply.command, Worker::Reset);
+  ASSERT_FALSE(reply.halted);
+  ASSERT_EQ(reply.registers[PC], 0);
+}
+
+TEST_F(WorkerTest, pauseInterruptsRun) {
+  start(endless_program);
+  std::atomic<bool> notified = false;
+  worker->setNotifier([&notified]() { notified = true; });
+  Worker::Reply reply;
+
+  for (int ix = 0; ix < 3; ix++) {
+    ASSERT_TRUE(worker->post((ix == 0) ? Worker::Run : Worker::Continue, PROGRAM_START));
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    ASSERT_TRUE(worker->busy());
+    worker->pause();
+    ASSERT_TRUE(wait(reply));
+    ASSERT_EQ(reply.error, NoError);
+    ASSERT_FALSE(reply.halted);
+    ASSERT_GT(reply.cycles, 0);
+    ASSERT_GE(reply.registers[PC], PROGRAM_START);
+    ASSERT_LE(reply.registers[PC], PROGRAM_START + sizeof(endless_program));
+  }
+  ASSERT_TRUE(notified);
+}
+
+TEST_F(WorkerTest, pauseBeforeRunStarts) {
+  start(endless_program);
+  Worker::Reply reply;
+
+  // The worker may not have taken the command from the queue yet when it
+  // is paused, which must not make it run forever:
+  for (int ix = 0; ix < 50; ix++) {
+    ASSERT_TRUE(worker->post((ix == 0) ? Worker::Run : Worker::Continue, PROGRAM_START));
+    worker->pause();
+    ASSERT_TRUE(wait(reply)) << "Iteration " << ix;
+    ASSERT_EQ(reply.error, NoError);
+    ASSERT_FALSE(reply.halted);
+  }
+
+  // A pause only applies to commands posted before it:
+  ASSERT_TRUE(worker->post(Worker::Continue));
+  std::this_thread::sleep_for(std::chrono::milliseconds(20));
+  ASSERT_TRUE(worker->busy());
+  worker->pause();
+  ASSERT_TRUE(wait(reply));
+  ASSERT_FALSE(reply.halted);
+}
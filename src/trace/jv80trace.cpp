@@ -0,0 +1,165 @@
+/*
+ * Copyright (c) 2021, Jan de Visser <jan@finiandarcy.com>
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+#include <cpu/tracefile.h>
+
+#include "../cpu/microcode.inc"
+
+using namespace Obelix::JV80::CPU;
+
+namespace {
+
+struct Query {
+    unsigned long pcFrom = 0;
+    unsigned long pcTo = 0xFFFF;
+    int opcode = -1;
+    int component = -1;
+    unsigned long cycleFrom = 0;
+    unsigned long cycleTo = ~0ul;
+
+    bool skip(const TraceChunkInfo& chunk) const
+    {
+        return (chunk.maxPC < pcFrom) || (chunk.minPC > pcTo)
+            || (chunk.lastCycle() < cycleFrom) || (chunk.firstCycle > cycleTo)
+            || ((opcode >= 0) && !chunk.hasOpcode(opcode))
+            || ((component >= 0) && !(chunk.components & (1 << component)));
+    }
+
+    bool matches(const CycleRecord& r) const
+    {
+        return (r.pc >= pcFrom) && (r.pc <= pcTo)
+            && (r.cycle >= cycleFrom) && (r.cycle <= cycleTo)
+            && ((opcode < 0) || (r.ir == opcode))
+            && ((component < 0) || (r.getID == component) || (r.putID == component));
+    }
+};
+
+bool parseNumber(const char* s, unsigned long max, unsigned long& value)
+{
+    char* end;
+    value = strtoul(s, &end, 0);
+    return (end != s) && !*end && (value <= max);
+}
+
+bool parseRange(const char* s, unsigned long max, unsigned long& from, unsigned long& to)
+{
+    std::string str(s);
+    auto colon = str.find(':');
+    if (colon == std::string::npos) {
+        return parseNumber(s, max, from) && ((to = from), true);
+    }
+    return parseNumber(str.substr(0, colon).c_str(), max, from)
+        && parseNumber(str.substr(colon + 1).c_str(), max, to)
+        && (from <= to);
+}
+
+void usage(const char* prog)
+{
+    std::cerr << "Usage: " << prog << " [options] <tracefile>" << std::endl
+              << "  --pc <from>[:<to>]        Only cycles with PC in the given range" << std::endl
+              << "  --opcode <opcode>         Only cycles executing the given opcode" << std::endl
+              << "  --component <id>          Only cycles where the given component gets or puts" << std::endl
+              << "  --cycles <from>[:<to>]    Only cycles in the given window" << std::endl
+              << "  --count                   Print the number of matching cycles only" << std::endl
+              << "  --info                    Print a summary of the file" << std::endl;
+}
+
+}
+
+int main(int argc, char** argv)
+{
+    Query query;
+    bool count = false;
+    bool info = false;
+    const char* path = nullptr;
+    unsigned long value;
+
+    for (int ix = 1; ix < argc; ix++) {
+        bool ok = true;
+        if (!strcmp(argv[ix], "--pc") && (ix < argc - 1)) {
+            ok = parseRange(argv[++ix], 0xFFFF, query.pcFrom, query.pcTo);
+        } else if (!strcmp(argv[ix], "--opcode") && (ix < argc - 1)) {
+            ok = parseNumber(argv[++ix], 0xFF, value);
+            query.opcode = (int)value;
+        } else if (!strcmp(argv[ix], "--component") && (ix < argc - 1)) {
+            ok = parseNumber(argv[++ix], 0x0F, value);
+            query.component = (int)value;
+        } else if (!strcmp(argv[ix], "--cycles") && (ix < argc - 1)) {
+            ok = parseRange(argv[++ix], ~0ul, query.cycleFrom, query.cycleTo);
+        } else if (!strcmp(argv[ix], "--count")) {
+            count = true;
+        } else if (!strcmp(argv[ix], "--info")) {
+            info = true;
+        } else if ((argv[ix][0] != '-') && !path) {
+            path = argv[ix];
+        } else {
+            ok = false;
+        }
+        if (!ok) {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+    if (!path) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    TraceReader reader(path);
+    if (!reader.valid()) {
+        std::cerr << reader.error() << std::endl;
+        return 1;
+    }
+
+    if (info) {
+        unsigned long bytes = 0;
+        for (auto& chunk : reader.chunks()) {
+            bytes += chunk.size;
+        }
+        auto records = reader.records();
+        printf("%lu cycles in %zu chunks, %.2f bytes per cycle\n",
+            records, reader.chunks().size(), (records) ? (double)bytes / records : 0.0);
+        if (records) {
+            printf("Cycles %lu to %lu\n", (unsigned long)reader.chunks().front().firstCycle,
+                (unsigned long)reader.chunks().back().lastCycle());
+        }
+        return 0;
+    }
+
+    if (!count) {
+        std::cout << "CYCLE    PC   IR INSTRUCTION     STEP DATA ADDR GET PUT OP ACT FLAG" << std::endl;
+    }
+    unsigned long matches = 0;
+    std::vector<CycleRecord> records;
+    for (auto& chunk : reader.chunks()) {
+        if (query.skip(chunk)) {
+            continue;
+        }
+        if (!reader.decode(chunk, records)) {
+            std::cerr << path << ": corrupt chunk at offset " << chunk.offset << std::endl;
+            return 1;
+        }
+        for (auto& r : records) {
+            if (!query.matches(r)) {
+                continue;
+            }
+            matches++;
+            if (!count) {
+                CycleTrace::render(std::cout, r, mc);
+            }
+        }
+    }
+    if (count) {
+        std::cout << matches << std::endl;
+    }
+    return 0;
+}